@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * Benchmarks build like the tests (see tests/test.h) and print one line per
+ * measurement: either the spread of single samples or the rate of a loop.
+ */
+#include "test.h"
+
+/* keeps the compiler from dropping a computed result */
+#define BENCH_KEEP(value) __asm__ __volatile__("" : : "g"(value) : "memory")
+
+/* avg, median, 99th percentile and max of samples in ns */
+static inline void bench_report(const char* name, std::vector<uint64_t>& samples) {
+	uint64_t sum=0;
+
+	if (samples.empty()) {
+		printf("%-40s no samples\n", name);
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	for (size_t i=0; i<samples.size(); i++) {
+		sum+=samples[i];
+	}
+	printf("%-40s %8zu x  avg %9.2fus  p50 %9.2fus  p99 %9.2fus  max %9.2fus\n", name, samples.size(),
+		sum/1000.0/samples.size(),
+		samples[samples.size()/2]/1000.0,
+		samples[samples.size()*99/100]/1000.0,
+		samples.back()/1000.0);
+}
+
+/* ns per operation and operations per second of a loop of 'count' operations */
+static inline void bench_rate(const char* name, uint64_t count, uint64_t elapsed_ns) {
+	printf("%-40s %8llu x  %9.1fns/op  %12.0f/s\n", name, (unsigned long long)count,
+		(double)elapsed_ns/count, count*1e9/elapsed_ns);
+}
+
+#endif
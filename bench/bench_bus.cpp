@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Cost of going through the bus thread instead of calling the transport
+ * directly, and how long a priority request (a player tick) waits for the
+ * bus while other threads keep it busy. Runs against simulated servos.
+ */
+#include "bench.h"
+#include "servo_sim.c"
+
+#define BENCH_BUS_ROUNDS            5000
+#define BENCH_BUS_TICKS             500
+
+typedef struct {
+	dynamixel_bus_t*				bus;
+	uint8_t									id;
+	volatile bool*					stop;
+} bench_bus_client_t;
+
+static void* bench_bus_client(void* arg) {
+	bench_bus_client_t* client=(bench_bus_client_t*)arg;
+	uint8_t data[2];
+
+	while (!*client->stop) {
+		dynamixel_bus_read_data(client->bus, client->id, (dynamixel_register_t)SERVO_SIM_R_PRESENT_POSITION, 2, data);
+	}
+	return NULL;
+}
+
+/* 12 goals from the priority queue, with 'clients' threads reading at the same time */
+static void bench_bus_ticks(dynamixel_bus_t* bus, uint8_t clients, const char* name) {
+	bench_bus_client_t client[8];
+	pthread_t threads[8];
+	volatile bool stop=false;
+	std::vector<uint64_t> samples;
+	uint16_t data[12*2];
+	uint64_t t_start;
+
+	for (uint8_t c=0; c<clients; c++) {
+		client[c].bus=bus;
+		client[c].id=13+c;
+		client[c].stop=&stop;
+		pthread_create(&threads[c], NULL, bench_bus_client, &client[c]);
+	}
+	for (uint8_t i=0; i<12; i++) {
+		data[i*2]=i+1;
+		data[i*2+1]=512;
+	}
+	for (uint32_t t=0; t<BENCH_BUS_TICKS; t++) {
+		t_start=test_now_ns();
+		dynamixel_bus_sync_write_words(bus, (dynamixel_register_t)SERVO_SIM_R_GOAL_POSITION, 12, 1, data, true);
+		samples.push_back(test_now_ns()-t_start);
+		usleep(2000);
+	}
+	stop=true;
+	for (uint8_t c=0; c<clients; c++) {
+		pthread_join(threads[c], NULL);
+	}
+	bench_report(name, samples);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	std::vector<uint64_t> samples;
+	uint8_t data[2];
+	uint64_t t_start;
+
+	if ((servo_sim_start(&sim, 18, false)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	for (uint32_t i=0; i<BENCH_BUS_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_serial_read_data(&serial, 1, SERVO_SIM_R_PRESENT_POSITION, 2, data);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("read, transport directly", samples);
+
+	dynamixel_bus_init(&bus, NULL, &serial);
+	samples.clear();
+	for (uint32_t i=0; i<BENCH_BUS_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_bus_read_data(&bus, 1, (dynamixel_register_t)SERVO_SIM_R_PRESENT_POSITION, 2, data);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("read, through the bus thread", samples);
+
+	bench_bus_ticks(&bus, 0, "player tick, idle bus");
+	bench_bus_ticks(&bus, 1, "player tick, 1 reader");
+	bench_bus_ticks(&bus, 4, "player tick, 4 readers");
+	printf("priority wait: avg %lluus, max %lluus\n",
+		(unsigned long long)(bus.stats.priority_wait_ns_sum/bus.stats.priority_transactions/1000),
+		(unsigned long long)bus.stats.priority_wait_ns_max/1000);
+
+	servo_sim_stop(&sim);
+	return 0;
+}
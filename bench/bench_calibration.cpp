@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* batch conversions, per call and per element */
+#include "bench.h"
+
+#define BENCH_CALIBRATION_ROUNDS    200000
+
+static void bench_calibration(const calibration_t* calibration, uint8_t count) {
+	uint8_t ids[CALIBRATION_MAX_BATCH];
+	uint16_t ticks[CALIBRATION_MAX_BATCH];
+	float rad[CALIBRATION_MAX_BATCH];
+	char name[64];
+	uint64_t t_start;
+
+	for (uint8_t i=0; i<count; i++) {
+		ids[i]=1+i%18;
+		ticks[i]=200+i*3;
+	}
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_CALIBRATION_ROUNDS; r++) {
+		ticks[r%count]^=1;
+		calibration_ticks_to_rad(calibration, ids, ticks, rad, count);
+		BENCH_KEEP(rad[0]);
+	}
+	snprintf(name, sizeof(name), "ticks_to_rad, %u servos", count);
+	bench_rate(name, (uint64_t)BENCH_CALIBRATION_ROUNDS*count, test_now_ns()-t_start);
+
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_CALIBRATION_ROUNDS; r++) {
+		rad[r%count]+=1e-3f;
+		calibration_rad_to_ticks(calibration, ids, rad, ticks, count);
+		BENCH_KEEP(ticks[0]);
+	}
+	snprintf(name, sizeof(name), "rad_to_ticks, %u servos", count);
+	bench_rate(name, (uint64_t)BENCH_CALIBRATION_ROUNDS*count, test_now_ns()-t_start);
+}
+
+int main(int argc, char** argv) {
+	calibration_t calibration;
+
+	calibration_init(&calibration);
+	for (uint8_t id=10; id<=18; id++) {
+		calibration_set(&calibration, id, CALIBRATION_MODEL_MX, 0.1f, -1, -2.0f, 2.0f);
+	}
+	printf("rates are per converted value\n");
+	bench_calibration(&calibration, 1);
+	bench_calibration(&calibration, 18);
+	bench_calibration(&calibration, CALIBRATION_MAX_BATCH);
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Cost of command_dispatch: lookup, schema, validator and handler. The bus
+ * is stubbed out, its transport writes into /dev/null and no servo answers,
+ * so bus commands measure the queue to the bus thread and the packet
+ * encoding but no wire time.
+ */
+#include "bench.h"
+
+#define BENCH_DISPATCH_ROUNDS       20000
+#define BENCH_DISPATCH_FAST_ROUNDS  1000000
+
+static void bench_dispatch(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, uint32_t rounds, const char* name) {
+	std::vector<int16_t> tx_vect;
+	uint64_t t_start;
+	int16_t ret=0;
+
+	tx_vect.reserve(64);
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<rounds; r++) {
+		tx_vect.clear();
+		ret=command_dispatch(ctx, rx_vect, tx_vect);
+		BENCH_KEEP(ret);
+	}
+	bench_rate(name, rounds, test_now_ns()-t_start);
+	if (ret<0) {
+		printf("%-40s returns %d\n", name, ret);
+	}
+}
+
+/* 'count' servos from id 1 in the layout of each command */
+static std::vector<int16_t> bench_dispatch_message(uint16_t command, uint8_t count) {
+	std::vector<int16_t> rx_vect(1, command);
+
+	switch (command) {
+		case DYNAMIXEL_RQ_SYNC_WRITE_WORDS:
+			rx_vect.push_back(30);
+			rx_vect.push_back(count);
+			rx_vect.push_back(2);
+			for (uint8_t i=0; i<count; i++) {
+				rx_vect.push_back(1+i);
+				rx_vect.push_back(512);
+				rx_vect.push_back(100);
+			}
+			break;
+		case DYNAMIXEL_RQ_UNIT_SYNC_WRITE:
+			rx_vect.push_back(count);
+			for (uint8_t i=0; i<count; i++) {
+				rx_vect.push_back(1+i);
+				rx_vect.push_back(100);
+				rx_vect.push_back(1000);
+			}
+			break;
+		case DYNAMIXEL_RQ_MOVE_SYNC:
+			rx_vect.push_back(500);
+			for (uint8_t i=0; i<count; i++) {
+				rx_vect.push_back(1+i);
+				rx_vect.push_back(0);
+			}
+			break;
+	}
+	return rx_vect;
+}
+
+int main(int argc, char** argv) {
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	calibration_t calibration;
+	command_ctx_t ctx;
+	std::vector<int16_t> rx_vect;
+
+	memset(&serial, 0, sizeof(serial));
+	serial.fd=open("/dev/null", O_WRONLY);
+	serial.epoll_fd=-1;
+	serial.timer_fd=-1;
+	if (serial.fd<0) {
+		perror("/dev/null");
+		return 1;
+	}
+	/* nothing expects a reply, writes never wait */
+	dynamixel_serial_set_status_return(&serial, DYNAMIXEL_SERIAL_BROADCAST_ID, DYNAMIXEL_SERIAL_RETURN_PING);
+	dynamixel_bus_init(&bus, NULL, &serial);
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, &bus, &calibration);
+
+	rx_vect={DYNAMIXEL_RQ_ZMQ_ECHO, 1, 2, 3, 4};
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_FAST_ROUNDS, "echo");
+	rx_vect={DYNAMIXEL_RQ_TIME_SYNC};
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_FAST_ROUNDS, "time_sync");
+	rx_vect={0x7FFF};
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_FAST_ROUNDS, "rejected, unknown command");
+	rx_vect=bench_dispatch_message(DYNAMIXEL_RQ_UNIT_SYNC_WRITE, 18);
+	rx_vect.back()=-1;
+	rx_vect[rx_vect.size()-3]=CALIBRATION_MAX_ID;
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_FAST_ROUNDS, "rejected, unit_sync_write last id");
+
+	rx_vect={DYNAMIXEL_RQ_WRITE_DATA, 1, 30, 2, 0x00, 0x02};
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_ROUNDS, "write_data, 2 bytes");
+	rx_vect=bench_dispatch_message(DYNAMIXEL_RQ_SYNC_WRITE_WORDS, 18);
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_ROUNDS, "sync_write_words, 18 servos");
+	rx_vect=bench_dispatch_message(DYNAMIXEL_RQ_UNIT_SYNC_WRITE, 18);
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_ROUNDS, "unit_sync_write, 18 servos");
+	/* no servo answers, move_sync starts where its last goals left them and holds them */
+	ctx.move_tag=1;
+	for (uint8_t id=1; id<=18; id++) {
+		ctx.move_goal[id]=512;
+		ctx.move_goal_tag[id]=1;
+		bus.goal_tag[id]=1;
+	}
+	rx_vect=bench_dispatch_message(DYNAMIXEL_RQ_MOVE_SYNC, 18);
+	bench_dispatch(&ctx, rx_vect, BENCH_DISPATCH_ROUNDS, "move_sync, 18 servos");
+	return 0;
+}
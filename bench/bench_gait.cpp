@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* leg solves per second and the complete gait tick (step, solve, pack) */
+#include "bench.h"
+
+#define BENCH_GAIT_ROUNDS           1000000
+
+int main(int argc, char** argv) {
+	gait_ctx_t gait;
+	gait_command_t command;
+	calibration_t calibration;
+	uint16_t data[GAIT_JOINT_COUNT*2];
+	uint64_t t_start;
+
+	memset(&gait, 0, sizeof(gait));
+	gait_config_default(&gait.config);
+	calibration_init(&calibration);
+	memset(&command, 0, sizeof(command));
+	command.vx=100.0f;
+	command.body_roll=0.05f;
+
+	t_start=test_now_ns();
+	for (uint32_t i=0; i<BENCH_GAIT_ROUNDS; i++) {
+		gait.foot.x[i%GAIT_LEG_COUNT]=(i%50)-25.0f;
+		gait_solve(&gait.config, &command, &gait.foot, &gait.joints);
+		BENCH_KEEP(gait.joints.tibia[0]);
+	}
+	bench_rate("gait_solve, 6 legs", BENCH_GAIT_ROUNDS, test_now_ns()-t_start);
+	printf("%-40s %12.0f legs/s\n", "", BENCH_GAIT_ROUNDS*GAIT_LEG_COUNT*1e9/(test_now_ns()-t_start));
+
+	t_start=test_now_ns();
+	for (uint32_t i=0; i<BENCH_GAIT_ROUNDS; i++) {
+		gait_step(&gait, &command, 0.01f);
+		gait_solve(&gait.config, &command, &gait.foot, &gait.joints);
+		gait_pack_ticks(&gait.config, &gait.joints, &calibration, data);
+		BENCH_KEEP(data[1]);
+	}
+	bench_rate("gait tick, step+solve+pack", BENCH_GAIT_ROUNDS, test_now_ns()-t_start);
+	return 0;
+}
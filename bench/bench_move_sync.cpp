@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * MOVE_SYNC for 18 simulated servos, reading the start positions from the
+ * servos against starting from the goals cached by the last move.
+ */
+#include "bench.h"
+#include "servo_sim.c"
+
+#define BENCH_MOVE_SERVOS           18
+#define BENCH_MOVE_ROUNDS           500
+
+static void bench_move_sync(command_ctx_t* ctx, bool cached, const char* name) {
+	std::vector<int16_t> rx_vect(1, DYNAMIXEL_RQ_MOVE_SYNC);
+	std::vector<int16_t> tx_vect;
+	std::vector<uint64_t> samples;
+	uint64_t t_start;
+
+	/* the servos hold their position, each move is over at once */
+	rx_vect.push_back(100);
+	for (uint8_t id=1; id<=BENCH_MOVE_SERVOS; id++) {
+		rx_vect.push_back(id);
+		rx_vect.push_back(0);
+	}
+	for (uint32_t r=0; r<BENCH_MOVE_ROUNDS; r++) {
+		if (!cached) {
+			memset(ctx->move_goal_tag, 0, sizeof(ctx->move_goal_tag));
+		}
+		tx_vect.clear();
+		t_start=test_now_ns();
+		command_dispatch(ctx, rx_vect, tx_vect);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report(name, samples);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	calibration_t calibration;
+	command_ctx_t ctx;
+
+	if ((servo_sim_start(&sim, BENCH_MOVE_SERVOS, false)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, &bus, &calibration);
+
+	bench_move_sync(&ctx, false, "move_sync, 18 position reads");
+	bench_move_sync(&ctx, true, "move_sync, from the cached goals");
+	servo_sim_stop(&sim);
+	return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * A burst of goal writes to 18 servos, each waiting for its status packet
+ * (level 2) against pipelined (level 1), up to the ping that confirms the
+ * last one arrived.
+ */
+#include "bench.h"
+#include "servo_sim.c"
+
+#define BENCH_PIPELINE_SERVOS       18
+#define BENCH_PIPELINE_ROUNDS       500
+
+static void bench_pipeline(dynamixel_serial_t* port, uint8_t level, const char* name) {
+	std::vector<uint64_t> samples;
+	uint8_t data[2];
+	uint64_t t_start;
+
+	for (uint8_t id=1; id<=BENCH_PIPELINE_SERVOS; id++) {
+		dynamixel_serial_write_data(port, id, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_STATUS_RETURN, 1, &level);
+	}
+	for (uint32_t r=0; r<BENCH_PIPELINE_ROUNDS; r++) {
+		t_start=test_now_ns();
+		for (uint8_t id=1; id<=BENCH_PIPELINE_SERVOS; id++) {
+			data[0]=(r+id)&0xFF;
+			data[1]=((r+id)>>8)&0x03;
+			dynamixel_serial_write_data(port, id, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_GOAL_POSITION, 2, data);
+		}
+		dynamixel_serial_ping(port, BENCH_PIPELINE_SERVOS);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report(name, samples);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t port;
+
+	if ((servo_sim_start(&sim, BENCH_PIPELINE_SERVOS, false)!=0) || (servo_sim_connect(&sim, &port)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	bench_pipeline(&port, DYNAMIXEL_SERIAL_RETURN_ALL, "18 writes, each with its status");
+	bench_pipeline(&port, DYNAMIXEL_SERIAL_RETURN_READ, "18 writes, pipelined");
+	dynamixel_serial_close(&port);
+	servo_sim_stop(&sim);
+	return 0;
+}
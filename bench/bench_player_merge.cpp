@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Per tick cost of merging the running tracks, from one track up to all
+ * PYPOSE_PLAYER_TRACKS on full poses with overlapping masks. The tracks
+ * are set up by hand, the player thread does not run.
+ */
+#include "bench.h"
+
+#define BENCH_MERGE_ROUNDS          1000000
+
+static void bench_player_merge(pypose_player_ctx_t* player, pypose_library_t* library, uint8_t tracks) {
+	uint64_t t_start;
+	uint8_t id_count=0;
+	char name[64];
+
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		pypose_track_t* track=&player->tracks[t];
+		track->state=(t<tracks) ? PP_STATE_RUNNING : PP_STATE_STOPPED;
+		track->sequence_id=t;
+		track->part_idx=0;
+		track->priority=t/2;
+		/* neighbouring tracks share half of their servos */
+		track->mask=(t==0) ? PYPOSE_PLAYER_ALL_SERVOS : (0xFFFFu<<((t*4)%16));
+		track->library=library;
+	}
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_MERGE_ROUNDS; r++) {
+		id_count=pypose_player_merge(player);
+		BENCH_KEEP(player->data[1]);
+	}
+	snprintf(name, sizeof(name), "merge, %u track(s) x %u servos -> %u ids", tracks, PYPOSE_MAX_POSE_SIZE, id_count);
+	bench_rate(name, BENCH_MERGE_ROUNDS, test_now_ns()-t_start);
+}
+
+int main(int argc, char** argv) {
+	std::vector<int16_t> rx_vect={PYPOSE_LOAD_LIBRARY, PYPOSE_ID, PYPOSE_MAX_POSE_SIZE, PYPOSE_PLAYER_TRACKS};
+	pypose_player_ctx_t player;
+	pypose_library_t* library;
+	uint8_t pose_size;
+
+	/* pose t and sequence t for every track */
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		rx_vect.push_back(t);
+		for (uint8_t i=0; i<PYPOSE_MAX_POSE_SIZE; i++) {
+			rx_vect.push_back(300+t*50+i);
+		}
+	}
+	rx_vect.push_back(PYPOSE_PLAYER_TRACKS);
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		rx_vect.insert(rx_vect.end(), {t, 1, t, 100});
+	}
+	if (pypose_library_parse(rx_vect, 2, &pose_size, &library)!=ZMQ_ERR_NO_ERROR) {
+		fprintf(stderr, "library rejected\n");
+		return 1;
+	}
+	memset(&player, 0, sizeof(player));
+	bench_player_merge(&player, library, 1);
+	bench_player_merge(&player, library, 2);
+	bench_player_merge(&player, library, 4);
+	bench_player_merge(&player, library, PYPOSE_PLAYER_TRACKS);
+	pypose_library_release(library);
+	return 0;
+}
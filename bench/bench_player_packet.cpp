@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * One player tick on a single full pose: the precompiled packet as it is
+ * against merging the track and encoding a SYNC_WRITE, both written to
+ * /dev/null by the native transport. Also what a LOAD_POSE costs now that
+ * it swaps in a copy of the library sharing all but the replaced pose.
+ */
+#include "bench.h"
+
+#define BENCH_PACKET_ROUNDS         200000
+#define BENCH_PACKET_LOAD_ROUNDS    2000
+
+static void bench_player_packet(pypose_player_ctx_t* player, dynamixel_serial_t* port, pypose_library_t* library) {
+	pypose_track_t* track=&player->tracks[0];
+	pypose_library_t* packet_library;
+	pypose_pose_t* pose;
+	std::vector<uint64_t> samples;
+	uint8_t id_count;
+	uint64_t t_start;
+
+	track->state=PP_STATE_RUNNING;
+	track->sequence_id=0;
+	track->part_idx=0;
+	track->mask=PYPOSE_PLAYER_ALL_SERVOS;
+	track->library=library;
+
+	/* per tick, a slow one delays the next pose as much as an average one */
+	samples.reserve(BENCH_PACKET_ROUNDS);
+	for (uint32_t r=0; r<BENCH_PACKET_ROUNDS; r++) {
+		t_start=test_now_ns();
+		pose=pypose_player_single_pose(player, &packet_library);
+		dynamixel_serial_write_packet(port, pose->packet, pose->packet_len);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("tick, precompiled packet", samples);
+
+	samples.clear();
+	for (uint32_t r=0; r<BENCH_PACKET_ROUNDS; r++) {
+		t_start=test_now_ns();
+		id_count=pypose_player_merge(player);
+		dynamixel_serial_sync_write_words(port, DYNAMIXEL_R_GOAL_POSITION_L, id_count, 1, player->data);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("tick, merge and encode", samples);
+}
+
+/* LOAD_POSE into a library of pose_count poses */
+static void bench_player_load_pose(command_ctx_t* ctx, uint8_t pose_count) {
+	std::vector<int16_t> rx_vect={PYPOSE_LOAD_LIBRARY, PYPOSE_ID, PYPOSE_MAX_POSE_SIZE, pose_count};
+	std::vector<int16_t> tx_vect;
+	uint64_t t_start;
+	char name[64];
+
+	for (uint8_t p=0; p<pose_count; p++) {
+		rx_vect.push_back(p);
+		for (uint8_t i=0; i<PYPOSE_MAX_POSE_SIZE; i++) {
+			rx_vect.push_back(512);
+		}
+	}
+	rx_vect.insert(rx_vect.end(), {1, 0, 1, 0, 100});
+	command_dispatch(ctx, rx_vect, tx_vect);
+
+	rx_vect={PYPOSE_LOAD_POSE, PYPOSE_ID, 0};
+	for (uint8_t i=0; i<PYPOSE_MAX_POSE_SIZE; i++) {
+		rx_vect.push_back(0x00);
+		rx_vect.push_back(0x02);
+	}
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_PACKET_LOAD_ROUNDS; r++) {
+		tx_vect.clear();
+		command_dispatch(ctx, rx_vect, tx_vect);
+	}
+	snprintf(name, sizeof(name), "load_pose, library of %u poses", pose_count);
+	bench_rate(name, BENCH_PACKET_LOAD_ROUNDS, test_now_ns()-t_start);
+}
+
+int main(int argc, char** argv) {
+	std::vector<int16_t> rx_vect={PYPOSE_LOAD_LIBRARY, PYPOSE_ID, PYPOSE_MAX_POSE_SIZE, 1, 0};
+	pypose_player_ctx_t player;
+	dynamixel_serial_t port;
+	pypose_library_t* library;
+	command_ctx_t ctx;
+	uint8_t pose_size;
+
+	for (uint8_t i=0; i<PYPOSE_MAX_POSE_SIZE; i++) {
+		rx_vect.push_back(300+i);
+	}
+	rx_vect.insert(rx_vect.end(), {1, 0, 1, 0, 100});
+	if (pypose_library_parse(rx_vect, 2, &pose_size, &library)!=ZMQ_ERR_NO_ERROR) {
+		fprintf(stderr, "library rejected\n");
+		return 1;
+	}
+	memset(&port, 0, sizeof(port));
+	port.fd=open("/dev/null", O_WRONLY);
+	port.epoll_fd=-1;
+	port.timer_fd=-1;
+	if (port.fd<0) {
+		perror("/dev/null");
+		return 1;
+	}
+	memset(&player, 0, sizeof(player));
+	bench_player_packet(&player, &port, library);
+	pypose_library_release(library);
+	close(port.fd);
+
+	/* a player without a thread, never running */
+	pypose_library_init();
+	memset(&player, 0, sizeof(player));
+	test_command_ctx(&ctx, NULL, NULL);
+	ctx.player=&player;
+	bench_player_load_pose(&ctx, 16);
+	bench_player_load_pose(&ctx, PYPOSE_MAX_POSE_COUNT);
+	return 0;
+}
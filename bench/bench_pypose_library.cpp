@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * A LOAD_LIBRARY upload (parse, build, swap) of growing size against the
+ * same poses and sequence sent one request per pose, and the
+ * acquire/release pair the player does per pass.
+ */
+#include "bench.h"
+
+#define BENCH_PYPOSE_ROUNDS         1000
+#define BENCH_PYPOSE_LEGACY_ROUNDS  50
+#define BENCH_PYPOSE_REFS           2000000
+
+static void bench_pypose_upload(command_ctx_t* ctx, uint8_t pose_size, uint8_t pose_count, uint8_t seq_count) {
+	std::vector<int16_t> rx_vect={PYPOSE_LOAD_LIBRARY, PYPOSE_ID, pose_size, pose_count};
+	std::vector<int16_t> tx_vect;
+	std::vector<uint64_t> samples;
+	uint64_t t_start;
+	char name[64];
+
+	for (uint8_t pose=0; pose<pose_count; pose++) {
+		rx_vect.push_back(pose);
+		for (uint8_t i=0; i<pose_size; i++) {
+			rx_vect.push_back(512+i);
+		}
+	}
+	rx_vect.push_back(seq_count);
+	for (uint8_t seq=0; seq<seq_count; seq++) {
+		rx_vect.push_back(seq);
+		rx_vect.push_back(pose_count);
+		for (uint8_t pose=0; pose<pose_count; pose++) {
+			rx_vect.push_back(pose);
+			rx_vect.push_back(100);
+		}
+	}
+	for (uint32_t r=0; r<BENCH_PYPOSE_ROUNDS; r++) {
+		tx_vect.clear();
+		t_start=test_now_ns();
+		if (command_dispatch(ctx, rx_vect, tx_vect)!=ZMQ_ERR_NO_ERROR) {
+			printf("upload rejected\n");
+			return;
+		}
+		samples.push_back(test_now_ns()-t_start);
+	}
+	snprintf(name, sizeof(name), "upload %u poses x %u, %u sequences", pose_count, pose_size, seq_count);
+	bench_report(name, samples);
+}
+
+/* SET_POSESIZE, one LOAD_POSE per pose and a LOAD_SEQUENCE through all of them, dispatch only */
+static void bench_pypose_per_pose(command_ctx_t* ctx, uint8_t pose_size, uint8_t pose_count) {
+	std::vector<std::vector<int16_t> > requests;
+	std::vector<int16_t> tx_vect;
+	std::vector<uint64_t> samples;
+	uint64_t t_start;
+	char name[64];
+
+	requests.push_back({PYPOSE_SET_POSESIZE, PYPOSE_ID, pose_size});
+	for (uint8_t pose=0; pose<pose_count; pose++) {
+		requests.push_back({PYPOSE_LOAD_POSE, PYPOSE_ID, pose});
+		for (uint8_t i=0; i<pose_size; i++) {
+			requests.back().push_back((512+i)&0xFF);
+			requests.back().push_back((512+i)>>8);
+		}
+	}
+	requests.push_back({PYPOSE_LOAD_SEQUENCE, PYPOSE_ID});
+	for (uint8_t pose=0; pose<pose_count; pose++) {
+		requests.back().insert(requests.back().end(), {pose, 100, 0});
+	}
+	for (uint32_t r=0; r<BENCH_PYPOSE_LEGACY_ROUNDS; r++) {
+		t_start=test_now_ns();
+		for (size_t i=0; i<requests.size(); i++) {
+			tx_vect.clear();
+			if (command_dispatch(ctx, requests[i], tx_vect)!=ZMQ_ERR_NO_ERROR) {
+				printf("request %zu rejected\n", i);
+				return;
+			}
+		}
+		samples.push_back(test_now_ns()-t_start);
+	}
+	snprintf(name, sizeof(name), "%zu requests, %u poses x %u, 1 sequence", requests.size(), pose_count, pose_size);
+	bench_report(name, samples);
+}
+
+int main(int argc, char** argv) {
+	pthread_t player_thread;
+	pypose_player_ctx_t player;
+	command_ctx_t ctx;
+	pypose_library_t* library;
+	uint64_t t_start;
+
+	pypose_library_init();
+	memset(&player, 0, sizeof(player));
+	pypose_player_init(&player_thread, &player);
+	test_command_ctx(&ctx, NULL, NULL);
+	ctx.player=&player;
+
+	bench_pypose_upload(&ctx, 18, 8, 1);
+	bench_pypose_per_pose(&ctx, 18, 8);
+	bench_pypose_upload(&ctx, 18, 64, 1);
+	bench_pypose_per_pose(&ctx, 18, 64);
+	bench_pypose_upload(&ctx, PYPOSE_MAX_POSE_SIZE, 254, 1);
+	bench_pypose_per_pose(&ctx, PYPOSE_MAX_POSE_SIZE, 254);
+	bench_pypose_upload(&ctx, PYPOSE_MAX_POSE_SIZE, 254, 32);
+
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_PYPOSE_REFS; r++) {
+		library=pypose_library_acquire();
+		pypose_library_release(library);
+	}
+	bench_rate("library acquire+release", BENCH_PYPOSE_REFS, test_now_ns()-t_start);
+	return 0;
+}
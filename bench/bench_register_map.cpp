@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Field lookup (register_map_span) and decoding of a read block per
+ * READ_FIELDS request, then a full AX-12 state read on a simulated bus:
+ * one READ_FIELDS against one READ_DATA per register.
+ */
+#include "bench.h"
+#include "servo_sim.c"
+
+#define BENCH_REGISTER_MAP_ROUNDS   2000000
+#define BENCH_REGISTER_MAP_READS    2000
+
+static void bench_register_map(register_model_t model, const uint8_t* fields, uint8_t count, const char* name) {
+	uint8_t data[DYNAMIXEL_MAX_PARAMETER_COUNT];
+	int16_t values[REGISTER_FIELD_COUNT];
+	uint8_t start;
+	uint8_t length;
+	uint64_t t_start;
+	char label[64];
+
+	for (uint8_t i=0; i<sizeof(data); i++) {
+		data[i]=i*7;
+	}
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_REGISTER_MAP_ROUNDS; r++) {
+		if (!register_map_span(model, fields, count, &start, &length)) {
+			printf("%s: fields not on this model\n", name);
+			return;
+		}
+		BENCH_KEEP(length);
+	}
+	snprintf(label, sizeof(label), "span, %s", name);
+	bench_rate(label, BENCH_REGISTER_MAP_ROUNDS, test_now_ns()-t_start);
+
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_REGISTER_MAP_ROUNDS; r++) {
+		data[r&0x3F]++;
+		register_map_decode(model, fields, count, start, data, values);
+		BENCH_KEEP(values[0]);
+	}
+	snprintf(label, sizeof(label), "decode, %s (%u bytes)", name, length);
+	bench_rate(label, BENCH_REGISTER_MAP_ROUNDS, test_now_ns()-t_start);
+}
+
+/* reads the state fields of servo 1 'rounds' times, as one request or one per field */
+static void bench_register_map_bus(servo_sim_t* sim, command_ctx_t* ctx, const uint8_t* fields, uint8_t count, bool per_field, const char* name) {
+	std::vector<std::vector<int16_t> > requests;
+	std::vector<int16_t> tx_vect;
+	std::vector<uint64_t> samples;
+	servo_sim_stats_t before;
+	servo_sim_stats_t after;
+	uint32_t errors=0;
+	uint64_t t_start;
+
+	if (per_field) {
+		for (uint8_t i=0; i<count; i++) {
+			const register_field_info_t* info=&register_map[REGISTER_MODEL_AX12][fields[i]];
+			requests.push_back({DYNAMIXEL_RQ_READ_DATA, 1, info->address, info->size});
+		}
+	} else {
+		requests.push_back({DYNAMIXEL_RQ_READ_FIELDS, 1, REGISTER_MODEL_AX12});
+		requests[0].insert(requests[0].end(), fields, fields+count);
+	}
+	servo_sim_get_stats(sim, &before);
+	for (uint32_t r=0; r<BENCH_REGISTER_MAP_READS; r++) {
+		t_start=test_now_ns();
+		for (size_t i=0; i<requests.size(); i++) {
+			tx_vect.clear();
+			if (command_dispatch(ctx, requests[i], tx_vect)!=ZMQ_ERR_NO_ERROR) {
+				errors++;
+			}
+		}
+		samples.push_back(test_now_ns()-t_start);
+	}
+	servo_sim_get_stats(sim, &after);
+	bench_report(name, samples);
+	printf("%-40s %8.1f transactions per state read, %u errors\n", "",
+		(double)(after.packets-before.packets)/BENCH_REGISTER_MAP_READS, errors);
+}
+
+int main(int argc, char** argv) {
+	const uint8_t position[]={REGISTER_FIELD_PRESENT_POSITION};
+	const uint8_t state[]={
+		REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_PRESENT_SPEED, REGISTER_FIELD_PRESENT_LOAD,
+		REGISTER_FIELD_PRESENT_VOLTAGE, REGISTER_FIELD_PRESENT_TEMPERATURE, REGISTER_FIELD_MOVING
+	};
+	const uint8_t gains[]={REGISTER_FIELD_P_GAIN, REGISTER_FIELD_I_GAIN, REGISTER_FIELD_D_GAIN, REGISTER_FIELD_GOAL_POSITION};
+	uint8_t everything[REGISTER_FIELD_COUNT];
+	uint8_t count=0;
+
+	/* all AX12 fields */
+	for (uint8_t f=0; f<REGISTER_FIELD_COUNT; f++) {
+		if (register_map[REGISTER_MODEL_AX12][f].address>=0) {
+			everything[count++]=f;
+		}
+	}
+	bench_register_map(REGISTER_MODEL_AX12, position, sizeof(position), "AX12 position");
+	bench_register_map(REGISTER_MODEL_AX12, state, sizeof(state), "AX12 state");
+	bench_register_map(REGISTER_MODEL_MX64, gains, sizeof(gains), "MX64 gains+goal");
+	bench_register_map(REGISTER_MODEL_AX12, everything, count, "AX12 every field");
+
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	calibration_t calibration;
+	command_ctx_t ctx;
+
+	if ((servo_sim_start(&sim, 1, false)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, &bus, &calibration);
+	bench_register_map_bus(&sim, &ctx, state, sizeof(state), false, "AX12 state, READ_FIELDS");
+	bench_register_map_bus(&sim, &ctx, state, sizeof(state), true, "AX12 state, READ_DATA per field");
+	servo_sim_stop(&sim);
+	return 0;
+}
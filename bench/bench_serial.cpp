@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Native transport: status parser throughput and transaction round trips
+ * against simulated servos, next to the same transactions through
+ * libdynamixel's RTU backend on a second simulated bus.
+ */
+#include "bench.h"
+#include "servo_sim.c"
+
+#define BENCH_SERIAL_PARSER_ROUNDS  1000000
+#define BENCH_SERIAL_ROUNDS         5000
+
+static void bench_serial_parser(void) {
+	dynamixel_serial_parser_t parser;
+	/* status packet of id 1 with 6 parameters (position, speed, load) */
+	const uint8_t packet[12]={0xFF, 0xFF, 0x01, 0x08, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0xF4};
+	uint64_t t_start;
+	int ret=0;
+
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_SERIAL_PARSER_ROUNDS; r++) {
+		dynamixel_serial_parser_reset(&parser, 1);
+		for (uint8_t i=0; i<sizeof(packet); i++) {
+			ret=dynamixel_serial_parser_feed(&parser, packet[i]);
+		}
+		BENCH_KEEP(ret);
+	}
+	bench_rate("parse, 12 byte status packet", BENCH_SERIAL_PARSER_ROUNDS, test_now_ns()-t_start);
+	if (ret!=1) {
+		printf("%-40s returns %d\n", "parse, 12 byte status packet", ret);
+	}
+}
+
+static void bench_serial_libdynamixel(void) {
+	servo_sim_t sim;
+	dynamixel_t* dyn;
+	std::vector<uint64_t> samples;
+	uint8_t data[2]={0x00, 0x02};
+	uint8_t* pdata;
+	uint64_t t_start;
+
+	if (servo_sim_start(&sim, 1, false)!=0) {
+		fprintf(stderr, "no simulated bus\n");
+		return;
+	}
+	dyn=dynamixel_new_rtu(sim.device, 1000000, _DYNAMIXEL_SERIAL_DEFAULTS);
+	if ((!dyn) || (dynamixel_connect(dyn)!=0)) {
+		printf("libdynamixel: can't connect to %s, skipped\n", sim.device);
+		if (dyn) {
+			dynamixel_free(dyn);
+		}
+		servo_sim_stop(&sim);
+		return;
+	}
+	for (uint32_t i=0; i<BENCH_SERIAL_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_ping(dyn, 1);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("libdynamixel, ping", samples);
+
+	samples.clear();
+	for (uint32_t i=0; i<BENCH_SERIAL_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_read_data(dyn, 1, (dynamixel_register_t)SERVO_SIM_R_PRESENT_POSITION, 6, &pdata);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("libdynamixel, read 6 bytes", samples);
+
+	samples.clear();
+	for (uint32_t i=0; i<BENCH_SERIAL_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_write_data(dyn, 1, (dynamixel_register_t)SERVO_SIM_R_GOAL_POSITION, 2, data);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("libdynamixel, write", samples);
+
+	dynamixel_close(dyn);
+	dynamixel_free(dyn);
+	servo_sim_stop(&sim);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t port;
+	std::vector<uint64_t> samples;
+	uint8_t data[6]={0x00, 0x02};
+	uint64_t t_start;
+
+	bench_serial_parser();
+	if ((servo_sim_start(&sim, 1, false)!=0) || (servo_sim_connect(&sim, &port)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	for (uint32_t i=0; i<BENCH_SERIAL_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_serial_ping(&port, 1);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("native, ping", samples);
+
+	samples.clear();
+	for (uint32_t i=0; i<BENCH_SERIAL_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_serial_read_data(&port, 1, SERVO_SIM_R_PRESENT_POSITION, 6, data);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("native, read 6 bytes", samples);
+
+	samples.clear();
+	for (uint32_t i=0; i<BENCH_SERIAL_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_serial_write_data(&port, 1, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_GOAL_POSITION, 2, data);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("native, write", samples);
+
+	/* the servo stops answering writes, they are sent without waiting */
+	dynamixel_serial_write_data(&port, 1, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_STATUS_RETURN, 1, (const uint8_t*)"\x01");
+	dynamixel_serial_set_status_return(&port, 1, DYNAMIXEL_SERIAL_RETURN_READ);
+	samples.clear();
+	for (uint32_t i=0; i<BENCH_SERIAL_ROUNDS; i++) {
+		t_start=test_now_ns();
+		dynamixel_serial_write_data(&port, 1, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_GOAL_POSITION, 2, data);
+		samples.push_back(test_now_ns()-t_start);
+	}
+	bench_report("native, write pipelined", samples);
+
+	dynamixel_serial_close(&port);
+	servo_sim_stop(&sim);
+
+	bench_serial_libdynamixel();
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The same-host channel without the service thread: seqlock reads with and
+ * without a concurrent writer, and the goal ring with one to four producers
+ * against a single consumer. For comparison the same state read and goal
+ * write as a msgpack REQ/REP round trip over inproc://, which is what a
+ * local client pays without --shm (minus the bus).
+ */
+#include <sched.h>
+#include "bench.h"
+
+#define BENCH_SHM_ROUNDS            5000000
+#define BENCH_SHM_RING_MS           1000
+#define BENCH_SHM_ZMQ_ROUNDS        20000
+#define BENCH_SHM_ZMQ_URI           "inproc://bench_shm"
+
+typedef struct {
+	dynamixel_shm_t*				shm;
+	uint8_t									id;
+	volatile bool*					stop;
+	uint32_t								count;
+} bench_shm_thread_t;
+
+static void* bench_shm_writer(void* arg) {
+	bench_shm_thread_t* writer=(bench_shm_thread_t*)arg;
+	dynamixel_shm_state_t state;
+
+	memset(&state, 0, sizeof(state));
+	state.valid=1;
+	while (!*writer->stop) {
+		state.position++;
+		dynamixel_shm_write_state(writer->shm, writer->id, &state);
+		writer->count++;
+	}
+	return NULL;
+}
+
+static void* bench_shm_producer(void* arg) {
+	bench_shm_thread_t* producer=(bench_shm_thread_t*)arg;
+
+	while (!*producer->stop) {
+		if (dynamixel_shm_write_goal(producer->shm, producer->id, producer->count&0x3FF, 0)==0) {
+			producer->count++;
+		} else {
+			/* full, let the consumer run on a single core */
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void bench_shm_reads(dynamixel_shm_t* shm, bool contended) {
+	bench_shm_thread_t writer={shm, 1, NULL, 0};
+	volatile bool stop=false;
+	dynamixel_shm_state_t state;
+	pthread_t thread;
+	uint64_t t_start;
+
+	writer.stop=&stop;
+	if (contended) {
+		pthread_create(&thread, NULL, bench_shm_writer, &writer);
+		usleep(1000);
+	}
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_SHM_ROUNDS; r++) {
+		dynamixel_shm_read_state(shm, 1, &state);
+		BENCH_KEEP(state.position);
+	}
+	bench_rate(contended ? "read_state, writer on the same slot" : "read_state", BENCH_SHM_ROUNDS, test_now_ns()-t_start);
+	if (contended) {
+		stop=true;
+		pthread_join(thread, NULL);
+	}
+}
+
+static void bench_shm_ring(dynamixel_shm_t* shm, uint8_t producers) {
+	bench_shm_thread_t producer[4];
+	pthread_t threads[4];
+	dynamixel_shm_command_t command;
+	volatile bool stop=false;
+	uint64_t taken=0;
+	uint64_t t_start;
+	uint64_t t_end;
+	char name[64];
+
+	t_start=test_now_ns();
+	t_end=t_start+BENCH_SHM_RING_MS*1000000ULL;
+	for (uint8_t p=0; p<producers; p++) {
+		producer[p].shm=shm;
+		producer[p].id=1+p;
+		producer[p].stop=&stop;
+		producer[p].count=0;
+		pthread_create(&threads[p], NULL, bench_shm_producer, &producer[p]);
+	}
+	while (test_now_ns()<t_end) {
+		if (dynamixel_shm_take_command(shm, &command)==0) {
+			taken++;
+		} else {
+			sched_yield();
+		}
+	}
+	stop=true;
+	for (uint8_t p=0; p<producers; p++) {
+		pthread_join(threads[p], NULL);
+	}
+	while (dynamixel_shm_take_command(shm, &command)==0) {
+		taken++;
+	}
+	snprintf(name, sizeof(name), "goal ring, %u producer(s)", producers);
+	bench_rate(name, taken, test_now_ns()-t_start);
+}
+
+typedef struct {
+	zmq::context_t*					context;
+	volatile bool						ready;
+} bench_shm_zmq_server_t;
+
+/* answers like the request loop would: the state of a READ_FIELDS_TIMED, or a sync write result */
+static void* bench_shm_zmq_server(void* arg) {
+	bench_shm_zmq_server_t* server=(bench_shm_zmq_server_t*)arg;
+	zmq::socket_t socket(*server->context, ZMQ_REP);
+	std::vector<int16_t> rx_vect;
+	std::vector<int16_t> tx_vect;
+
+	socket.bind(BENCH_SHM_ZMQ_URI);
+	server->ready=true;
+	while (true) {
+		zmq::message_t rx_zmq;
+		msgpack::unpacked rx_msg;
+		msgpack::sbuffer tx_msg;
+
+		if (!socket.recv(&rx_zmq)) {
+			break;
+		}
+		msgpack::unpack(&rx_msg, static_cast<char*>(rx_zmq.data()), rx_zmq.size());
+		rx_vect.clear();
+		rx_msg.get().convert(&rx_vect);
+		tx_vect.clear();
+		if (rx_vect.size() && (rx_vect[0]==DYNAMIXEL_RQ_READ_FIELDS_TIMED)) {
+			/* <err>,<t_reply 4 words>,<duration us>,<position>,<speed>,<load>,<voltage>,<temperature> */
+			tx_vect={ZMQ_ERR_NO_ERROR, 0x1234, 0x5678, 0x1ABC, 0, 120, 512, -20, 100, 120, 40};
+		} else if (rx_vect.size()) {
+			tx_vect={ZMQ_ERR_NO_ERROR, 0};
+		}
+		msgpack::pack(&tx_msg, tx_vect);
+		zmq::message_t tx_zmq(tx_msg.size());
+		memcpy(static_cast<char*>(tx_zmq.data()), tx_msg.data(), tx_msg.size());
+		socket.send(tx_zmq);
+		if (rx_vect.empty()) {
+			break;
+		}
+	}
+	return NULL;
+}
+
+static bool bench_shm_zmq_call(zmq::socket_t* socket, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	msgpack::sbuffer tx_msg;
+	msgpack::unpacked rx_msg;
+	zmq::message_t rx_zmq;
+
+	msgpack::pack(&tx_msg, rx_vect);
+	zmq::message_t tx_zmq(tx_msg.size());
+	memcpy(static_cast<char*>(tx_zmq.data()), tx_msg.data(), tx_msg.size());
+	if ((!socket->send(tx_zmq)) || (!socket->recv(&rx_zmq)) || (rx_zmq.size()==0)) {
+		return false;
+	}
+	msgpack::unpack(&rx_msg, static_cast<char*>(rx_zmq.data()), rx_zmq.size());
+	tx_vect.clear();
+	rx_msg.get().convert(&tx_vect);
+	return true;
+}
+
+static void bench_shm_zmq(void) {
+	zmq::context_t context(1);
+	bench_shm_zmq_server_t server={&context, false};
+	std::vector<int16_t> read_vect={
+		DYNAMIXEL_RQ_READ_FIELDS_TIMED, 1, REGISTER_MODEL_AX12,
+		REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_PRESENT_SPEED, REGISTER_FIELD_PRESENT_LOAD,
+		REGISTER_FIELD_PRESENT_VOLTAGE, REGISTER_FIELD_PRESENT_TEMPERATURE
+	};
+	std::vector<int16_t> write_vect={DYNAMIXEL_RQ_SYNC_WRITE_WORDS, 30, 1, 1, 1, 512};
+	std::vector<int16_t> tx_vect;
+	pthread_t thread;
+	uint64_t t_start;
+	bool ok=true;
+
+	pthread_create(&thread, NULL, bench_shm_zmq_server, &server);
+	while (!server.ready) {
+		sched_yield();
+	}
+	zmq::socket_t socket(context, ZMQ_REQ);
+	socket.connect(BENCH_SHM_ZMQ_URI);
+
+	t_start=test_now_ns();
+	for (uint32_t r=0; ok && (r<BENCH_SHM_ZMQ_ROUNDS); r++) {
+		ok=bench_shm_zmq_call(&socket, read_vect, tx_vect) && (tx_vect.size()==11);
+	}
+	if (ok) {
+		bench_rate("zmq REQ/REP inproc, state read", BENCH_SHM_ZMQ_ROUNDS, test_now_ns()-t_start);
+	}
+	t_start=test_now_ns();
+	for (uint32_t r=0; ok && (r<BENCH_SHM_ZMQ_ROUNDS); r++) {
+		write_vect[5]=r&0x3FF;
+		ok=bench_shm_zmq_call(&socket, write_vect, tx_vect) && (tx_vect.size()==2);
+	}
+	if (ok) {
+		bench_rate("zmq REQ/REP inproc, goal write", BENCH_SHM_ZMQ_ROUNDS, test_now_ns()-t_start);
+		/* an empty request ends the server */
+		write_vect.clear();
+		bench_shm_zmq_call(&socket, write_vect, tx_vect);
+	} else {
+		printf("zmq REQ/REP inproc: no reply, skipped\n");
+	}
+	pthread_join(thread, NULL);
+}
+
+int main(int argc, char** argv) {
+	dynamixel_shm_t* shm;
+	dynamixel_shm_state_t state;
+	dynamixel_shm_command_t command;
+	uint64_t t_start;
+
+	if (posix_memalign((void**)&shm, DYNAMIXEL_SHM_CACHE_LINE, sizeof(dynamixel_shm_t))!=0) {
+		return 1;
+	}
+	/* as dynamixel_shm_service_init() sets it up */
+	memset(shm, 0, sizeof(dynamixel_shm_t));
+	for (uint32_t i=0; i<DYNAMIXEL_SHM_RING_SIZE; i++) {
+		shm->ring[i].seq=i;
+	}
+	memset(&state, 0, sizeof(state));
+	memset(&command, 0, sizeof(command));
+	state.valid=1;
+	dynamixel_shm_write_state(shm, 1, &state);
+
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_SHM_ROUNDS; r++) {
+		state.position=r;
+		dynamixel_shm_write_state(shm, 1, &state);
+	}
+	bench_rate("write_state", BENCH_SHM_ROUNDS, test_now_ns()-t_start);
+	bench_shm_reads(shm, false);
+	bench_shm_reads(shm, true);
+
+	t_start=test_now_ns();
+	for (uint32_t r=0; r<BENCH_SHM_ROUNDS; r++) {
+		dynamixel_shm_write_goal(shm, 1, r&0x3FF, 0);
+		dynamixel_shm_take_command(shm, &command);
+		BENCH_KEEP(command.goal_position);
+	}
+	bench_rate("write_goal+take_command, one thread", BENCH_SHM_ROUNDS, test_now_ns()-t_start);
+	bench_shm_ring(shm, 1);
+	bench_shm_ring(shm, 4);
+	free(shm);
+
+	bench_shm_zmq();
+	return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The poll thread's work per tick without the bus: compiling subscriptions
+ * into reads and evaluating all of them against freshly read data. Polls
+ * are the reads clients polling on their own would do, one per
+ * subscription.
+ */
+#include "bench.h"
+
+#define BENCH_SUBSCRIPTION_TICKS    20000
+#define BENCH_SUBSCRIPTION_SERVOS   32
+
+/* too big for the stack */
+static subscription_service_t bench_service;
+
+static void bench_subscription(uint16_t count) {
+	const register_field_t fields[4]={
+		REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_PRESENT_SPEED,
+		REGISTER_FIELD_PRESENT_LOAD, REGISTER_FIELD_PRESENT_TEMPERATURE
+	};
+	subscription_service_t* service=&bench_service;
+	uint32_t notifications=0;
+	uint64_t t_start;
+	char label[64];
+
+	memset(service, 0, sizeof(*service));
+	pthread_mutex_init(&service->lock, NULL);
+	service->rate=SUBSCRIPTION_RATE;
+	for (uint16_t i=0; i<count; i++) {
+		subscription_add(service, 1+i%BENCH_SUBSCRIPTION_SERVOS, REGISTER_MODEL_AX12, fields[(i/BENCH_SUBSCRIPTION_SERVOS)%4],
+			(subscription_mode_t)(i%SUBSCRIPTION_MODE_COUNT), 4+i%64, (i%3)*20);
+	}
+
+	t_start=test_now_ns();
+	subscription_compile(service);
+	snprintf(label, sizeof(label), "compile, %u subscriptions", count);
+	bench_rate(label, 1, test_now_ns()-t_start);
+	/* what the thread adds to stats.polls and stats.reads each tick */
+	printf("%-40s %u polls vs %u reads per tick\n", "", service->count, service->read_count);
+
+	for (uint16_t r=0; r<service->read_count; r++) {
+		service->reads[r].valid=true;
+	}
+	t_start=test_now_ns();
+	for (uint32_t tick=0; tick<BENCH_SUBSCRIPTION_TICKS; tick++) {
+		/* every value moves a little each tick */
+		for (uint16_t r=0; r<service->read_count; r++) {
+			service->reads[r].data[tick%service->reads[r].length]+=1+(tick&3);
+		}
+		subscription_evaluate(service, tick);
+		notifications+=service->notification_count;
+	}
+	BENCH_KEEP(notifications);
+	snprintf(label, sizeof(label), "evaluate, %u subscriptions", count);
+	bench_rate(label, BENCH_SUBSCRIPTION_TICKS, test_now_ns()-t_start);
+	printf("%-40s %.1f notifications/tick\n", "", (double)notifications/BENCH_SUBSCRIPTION_TICKS);
+}
+
+int main(int argc, char** argv) {
+	bench_subscription(64);
+	bench_subscription(512);
+	bench_subscription(SUBSCRIPTION_MAX);
+	return 0;
+}
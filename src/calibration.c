@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef CALIBRATION_C
+#define CALIBRATION_C
+
+#include <math.h>
+#include <sstream>
+#include "calibration.h"
+
+#define CALIBRATION_DEG           ((float)M_PI/180.0f)
+#define CALIBRATION_RPM           (2.0f*(float)M_PI/60.0f)
+
+typedef struct {
+	const char*	name;
+	float				ticks;				/* register values, 0..ticks-1 */
+	float				ticks_per_range;	/* AX: 0..1023 spans 300 degree, MX: 4096 steps per turn */
+	float				range;				/* rad */
+	float				center;
+	float				speed_unit;		/* rad/s */
+} calibration_model_info_t;
+
+static const calibration_model_info_t calibration_models[CALIBRATION_MODEL_COUNT]={
+	{"AX", 1024.0f, 1023.0f, 300.0f*CALIBRATION_DEG,  512.0f, 0.111f*CALIBRATION_RPM},
+	{"MX", 4096.0f, 4096.0f, 360.0f*CALIBRATION_DEG, 2048.0f, 0.114f*CALIBRATION_RPM},
+};
+
+void calibration_set(calibration_t* calibration, uint8_t id, calibration_model_t model, float offset, int8_t sign, float min, float max) {
+	const calibration_model_info_t* info=&calibration_models[model];
+	float ticks_per_rad=info->ticks_per_range/info->range;
+	float s=(sign<0) ? -1.0f : 1.0f;
+
+	calibration->model[id]=model;
+	calibration->center[id]=info->center;
+	calibration->max_ticks[id]=info->ticks-1.0f;
+	calibration->tick_scale[id]=s*ticks_per_rad;
+	calibration->rad_scale[id]=s/ticks_per_rad;
+	calibration->speed_unit[id]=info->speed_unit;
+	calibration->offset[id]=offset;
+	calibration->min[id]=min;
+	calibration->max[id]=max;
+}
+
+void calibration_init(calibration_t* calibration) {
+	float half=calibration_models[CALIBRATION_MODEL_AX].range/2.0f;
+	for (uint16_t id=0; id<CALIBRATION_MAX_ID; id++) {
+		calibration_set(calibration, id, CALIBRATION_MODEL_AX, 0.0f, 1, -half, half);
+	}
+}
+
+bool calibration_load(calibration_t* calibration, const std::string& filename, bool debug) {
+	std::ifstream file(filename.c_str());
+	std::string line;
+	uint16_t line_no=0;
+
+	if (!file.is_open()) {
+		std::cerr << "Can't open calibration file " << filename << std::endl;
+		return false;
+	}
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string model_name;
+		int id;
+		int sign;
+		float offset, min, max;
+		uint8_t model;
+
+		line_no++;
+		if ((line.find_first_not_of(" \t\r")==std::string::npos) || (line[line.find_first_not_of(" \t")]=='#')) {
+			continue;
+		}
+		if (!(fields >> id >> model_name >> offset >> sign >> min >> max) ||
+				(id<0) || (id>=CALIBRATION_MAX_ID) || (min>max)) {
+			std::cerr << filename << ":" << line_no << ": invalid calibration entry" << std::endl;
+			return false;
+		}
+		for (model=0; model<CALIBRATION_MODEL_COUNT; model++) {
+			if (model_name==calibration_models[model].name) {
+				break;
+			}
+		}
+		if (model==CALIBRATION_MODEL_COUNT) {
+			std::cerr << filename << ":" << line_no << ": unknown model " << model_name << std::endl;
+			return false;
+		}
+		calibration_set(
+			calibration,
+			(uint8_t)id,
+			(calibration_model_t)model,
+			offset*CALIBRATION_DEG,
+			(int8_t)sign,
+			min*CALIBRATION_DEG,
+			max*CALIBRATION_DEG
+		);
+		if (debug) {
+			std::cout << "Calibration #" << id << ": " << model_name
+				<< " offset=" << offset << " sign=" << sign
+				<< " limits=" << min << ".." << max << std::endl;
+		}
+	}
+	return true;
+}
+
+/*
+ * The conversions first gather the per id parameters into dense arrays and
+ * then run a branch free loop over them, which the compiler vectorizes.
+ */
+void calibration_rad_to_ticks(const calibration_t* calibration, const uint8_t* ids, const float* rad, uint16_t* ticks, uint8_t count) {
+	float center[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float max_ticks[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float scale[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float offset[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float min[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float max[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	uint8_t i;
+
+	for (i=0; i<count; i++) {
+		uint8_t id=ids[i];
+		center[i]=calibration->center[id];
+		max_ticks[i]=calibration->max_ticks[id];
+		scale[i]=calibration->tick_scale[id];
+		offset[i]=calibration->offset[id];
+		min[i]=calibration->min[id];
+		max[i]=calibration->max[id];
+	}
+	for (i=0; i<count; i++) {
+		float r=fminf(fmaxf(rad[i], min[i]), max[i]);
+		float t=center[i]+(r-offset[i])*scale[i];
+		t=fminf(fmaxf(t, 0.0f), max_ticks[i]);
+		ticks[i]=(uint16_t)(t+0.5f);
+	}
+}
+
+void calibration_ticks_to_rad(const calibration_t* calibration, const uint8_t* ids, const uint16_t* ticks, float* rad, uint8_t count) {
+	float center[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float scale[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float offset[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	uint8_t i;
+
+	for (i=0; i<count; i++) {
+		uint8_t id=ids[i];
+		center[i]=calibration->center[id];
+		scale[i]=calibration->rad_scale[id];
+		offset[i]=calibration->offset[id];
+	}
+	for (i=0; i<count; i++) {
+		rad[i]=((float)ticks[i]-center[i])*scale[i]+offset[i];
+	}
+}
+
+/* moving speed has no direction, 0 would mean "no limit" so 1 is the minimum */
+void calibration_rad_s_to_speed(const calibration_t* calibration, const uint8_t* ids, const float* rad_s, uint16_t* speed, uint8_t count) {
+	float unit[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	uint8_t i;
+
+	for (i=0; i<count; i++) {
+		unit[i]=calibration->speed_unit[ids[i]];
+	}
+	for (i=0; i<count; i++) {
+		float s=fabsf(rad_s[i])/unit[i];
+		s=fminf(fmaxf(s+0.5f, 1.0f), 1023.0f);
+		speed[i]=(uint16_t)s;
+	}
+}
+
+/* present speed: bit 0..9 magnitude, bit 10 set for CW */
+void calibration_speed_to_rad_s(const calibration_t* calibration, const uint8_t* ids, const uint16_t* speed, float* rad_s, uint8_t count) {
+	float unit[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	uint8_t i;
+
+	for (i=0; i<count; i++) {
+		unit[i]=calibration->speed_unit[ids[i]]*((calibration->rad_scale[ids[i]]<0.0f) ? -1.0f : 1.0f);
+	}
+	for (i=0; i<count; i++) {
+		float magnitude=(float)(speed[i]&0x3FF);
+		float direction=(speed[i]&0x400) ? -1.0f : 1.0f;
+		rad_s[i]=magnitude*direction*unit[i];
+	}
+}
+
+/*
+ * moving speed to cover from..to (ticks) in duration (s), and the time the
+ * servo will actually take with the rounded speed. If one servo can't make
+ * it even at full speed the whole move is stretched to its time, so they
+ * still arrive together. A servo which doesn't move gets speed 1, a speed
+ * of 0 would mean full speed.
+ */
+void calibration_move_speed(const calibration_t* calibration, const uint8_t* ids, const uint16_t* from, const uint16_t* to, float duration, uint16_t* speed, float* arrival, uint8_t count) {
+	float distance[CALIBRATION_MAX_BATCH] CALIBRATION_ALIGNED;
+	float longest=0.0f;
+	float inverse;
+	uint8_t i;
+
+	for (i=0; i<count; i++) {
+		distance[i]=fabsf(calibration->rad_scale[ids[i]])/calibration->speed_unit[ids[i]];
+	}
+	/* in speed units times seconds */
+	for (i=0; i<count; i++) {
+		distance[i]*=fabsf((float)to[i]-(float)from[i]);
+		longest=fmaxf(longest, distance[i]);
+	}
+	inverse=1.0f/fmaxf(duration, longest/1023.0f);
+	for (i=0; i<count; i++) {
+		float s=fminf(fmaxf(floorf(distance[i]*inverse+0.5f), 1.0f), 1023.0f);
+		speed[i]=(uint16_t)s;
+		arrival[i]=distance[i]/s;
+	}
+}
+
+/* present load: bit 0..9 magnitude, bit 10 set for CW */
+void calibration_load_to_norm(const uint16_t* load, float* norm, uint8_t count) {
+	for (uint8_t i=0; i<count; i++) {
+		float magnitude=(float)(load[i]&0x3FF)/1023.0f;
+		norm[i]=(load[i]&0x400) ? -magnitude : magnitude;
+	}
+}
+
+#endif
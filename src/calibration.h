@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+/*
+ * Per servo calibration and batch conversion between raw register values
+ * and engineering units (rad, rad/s, load -1..1).
+ *
+ * calibration file, one servo per line, angles in degree:
+ *   # id  model  offset  sign  min     max
+ *   1     AX     0.0     1     -150.0  150.0
+ *   2     MX     -12.5   -1    -90.0   90.0
+ * servos which are not listed are treated as centered AX servos.
+ */
+#include <string>
+
+#define CALIBRATION_MAX_ID        254
+#define CALIBRATION_MAX_BATCH     DYNAMIXEL_MAX_PARAMETER_COUNT
+#define CALIBRATION_ALIGNED       __attribute__((aligned(32)))
+
+/* same addresses on AX and MX */
+#define CALIBRATION_R_PRESENT_POSITION_L  ((dynamixel_register_t)36)
+
+typedef enum {
+	CALIBRATION_MODEL_AX,				/* AX-12, AX-18 */
+	CALIBRATION_MODEL_MX,				/* MX-28, MX-64 */
+	CALIBRATION_MODEL_COUNT,
+} calibration_model_t;
+
+/* indexed by servo id */
+typedef struct {
+	uint8_t		model[CALIBRATION_MAX_ID];
+	float			center[CALIBRATION_MAX_ID];				/* ticks */
+	float			max_ticks[CALIBRATION_MAX_ID];
+	float			tick_scale[CALIBRATION_MAX_ID];		/* ticks per rad, signed */
+	float			rad_scale[CALIBRATION_MAX_ID];		/* rad per tick, signed */
+	float			speed_unit[CALIBRATION_MAX_ID];		/* rad/s per speed unit */
+	float			offset[CALIBRATION_MAX_ID];				/* rad */
+	float			min[CALIBRATION_MAX_ID];					/* rad */
+	float			max[CALIBRATION_MAX_ID];					/* rad */
+} calibration_t;
+
+void calibration_init(calibration_t* calibration);
+void calibration_set(calibration_t* calibration, uint8_t id, calibration_model_t model, float offset, int8_t sign, float min, float max);
+bool calibration_load(calibration_t* calibration, const std::string& filename, bool debug);
+
+/* batch conversion, ids[i] selects the calibration of element i */
+void calibration_rad_to_ticks(const calibration_t* calibration, const uint8_t* ids, const float* rad, uint16_t* ticks, uint8_t count);
+void calibration_ticks_to_rad(const calibration_t* calibration, const uint8_t* ids, const uint16_t* ticks, float* rad, uint8_t count);
+void calibration_rad_s_to_speed(const calibration_t* calibration, const uint8_t* ids, const float* rad_s, uint16_t* speed, uint8_t count);
+void calibration_speed_to_rad_s(const calibration_t* calibration, const uint8_t* ids, const uint16_t* speed, float* rad_s, uint8_t count);
+void calibration_load_to_norm(const uint16_t* load, float* norm, uint8_t count);
+void calibration_move_speed(const calibration_t* calibration, const uint8_t* ids, const uint16_t* from, const uint16_t* to, float duration, uint16_t* speed, float* arrival, uint8_t count);
+
+#endif
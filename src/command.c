@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef COMMAND_C
+#define COMMAND_C
+
+#include <stdexcept>
+#include "command.h"
+
+/* zero initialized, so registering from constructors is safe */
+static const command_t* command_table[COMMAND_TABLE_SIZE];
+
+void command_register(const command_t* command) {
+	if (command->id>=COMMAND_TABLE_SIZE) {
+		fprintf(stderr, "Command %s: id 0x%X out of range\n", command->name, command->id);
+		return;
+	}
+	if (command_table[command->id]) {
+		fprintf(stderr, "Command %s: id 0x%X already used by %s\n", command->name, command->id, command_table[command->id]->name);
+		return;
+	}
+	command_table[command->id]=command;
+}
+
+const command_t* command_lookup(int16_t id) {
+	if ((id<0) || (id>=COMMAND_TABLE_SIZE)) {
+		return NULL;
+	}
+	return command_table[id];
+}
+
+static int16_t command_check_arg(const command_arg_t* arg, int16_t value) {
+	if ((arg->kind==COMMAND_ARG_UNCHECKED) || ((value>=arg->min) && (value<=arg->max))) {
+		return ZMQ_ERR_NO_ERROR;
+	}
+	return (arg->kind==COMMAND_ARG_ID) ? ZMQ_ERR_INVALID_ID : ZMQ_ERR_INVALID_PARAMETERS;
+}
+
+int16_t command_validate(const command_t* command, const std::vector<int16_t>& rx_vect) {
+	size_t arg_count=rx_vect.size()-1;
+	int16_t ret;
+
+	if ((arg_count<command->min_args) || (arg_count>command->max_args)) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	for (size_t i=0; i<arg_count; i++) {
+		ret=command_check_arg((i<command->typed) ? &command->args[i] : &command->tail, rx_vect[i+1]);
+		if (ret) {
+			return ret;
+		}
+	}
+	if (command->validate) {
+		return command->validate(rx_vect);
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+
+/* for validators: the ids at rx_vect[first], rx_vect[first+stride], ... are below max */
+int16_t command_check_ids(const std::vector<int16_t>& rx_vect, size_t first, size_t stride, int16_t max) {
+	for (size_t i=first; i<rx_vect.size(); i+=stride) {
+		if ((rx_vect[i]<0) || (rx_vect[i]>=max)) {
+			return ZMQ_ERR_INVALID_ID;
+		}
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+
+void command_push_time(std::vector<int16_t>& tx_vect, uint64_t ns) {
+	for (uint8_t i=0; i<4; i++) {
+		tx_vect.push_back((int16_t)(uint16_t)(ns>>(16*i)));
+	}
+}
+
+/* arrival of the status packet and the bus time in us, saturated */
+void command_push_timing(std::vector<int16_t>& tx_vect, const dynamixel_bus_timing_t* timing) {
+	uint32_t duration_us=timing->duration_ns/1000;
+	command_push_time(tx_vect, timing->t_reply_ns);
+	tx_vect.push_back((duration_us>INT16_MAX) ? INT16_MAX : (int16_t)duration_us);
+}
+
+int16_t command_dispatch(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	const command_t* command;
+	int16_t ret;
+
+	if (rx_vect.empty()) {
+		return ZMQ_ERR_INVALID_FORMAT;
+	}
+	command=command_lookup(rx_vect[0]);
+	if (!command) {
+		return ZMQ_ERR_INVALID_COMMAND;
+	}
+	ret=command_validate(command, rx_vect);
+	if (ret) {
+		return ret;
+	}
+	if ((command->flags&COMMAND_NEEDS_BUS) && !ctx->bus_online) {
+		return ZMQ_ERR_BUS_OFFLINE;
+	}
+	try {
+		return command->handler(ctx, rx_vect, tx_vect);
+	} catch(std::out_of_range& e) {
+		/* a handler read past a message its schema let through */
+		std::cerr << "Command " << command->name << ": " << e.what() << std::endl;
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+}
+
+#endif
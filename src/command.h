@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef COMMAND_H
+#define COMMAND_H
+
+/*
+ * Command registry.
+ *
+ * Every zmq command is a command_t with its argument schema and a handler,
+ * modules register them with COMMAND_REGISTER() next to the handler. The
+ * schema is checked once in command_dispatch(), so handlers only see
+ * messages of the right length with every typed argument in range.
+ * What the schema can't express (a length given inside the message, ids
+ * inside repeated groups) goes into the optional validate hook, which
+ * runs right after the schema.
+ *
+ * Arguments are counted without the command word:
+ *   <cmd>,<arg0>,<arg1>,...
+ *
+ * Timestamps are CLOCK_MONOTONIC nanoseconds of the service, sent as four
+ * words with the lowest first. DYNAMIXEL_RQ_TIME_SYNC lets clients map
+ * them to their own clock.
+ */
+#include <vector>
+
+#define COMMAND_TABLE_SIZE          0x500		/* command ids are looked up directly */
+#define COMMAND_MAX_TYPED           8
+#define COMMAND_ARGS_ANY            0xFFFF
+#define COMMAND_BROADCAST_ID        254
+#define COMMAND_MOVE_MAX_IDS        ((DYNAMIXEL_MAX_PARAMETER_COUNT-2)/5)	/* id + two words each */
+
+/* flags */
+#define COMMAND_NEEDS_BUS           0x01		/* fails with ZMQ_ERR_BUS_OFFLINE without a connection */
+
+typedef enum {
+	COMMAND_ARG_UNCHECKED=0,
+	COMMAND_ARG_VALUE,			/* out of range: ZMQ_ERR_INVALID_PARAMETERS */
+	COMMAND_ARG_ID,					/* out of range: ZMQ_ERR_INVALID_ID */
+} command_arg_kind_t;
+
+typedef struct {
+	uint8_t					kind;
+	int16_t					min;
+	int16_t					max;
+} command_arg_t;
+
+#define COMMAND_ANY                 {COMMAND_ARG_UNCHECKED, 0, 0}
+#define COMMAND_VALUE(min, max)     {COMMAND_ARG_VALUE, (min), (max)}
+#define COMMAND_ID(min, max)        {COMMAND_ARG_ID, (min), (max)}
+#define COMMAND_SERVO_ID            COMMAND_ID(0, COMMAND_BROADCAST_ID)
+#define COMMAND_BYTE                COMMAND_VALUE(0, 255)
+
+/*
+ * everything a handler may touch. There is a single dispatcher thread, so
+ * the scratch buffers are shared between all handlers.
+ */
+typedef struct {
+	bool											debug;
+	bool											bus_online;
+	dynamixel_bus_t*					bus;
+	calibration_t*						calibration;
+	subscription_service_t*		subscriptions;	/* NULL without --pub */
+	uint64_t									t_receive_ns;		/* when the current request came in */
+#ifdef ENABLE_PYPOSE_COMMANDS
+	pypose_player_ctx_t*			player;
+#endif
+#ifdef ENABLE_GAIT_ENGINE
+	gait_ctx_t*								gait;
+#endif
+
+	/* DYNAMIXEL_RQ_MOVE_SYNC: last goal per id, its bus tag and when the servo gets there */
+	uint32_t									move_tag;
+	uint16_t									move_goal[CALIBRATION_MAX_ID];
+	uint32_t									move_goal_tag[CALIBRATION_MAX_ID];
+	uint64_t									move_end_ns[CALIBRATION_MAX_ID];
+
+	/* i decided to use a static buffer instead of malloc on every call */
+	uint8_t										tmp_uint8[DYNAMIXEL_MAX_PARAMETER_COUNT];
+	uint16_t									tmp_uint16[DYNAMIXEL_MAX_PARAMETER_COUNT];
+	uint8_t										tmp_ids[CALIBRATION_MAX_BATCH];
+	int16_t										tmp_int16[REGISTER_FIELD_COUNT];
+	uint16_t									tmp_raw[3][CALIBRATION_MAX_BATCH];
+	float											tmp_float[3][CALIBRATION_MAX_BATCH];
+} command_ctx_t;
+
+/* returns a zmq_error_code_t, on success the reply is in tx_vect */
+typedef int16_t (*command_handler_t)(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect);
+/* returns a zmq_error_code_t, only called for messages that passed the schema */
+typedef int16_t (*command_validator_t)(const std::vector<int16_t>& rx_vect);
+
+typedef struct {
+	uint16_t									id;
+	const char*								name;
+	command_handler_t					handler;
+	uint8_t										flags;
+	uint16_t									min_args;
+	uint16_t									max_args;
+	command_arg_t							tail;									/* every argument after the typed ones */
+	uint8_t										typed;
+	command_arg_t							args[COMMAND_MAX_TYPED];
+	command_validator_t				validate;							/* NULL if the schema says it all */
+} command_t;
+
+#define COMMAND_REGISTER(command) \
+	static void __attribute__((constructor)) command_register_##command(void) { \
+		command_register(&command); \
+	}
+
+void command_register(const command_t* command);
+const command_t* command_lookup(int16_t id);
+int16_t command_validate(const command_t* command, const std::vector<int16_t>& rx_vect);
+int16_t command_check_ids(const std::vector<int16_t>& rx_vect, size_t first, size_t stride, int16_t max);
+void command_push_time(std::vector<int16_t>& tx_vect, uint64_t ns);
+void command_push_timing(std::vector<int16_t>& tx_vect, const dynamixel_bus_timing_t* timing);
+int16_t command_dispatch(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect);
+
+#endif
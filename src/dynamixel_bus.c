@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_BUS_C
+#define DYNAMIXEL_BUS_C
+
+#include <sched.h>
+#include "dynamixel_bus.h"
+
+static inline uint64_t dynamixel_bus_ns(const struct timespec* ts) {
+	return (uint64_t)ts->tv_sec*1000000000ULL + ts->tv_nsec;
+}
+
+/* intrusive multi-producer/single-consumer queue (D. Vyukov) */
+static void dynamixel_bus_queue_init(dynamixel_bus_queue_t* queue) {
+	queue->stub.next=NULL;
+	queue->head=&queue->stub;
+	queue->tail=&queue->stub;
+}
+
+static void dynamixel_bus_queue_push(dynamixel_bus_queue_t* queue, dynamixel_bus_request_t* request) {
+	dynamixel_bus_request_t* prev;
+	__atomic_store_n(&request->next, (dynamixel_bus_request_t*)NULL, __ATOMIC_RELAXED);
+	prev=__atomic_exchange_n(&queue->head, request, __ATOMIC_ACQ_REL);
+	__atomic_store_n(&prev->next, request, __ATOMIC_RELEASE);
+}
+
+/* returns NULL if empty or if a producer is between exchange and link */
+static dynamixel_bus_request_t* dynamixel_bus_queue_pop(dynamixel_bus_queue_t* queue) {
+	dynamixel_bus_request_t* tail=queue->tail;
+	dynamixel_bus_request_t* next=__atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+	if (tail==&queue->stub) {
+		if (next==NULL) {
+			return NULL;
+		}
+		queue->tail=next;
+		tail=next;
+		next=__atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	}
+	if (next) {
+		queue->tail=next;
+		return tail;
+	}
+	if (tail!=__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+	dynamixel_bus_queue_push(queue, &queue->stub);
+	next=__atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+	if (next) {
+		queue->tail=next;
+		return tail;
+	}
+	return NULL;
+}
+
+static inline bool dynamixel_bus_covers_goal(uint8_t address, uint16_t length) {
+	return (address<=DYNAMIXEL_R_GOAL_POSITION_L+1) && (address+length>DYNAMIXEL_R_GOAL_POSITION_L);
+}
+
+static void dynamixel_bus_set_goal_tag(dynamixel_bus_t* bus, uint8_t id, uint32_t tag) {
+	if (id<DYNAMIXEL_BUS_MAX_ID) {
+		__atomic_store_n(&bus->goal_tag[id], tag, __ATOMIC_RELAXED);
+	} else if (id==DYNAMIXEL_BUS_MAX_ID) {
+		/* broadcast */
+		for (uint8_t i=0; i<DYNAMIXEL_BUS_MAX_ID; i++) {
+			__atomic_store_n(&bus->goal_tag[i], tag, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/* any write touching the goal position, even a partial or failed one, replaces the tag */
+static void dynamixel_bus_track_goal(dynamixel_bus_t* bus, const dynamixel_bus_request_t* request) {
+	switch (request->op) {
+		case DYNAMIXEL_BUS_OP_WRITE_DATA:
+		case DYNAMIXEL_BUS_OP_REG_WRITE:
+			if (dynamixel_bus_covers_goal(request->address, request->count)) {
+				dynamixel_bus_set_goal_tag(bus, request->id, 0);
+			}
+			break;
+		case DYNAMIXEL_BUS_OP_SYNC_WRITE:
+			if (dynamixel_bus_covers_goal(request->address, request->param_count)) {
+				for (uint8_t i=0; i<request->count; i++) {
+					dynamixel_bus_set_goal_tag(bus, request->data[i*(request->param_count+1)], 0);
+				}
+			}
+			break;
+		case DYNAMIXEL_BUS_OP_SYNC_WRITE_WORDS:
+			if (dynamixel_bus_covers_goal(request->address, request->param_count*2)) {
+				for (uint8_t i=0; i<request->count; i++) {
+					dynamixel_bus_set_goal_tag(bus, request->words[i*(request->param_count+1)], request->tag);
+				}
+			}
+			break;
+		case DYNAMIXEL_BUS_OP_WRITE_PACKET:
+			/* <ff>,<ff>,<id>,<length>,<instruction>,<address>,<bytes per id>,<id>,... */
+			if ((request->packet_len>7) && (request->packet[4]==DYNAMIXEL_SERIAL_SYNC_WRITE) &&
+					dynamixel_bus_covers_goal(request->packet[5], request->packet[6])) {
+				for (uint16_t i=7; i+1<request->packet_len; i+=request->packet[6]+1) {
+					dynamixel_bus_set_goal_tag(bus, request->packet[i], 0);
+				}
+			} else if ((request->packet_len>6) &&
+					((request->packet[4]==DYNAMIXEL_SERIAL_WRITE_DATA) || (request->packet[4]==DYNAMIXEL_SERIAL_REG_WRITE)) &&
+					dynamixel_bus_covers_goal(request->packet[5], request->packet_len-7)) {
+				dynamixel_bus_set_goal_tag(bus, request->packet[2], 0);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static void dynamixel_bus_execute_serial(dynamixel_bus_t* bus, dynamixel_bus_request_t* request) {
+	switch (request->op) {
+		case DYNAMIXEL_BUS_OP_PING:
+			request->ret=dynamixel_serial_ping(bus->serial, request->id);
+			break;
+		case DYNAMIXEL_BUS_OP_READ_DATA:
+			request->ret=dynamixel_serial_read_data(bus->serial, request->id, request->address, request->count, request->data);
+			break;
+		case DYNAMIXEL_BUS_OP_WRITE_DATA:
+			request->ret=dynamixel_serial_write_data(bus->serial, request->id, DYNAMIXEL_SERIAL_WRITE_DATA, request->address, request->count, request->data);
+			break;
+		case DYNAMIXEL_BUS_OP_REG_WRITE:
+			request->ret=dynamixel_serial_write_data(bus->serial, request->id, DYNAMIXEL_SERIAL_REG_WRITE, request->address, request->count, request->data);
+			break;
+		case DYNAMIXEL_BUS_OP_ACTION:
+			request->ret=dynamixel_serial_transaction(bus->serial, request->id, DYNAMIXEL_SERIAL_ACTION, NULL, 0, 0);
+			break;
+		case DYNAMIXEL_BUS_OP_RESET:
+			request->ret=dynamixel_serial_transaction(bus->serial, request->id, DYNAMIXEL_SERIAL_RESET, NULL, 0, 0);
+			break;
+		case DYNAMIXEL_BUS_OP_SYNC_WRITE:
+			request->ret=dynamixel_serial_sync_write(bus->serial, request->address, request->count, request->param_count, request->data);
+			break;
+		case DYNAMIXEL_BUS_OP_SYNC_WRITE_WORDS:
+			request->ret=dynamixel_serial_sync_write_words(bus->serial, request->address, request->count, request->param_count, request->words);
+			break;
+		case DYNAMIXEL_BUS_OP_WRITE_PACKET:
+			request->ret=dynamixel_serial_write_packet(bus->serial, request->packet, request->packet_len);
+			break;
+#ifdef ENABLE_TROSSEN_COMMANDER
+		case DYNAMIXEL_BUS_OP_TROSSEN_CMD:
+			/* commander packets are a libdynamixel extension */
+			request->ret=DYNAMIXEL_SERIAL_ERR_IO;
+			break;
+#endif
+	}
+}
+
+static void dynamixel_bus_execute(dynamixel_bus_t* bus, dynamixel_bus_request_t* request) {
+	uint8_t* pdata;
+	struct timespec t_start;
+	struct timespec t_end;
+
+	if (bus->serial) {
+		dynamixel_bus_execute_serial(bus, request);
+		request->timing.t_reply_ns=bus->serial->t_reply_ns;
+		request->timing.duration_ns=bus->serial->wall_ns;
+		return;
+	}
+
+	/* libdynamixel returns once the reply is parsed, that is as close as it gets */
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+	switch (request->op) {
+		case DYNAMIXEL_BUS_OP_PING:
+			request->ret=dynamixel_ping(bus->dynamixel_ctx, request->id);
+			break;
+		case DYNAMIXEL_BUS_OP_READ_DATA:
+			request->ret=dynamixel_read_data(
+				bus->dynamixel_ctx,
+				request->id,
+				request->address,
+				request->count,
+				&pdata
+			);
+			/* libdynamixel hands out its rx buffer, copy before the next transaction */
+			if (request->ret>0) {
+				memcpy(request->data, pdata, request->ret);
+			}
+			break;
+		case DYNAMIXEL_BUS_OP_WRITE_DATA:
+			request->ret=dynamixel_write_data(
+				bus->dynamixel_ctx,
+				request->id,
+				request->address,
+				request->count,
+				request->data
+			);
+			break;
+		case DYNAMIXEL_BUS_OP_REG_WRITE:
+			request->ret=dynamixel_reg_write(
+				bus->dynamixel_ctx,
+				request->id,
+				request->address,
+				request->count,
+				request->data
+			);
+			break;
+		case DYNAMIXEL_BUS_OP_ACTION:
+			request->ret=dynamixel_action(bus->dynamixel_ctx, request->id);
+			break;
+		case DYNAMIXEL_BUS_OP_RESET:
+			request->ret=dynamixel_reset(bus->dynamixel_ctx, request->id);
+			break;
+		case DYNAMIXEL_BUS_OP_SYNC_WRITE:
+			request->ret=dynamixel_sync_write(
+				bus->dynamixel_ctx,
+				request->address,
+				request->count,
+				request->param_count,
+				request->data
+			);
+			break;
+		case DYNAMIXEL_BUS_OP_SYNC_WRITE_WORDS:
+			request->ret=dynamixel_sync_write_words(
+				bus->dynamixel_ctx,
+				request->address,
+				request->count,
+				request->param_count,
+				request->words
+			);
+			break;
+		case DYNAMIXEL_BUS_OP_WRITE_PACKET:
+			request->ret=DYNAMIXEL_SERIAL_ERR_IO;
+			break;
+#ifdef ENABLE_TROSSEN_COMMANDER
+		case DYNAMIXEL_BUS_OP_TROSSEN_CMD:
+			request->ret=dynamixel_adv_trossen_cmd(bus->dynamixel_ctx, (trossen_cmd_t*)request->arg);
+			break;
+#endif
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	request->timing.t_reply_ns=dynamixel_bus_ns(&t_end);
+	request->timing.duration_ns=dynamixel_bus_ns(&t_end)-dynamixel_bus_ns(&t_start);
+}
+
+void *dynamixel_bus_thread(void* arg) {
+	dynamixel_bus_t* bus=(dynamixel_bus_t*)arg;
+	dynamixel_bus_request_t* request;
+	struct timespec t_start;
+	uint64_t wait_ns;
+	bool priority;
+
+	while (true) {
+		/* one post per pushed request, so there is always something to pop */
+		while (sem_wait(&bus->pending)!=0) {
+		}
+		do {
+			request=dynamixel_bus_queue_pop(&bus->priority_queue);
+			priority=(request!=NULL);
+			if (!request) {
+				request=dynamixel_bus_queue_pop(&bus->queue);
+			}
+			if (!request) {
+				sched_yield();
+			}
+		} while (!request);
+
+		if (priority) {
+			clock_gettime(CLOCK_MONOTONIC, &t_start);
+			wait_ns=dynamixel_bus_ns(&t_start)-dynamixel_bus_ns(&request->t_submit);
+			bus->stats.priority_transactions++;
+			bus->stats.priority_wait_ns_sum+=wait_ns;
+			if (wait_ns>bus->stats.priority_wait_ns_max) {
+				bus->stats.priority_wait_ns_max=wait_ns;
+			}
+		}
+		dynamixel_bus_track_goal(bus, request);
+		dynamixel_bus_execute(bus, request);
+		bus->stats.transactions++;
+		sem_post(&request->done);
+	}
+	return NULL;
+}
+
+void dynamixel_bus_init(dynamixel_bus_t* bus, dynamixel_t* dyn, dynamixel_serial_t* serial) {
+	bus->dynamixel_ctx=dyn;
+	bus->serial=serial;
+	memset(&bus->stats, 0, sizeof(bus->stats));
+	memset(bus->goal_tag, 0, sizeof(bus->goal_tag));
+	dynamixel_bus_queue_init(&bus->queue);
+	dynamixel_bus_queue_init(&bus->priority_queue);
+	sem_init(&bus->pending, 0, 0);
+
+	pthread_create(&bus->thread, NULL, &dynamixel_bus_thread, (void*)bus);
+}
+
+int16_t dynamixel_bus_call(dynamixel_bus_t* bus, dynamixel_bus_request_t* request, bool priority) {
+	sem_init(&request->done, 0, 0);
+	clock_gettime(CLOCK_MONOTONIC, &request->t_submit);
+	if (priority) {
+		dynamixel_bus_queue_push(&bus->priority_queue, request);
+	} else {
+		dynamixel_bus_queue_push(&bus->queue, request);
+	}
+	sem_post(&bus->pending);
+
+	while (sem_wait(&request->done)!=0) {
+	}
+	sem_destroy(&request->done);
+	return request->ret;
+}
+
+int16_t dynamixel_bus_ping(dynamixel_bus_t* bus, uint8_t id) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_PING;
+	request.id=id;
+	return dynamixel_bus_call(bus, &request, false);
+}
+
+int16_t dynamixel_bus_read_data(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data) {
+	return dynamixel_bus_read_data_timed(bus, id, address, count, data, NULL);
+}
+
+int16_t dynamixel_bus_read_data_timed(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data, dynamixel_bus_timing_t* timing) {
+	dynamixel_bus_request_t request;
+	int16_t ret;
+	request.op=DYNAMIXEL_BUS_OP_READ_DATA;
+	request.id=id;
+	request.address=address;
+	request.count=count;
+	request.data=data;
+	ret=dynamixel_bus_call(bus, &request, false);
+	if (timing) {
+		*timing=request.timing;
+	}
+	return ret;
+}
+
+int16_t dynamixel_bus_write_data(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_WRITE_DATA;
+	request.id=id;
+	request.address=address;
+	request.count=count;
+	request.data=data;
+	return dynamixel_bus_call(bus, &request, false);
+}
+
+int16_t dynamixel_bus_reg_write(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_REG_WRITE;
+	request.id=id;
+	request.address=address;
+	request.count=count;
+	request.data=data;
+	return dynamixel_bus_call(bus, &request, false);
+}
+
+int16_t dynamixel_bus_action(dynamixel_bus_t* bus, uint8_t id) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_ACTION;
+	request.id=id;
+	return dynamixel_bus_call(bus, &request, false);
+}
+
+int16_t dynamixel_bus_reset(dynamixel_bus_t* bus, uint8_t id) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_RESET;
+	request.id=id;
+	return dynamixel_bus_call(bus, &request, false);
+}
+
+int16_t dynamixel_bus_sync_write(dynamixel_bus_t* bus, dynamixel_register_t address, uint8_t id_count, uint8_t param_count, uint8_t* data) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_SYNC_WRITE;
+	request.address=address;
+	request.count=id_count;
+	request.param_count=param_count;
+	request.data=data;
+	return dynamixel_bus_call(bus, &request, false);
+}
+
+int16_t dynamixel_bus_sync_write_words(dynamixel_bus_t* bus, dynamixel_register_t address, uint8_t id_count, uint8_t word_count, uint16_t* data, bool priority) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_SYNC_WRITE_WORDS;
+	request.address=address;
+	request.count=id_count;
+	request.param_count=word_count;
+	request.words=data;
+	request.tag=0;
+	return dynamixel_bus_call(bus, &request, priority);
+}
+
+/* data: <id>, <goal position>, <moving speed>, <id+1>, ... */
+int16_t dynamixel_bus_sync_write_goals(dynamixel_bus_t* bus, uint8_t id_count, uint16_t* data, uint32_t tag) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_SYNC_WRITE_WORDS;
+	request.address=DYNAMIXEL_R_GOAL_POSITION_L;
+	request.count=id_count;
+	request.param_count=2;
+	request.words=data;
+	request.tag=tag;
+	return dynamixel_bus_call(bus, &request, false);
+}
+
+/* a complete instruction packet, checksum included */
+int16_t dynamixel_bus_write_packet(dynamixel_bus_t* bus, const uint8_t* packet, uint16_t len, bool priority) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_WRITE_PACKET;
+	request.packet=packet;
+	request.packet_len=len;
+	return dynamixel_bus_call(bus, &request, priority);
+}
+
+#ifdef ENABLE_TROSSEN_COMMANDER
+int16_t dynamixel_bus_trossen_cmd(dynamixel_bus_t* bus, trossen_cmd_t* command) {
+	dynamixel_bus_request_t request;
+	request.op=DYNAMIXEL_BUS_OP_TROSSEN_CMD;
+	request.arg=command;
+	return dynamixel_bus_call(bus, &request, false);
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_BUS_H
+#define DYNAMIXEL_BUS_H
+
+/*
+ * The bus owner thread is the only one talking to the dynamixel handle.
+ * Every other thread (zmq loop, sequence player, ...) pushes requests into
+ * one of two lock-free multi-producer queues and gets woken up by a
+ * semaphore once its request has been executed.
+ * The priority queue is always drained before the normal one, so a player
+ * tick waits for at most one transaction which is already on the wire.
+ *
+ * Requests are executed either through libdynamixel or through the native
+ * transport in dynamixel_serial.h.
+ *
+ * The bus thread also notes which request last wrote the goal position of
+ * each servo (goal_tag, 0 for untagged writes), so a caller can tell if its
+ * own goal is still the one the servo is heading for.
+ *
+ * dynamixel_bus_write_packet() hands a packet that was encoded ahead of time
+ * to the native transport as it is, libdynamixel can only send what it
+ * encodes itself and fails it.
+ */
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#define DYNAMIXEL_BUS_MAX_ID          254
+
+typedef enum {
+	DYNAMIXEL_BUS_OP_PING,
+	DYNAMIXEL_BUS_OP_READ_DATA,
+	DYNAMIXEL_BUS_OP_WRITE_DATA,
+	DYNAMIXEL_BUS_OP_REG_WRITE,
+	DYNAMIXEL_BUS_OP_ACTION,
+	DYNAMIXEL_BUS_OP_RESET,
+	DYNAMIXEL_BUS_OP_SYNC_WRITE,
+	DYNAMIXEL_BUS_OP_SYNC_WRITE_WORDS,
+	DYNAMIXEL_BUS_OP_WRITE_PACKET,
+#ifdef ENABLE_TROSSEN_COMMANDER
+	DYNAMIXEL_BUS_OP_TROSSEN_CMD,
+#endif
+} dynamixel_bus_op_t;
+
+/* when the status packet arrived (CLOCK_MONOTONIC) and how long the bus was busy */
+typedef struct {
+	uint64_t												t_reply_ns;
+	uint32_t												duration_ns;
+} dynamixel_bus_timing_t;
+
+typedef struct dynamixel_bus_request_s {
+	struct dynamixel_bus_request_s*	next;
+	dynamixel_bus_op_t							op;
+	uint8_t													id;
+	dynamixel_register_t						address;
+	uint8_t													count;				/* bytes or id-count for sync writes */
+	uint8_t													param_count;	/* parameters/words per id for sync writes */
+	uint8_t*												data;					/* in for writes, out for reads */
+	uint16_t*												words;
+	const uint8_t*									packet;				/* prebuilt, native transport only */
+	uint16_t												packet_len;
+	uint32_t												tag;					/* goal writes, see goal_tag */
+	void*														arg;
+	int16_t													ret;
+	struct timespec									t_submit;
+	dynamixel_bus_timing_t					timing;
+	sem_t														done;
+} dynamixel_bus_request_t;
+
+typedef struct {
+	dynamixel_bus_request_t*				head;
+	dynamixel_bus_request_t*				tail;
+	dynamixel_bus_request_t					stub;
+} dynamixel_bus_queue_t;
+
+typedef struct {
+	/* written by the bus thread only */
+	uint32_t												transactions;
+	uint32_t												priority_transactions;
+	uint64_t												priority_wait_ns_sum;
+	uint64_t												priority_wait_ns_max;
+} dynamixel_bus_stats_t;
+
+typedef struct {
+	bool														debug;
+	dynamixel_t*										dynamixel_ctx;
+	dynamixel_serial_t*							serial;				/* native transport, NULL for libdynamixel */
+	dynamixel_bus_queue_t						queue;
+	dynamixel_bus_queue_t						priority_queue;
+	sem_t														pending;
+	dynamixel_bus_stats_t						stats;
+	uint32_t												goal_tag[DYNAMIXEL_BUS_MAX_ID];
+	pthread_t												thread;
+} dynamixel_bus_t;
+
+void dynamixel_bus_init(dynamixel_bus_t* bus, dynamixel_t* dyn, dynamixel_serial_t* serial);
+int16_t dynamixel_bus_call(dynamixel_bus_t* bus, dynamixel_bus_request_t* request, bool priority);
+
+int16_t dynamixel_bus_ping(dynamixel_bus_t* bus, uint8_t id);
+int16_t dynamixel_bus_read_data(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data);
+int16_t dynamixel_bus_read_data_timed(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data, dynamixel_bus_timing_t* timing);
+int16_t dynamixel_bus_write_data(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data);
+int16_t dynamixel_bus_reg_write(dynamixel_bus_t* bus, uint8_t id, dynamixel_register_t address, uint8_t count, uint8_t* data);
+int16_t dynamixel_bus_action(dynamixel_bus_t* bus, uint8_t id);
+int16_t dynamixel_bus_reset(dynamixel_bus_t* bus, uint8_t id);
+int16_t dynamixel_bus_sync_write(dynamixel_bus_t* bus, dynamixel_register_t address, uint8_t id_count, uint8_t param_count, uint8_t* data);
+int16_t dynamixel_bus_sync_write_words(dynamixel_bus_t* bus, dynamixel_register_t address, uint8_t id_count, uint8_t word_count, uint16_t* data, bool priority);
+int16_t dynamixel_bus_sync_write_goals(dynamixel_bus_t* bus, uint8_t id_count, uint16_t* data, uint32_t tag);
+int16_t dynamixel_bus_write_packet(dynamixel_bus_t* bus, const uint8_t* packet, uint16_t len, bool priority);
+#ifdef ENABLE_TROSSEN_COMMANDER
+int16_t dynamixel_bus_trossen_cmd(dynamixel_bus_t* bus, trossen_cmd_t* command);
+#endif
+
+#endif
@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_COMMANDS_C
+#define DYNAMIXEL_COMMANDS_C
+
+/* plain dynamixel instructions and the engineering unit commands */
+#include "command.h"
+
+static int16_t command_ping(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>
+	int16_t dynamixel_ret=dynamixel_bus_ping(ctx->bus, (uint8_t)rx_vect[1]);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_ping_def={
+	DYNAMIXEL_RQ_PING, "ping", command_ping, COMMAND_NEEDS_BUS,
+	1, 1, COMMAND_ANY,
+	1, {COMMAND_SERVO_ID}
+};
+COMMAND_REGISTER(command_ping_def)
+
+static int16_t command_read_data(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<register>,<count>
+	dynamixel_bus_timing_t timing;
+	int16_t dynamixel_ret=dynamixel_bus_read_data_timed(
+		ctx->bus,
+		(uint8_t)rx_vect[1],							/*id*/
+		(dynamixel_register_t)rx_vect[2],	/*address*/
+		(uint8_t)rx_vect[3],							/*count*/
+		ctx->tmp_uint8,
+		&timing
+	);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	if (rx_vect[0]==DYNAMIXEL_RQ_READ_DATA_TIMED) {
+		command_push_timing(tx_vect, &timing);
+	}
+	for (int16_t i=0; i<dynamixel_ret; i++) {
+		tx_vect.push_back(ctx->tmp_uint8[i]);
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_read_data_def={
+	DYNAMIXEL_RQ_READ_DATA, "read_data", command_read_data, COMMAND_NEEDS_BUS,
+	3, 3, COMMAND_ANY,
+	3, {COMMAND_SERVO_ID, COMMAND_BYTE, COMMAND_VALUE(0, DYNAMIXEL_MAX_PARAMETER_COUNT)}
+};
+COMMAND_REGISTER(command_read_data_def)
+static const command_t command_read_data_timed_def={
+	DYNAMIXEL_RQ_READ_DATA_TIMED, "read_data_timed", command_read_data, COMMAND_NEEDS_BUS,
+	3, 3, COMMAND_ANY,
+	3, {COMMAND_SERVO_ID, COMMAND_BYTE, COMMAND_VALUE(0, DYNAMIXEL_MAX_PARAMETER_COUNT)}
+};
+COMMAND_REGISTER(command_read_data_timed_def)
+
+static int16_t command_read_fields(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<model>,<field>,<field+1>,...
+	//reply:       <err>,<value>,<value+1>,...
+	register_model_t model=(register_model_t)rx_vect[2];
+	uint8_t field_count=rx_vect.size()-3;
+	uint8_t start;
+	uint8_t length;
+	dynamixel_bus_timing_t timing;
+	int16_t dynamixel_ret;
+
+	for (uint8_t i=0; i<field_count; i++) {
+		ctx->tmp_ids[i]=rx_vect[3+i];
+	}
+	register_map_span(model, ctx->tmp_ids, field_count, &start, &length);
+	dynamixel_ret=dynamixel_bus_read_data_timed(ctx->bus, (uint8_t)rx_vect[1], (dynamixel_register_t)start, length, ctx->tmp_uint8, &timing);
+	if (dynamixel_ret!=length) {
+		return ZMQ_ERR_BUS_ERROR;
+	}
+	register_map_decode(model, ctx->tmp_ids, field_count, start, ctx->tmp_uint8, ctx->tmp_int16);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	if (rx_vect[0]==DYNAMIXEL_RQ_READ_FIELDS_TIMED) {
+		command_push_timing(tx_vect, &timing);
+	}
+	for (uint8_t i=0; i<field_count; i++) {
+		tx_vect.push_back(ctx->tmp_int16[i]);
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+/* fields the model does not have never reach the bus */
+static int16_t command_read_fields_validate(const std::vector<int16_t>& rx_vect) {
+	uint8_t fields[REGISTER_FIELD_COUNT];
+	uint8_t field_count=rx_vect.size()-3;
+	uint8_t start;
+	uint8_t length;
+
+	for (uint8_t i=0; i<field_count; i++) {
+		fields[i]=rx_vect[3+i];
+	}
+	if (!register_map_span((register_model_t)rx_vect[2], fields, field_count, &start, &length)) {
+		return ZMQ_ERR_INVALID_PARAMETERS;
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_read_fields_def={
+	DYNAMIXEL_RQ_READ_FIELDS, "read_fields", command_read_fields, COMMAND_NEEDS_BUS,
+	3, REGISTER_FIELD_COUNT+2, COMMAND_VALUE(0, REGISTER_FIELD_COUNT-1),
+	2, {COMMAND_SERVO_ID, COMMAND_VALUE(0, REGISTER_MODEL_COUNT-1)},
+	command_read_fields_validate
+};
+COMMAND_REGISTER(command_read_fields_def)
+static const command_t command_read_fields_timed_def={
+	DYNAMIXEL_RQ_READ_FIELDS_TIMED, "read_fields_timed", command_read_fields, COMMAND_NEEDS_BUS,
+	3, REGISTER_FIELD_COUNT+2, COMMAND_VALUE(0, REGISTER_FIELD_COUNT-1),
+	2, {COMMAND_SERVO_ID, COMMAND_VALUE(0, REGISTER_MODEL_COUNT-1)},
+	command_read_fields_validate
+};
+COMMAND_REGISTER(command_read_fields_timed_def)
+
+static int16_t command_write_data(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<register>,<count>,<data>,<data+1>
+	uint8_t count=rx_vect.size()-4;
+	int16_t dynamixel_ret;
+
+	for (uint8_t i=0; i<count; i++) {
+		ctx->tmp_uint8[i]=rx_vect[4+i];
+	}
+	if (rx_vect[0]==DYNAMIXEL_RQ_REG_WRITE) {
+		dynamixel_ret=dynamixel_bus_reg_write(ctx->bus, (uint8_t)rx_vect[1], (dynamixel_register_t)rx_vect[2], count, ctx->tmp_uint8);
+	} else {
+		dynamixel_ret=dynamixel_bus_write_data(ctx->bus, (uint8_t)rx_vect[1], (dynamixel_register_t)rx_vect[2], count, ctx->tmp_uint8);
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	return ZMQ_ERR_NO_ERROR;
+}
+/* <count> may not promise more data than the message has */
+static int16_t command_write_data_validate(const std::vector<int16_t>& rx_vect) {
+	if ((size_t)rx_vect[3]>rx_vect.size()-4) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_write_data_def={
+	DYNAMIXEL_RQ_WRITE_DATA, "write_data", command_write_data, COMMAND_NEEDS_BUS,
+	4, DYNAMIXEL_MAX_PARAMETER_COUNT+3, COMMAND_BYTE,
+	3, {COMMAND_SERVO_ID, COMMAND_BYTE, COMMAND_VALUE(1, DYNAMIXEL_MAX_PARAMETER_COUNT)},
+	command_write_data_validate
+};
+COMMAND_REGISTER(command_write_data_def)
+static const command_t command_reg_write_def={
+	DYNAMIXEL_RQ_REG_WRITE, "reg_write", command_write_data, COMMAND_NEEDS_BUS,
+	4, DYNAMIXEL_MAX_PARAMETER_COUNT+3, COMMAND_BYTE,
+	3, {COMMAND_SERVO_ID, COMMAND_BYTE, COMMAND_VALUE(1, DYNAMIXEL_MAX_PARAMETER_COUNT)},
+	command_write_data_validate
+};
+COMMAND_REGISTER(command_reg_write_def)
+
+static int16_t command_action(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>
+	int16_t dynamixel_ret=dynamixel_bus_action(ctx->bus, (uint8_t)rx_vect[1]);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_action_def={
+	DYNAMIXEL_RQ_REG_ACTION, "action", command_action, COMMAND_NEEDS_BUS,
+	1, 1, COMMAND_ANY,
+	1, {COMMAND_SERVO_ID}
+};
+COMMAND_REGISTER(command_action_def)
+
+static int16_t command_reset(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>
+	int16_t dynamixel_ret=dynamixel_bus_reset(ctx->bus, (uint8_t)rx_vect[1]);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_reset_def={
+	DYNAMIXEL_RQ_RESET, "reset", command_reset, COMMAND_NEEDS_BUS,
+	1, 1, COMMAND_ANY,
+	1, {COMMAND_SERVO_ID}
+};
+COMMAND_REGISTER(command_reset_def)
+
+static int16_t command_sync_write(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<register>,<id_count>,<parameter_count>,<servo-id>,<data>,<data+n>
+	uint16_t count=rx_vect[2]*(rx_vect[3]+1);
+	int16_t dynamixel_ret;
+
+	if (rx_vect[0]==DYNAMIXEL_RQ_SYNC_WRITE_WORDS) {
+		for (uint16_t i=0; i<count; i++) {
+			ctx->tmp_uint16[i]=rx_vect[4+i];
+		}
+		dynamixel_ret=dynamixel_bus_sync_write_words(
+			ctx->bus,
+			(dynamixel_register_t)rx_vect[1],	/*register*/
+			(uint8_t)rx_vect[2],							/*id-count*/
+			(uint8_t)rx_vect[3],							/*word_count*/
+			ctx->tmp_uint16,
+			false
+		);
+	} else {
+		for (uint16_t i=0; i<count; i++) {
+			ctx->tmp_uint8[i]=rx_vect[4+i];
+		}
+		dynamixel_ret=dynamixel_bus_sync_write(
+			ctx->bus,
+			(dynamixel_register_t)rx_vect[1],	/*register*/
+			(uint8_t)rx_vect[2],							/*id-count*/
+			(uint8_t)rx_vect[3],							/*parameter_count*/
+			ctx->tmp_uint8
+		);
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	return ZMQ_ERR_NO_ERROR;
+}
+/* <id_count> entries of an id and <parameter_count> values */
+static int16_t command_sync_write_validate(const std::vector<int16_t>& rx_vect) {
+	if ((size_t)(4+rx_vect[2]*(rx_vect[3]+1))>rx_vect.size()) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_sync_write_def={
+	DYNAMIXEL_RQ_SYNC_WRITE, "sync_write", command_sync_write, COMMAND_NEEDS_BUS,
+	5, DYNAMIXEL_MAX_PARAMETER_COUNT+3, COMMAND_BYTE,
+	3, {COMMAND_BYTE, COMMAND_VALUE(1, DYNAMIXEL_MAX_PARAMETER_COUNT/2), COMMAND_VALUE(1, DYNAMIXEL_MAX_PARAMETER_COUNT-1)},
+	command_sync_write_validate
+};
+COMMAND_REGISTER(command_sync_write_def)
+static const command_t command_sync_write_words_def={
+	DYNAMIXEL_RQ_SYNC_WRITE_WORDS, "sync_write_words", command_sync_write, COMMAND_NEEDS_BUS,
+	5, DYNAMIXEL_MAX_PARAMETER_COUNT+3, COMMAND_ANY,
+	3, {COMMAND_BYTE, COMMAND_VALUE(1, DYNAMIXEL_MAX_PARAMETER_COUNT/3), COMMAND_VALUE(1, DYNAMIXEL_MAX_PARAMETER_COUNT/2-1)},
+	command_sync_write_validate
+};
+COMMAND_REGISTER(command_sync_write_words_def)
+
+static int16_t command_unit_sync_write(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id_count>,<id>,<pos mrad>,<speed mrad/s>,<id+1>,...
+	uint8_t id_count=rx_vect[1];
+	int16_t dynamixel_ret;
+
+	for (uint8_t i=0; i<id_count; i++) {
+		ctx->tmp_ids[i]=rx_vect[2+i*3];
+		ctx->tmp_float[0][i]=rx_vect[3+i*3]/1000.0f;
+		ctx->tmp_float[1][i]=rx_vect[4+i*3]/1000.0f;
+	}
+	calibration_rad_to_ticks(ctx->calibration, ctx->tmp_ids, ctx->tmp_float[0], ctx->tmp_raw[0], id_count);
+	calibration_rad_s_to_speed(ctx->calibration, ctx->tmp_ids, ctx->tmp_float[1], ctx->tmp_raw[1], id_count);
+	/* goal position and moving speed are adjacent words */
+	for (uint8_t i=0; i<id_count; i++) {
+		ctx->tmp_uint16[i*3]=ctx->tmp_ids[i];
+		ctx->tmp_uint16[i*3+1]=ctx->tmp_raw[0][i];
+		ctx->tmp_uint16[i*3+2]=ctx->tmp_raw[1][i];
+	}
+	dynamixel_ret=dynamixel_bus_sync_write_words(
+		ctx->bus,
+		DYNAMIXEL_R_GOAL_POSITION_L,		/*register*/
+		id_count,												/*id-count*/
+		2,															/*word_count*/
+		ctx->tmp_uint16,
+		false
+	);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	return ZMQ_ERR_NO_ERROR;
+}
+/* exactly <id_count> groups of id, position and speed */
+static int16_t command_unit_sync_write_validate(const std::vector<int16_t>& rx_vect) {
+	if (rx_vect.size()!=(size_t)(2+rx_vect[1]*3)) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	return command_check_ids(rx_vect, 2, 3, CALIBRATION_MAX_ID);
+}
+static const command_t command_unit_sync_write_def={
+	DYNAMIXEL_RQ_UNIT_SYNC_WRITE, "unit_sync_write", command_unit_sync_write, COMMAND_NEEDS_BUS,
+	4, 1+(DYNAMIXEL_MAX_PARAMETER_COUNT/3)*3, COMMAND_ANY,
+	1, {COMMAND_VALUE(1, DYNAMIXEL_MAX_PARAMETER_COUNT/3)},
+	command_unit_sync_write_validate
+};
+COMMAND_REGISTER(command_unit_sync_write_def)
+
+static int16_t command_unit_read_state(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<id+1>,...
+	//reply:       <err>,<pos mrad>,<speed mrad/s>,<load 1/1000>,...
+	uint8_t id_count=rx_vect.size()-1;
+	bool timed=(rx_vect[0]==DYNAMIXEL_RQ_UNIT_READ_STATE_TIMED);
+	dynamixel_bus_timing_t timing[CALIBRATION_MAX_BATCH];
+	int16_t dynamixel_ret;
+
+	for (uint8_t i=0; i<id_count; i++) {
+		ctx->tmp_ids[i]=rx_vect[1+i];
+		/* present position, speed and load in one read */
+		dynamixel_ret=dynamixel_bus_read_data_timed(ctx->bus, ctx->tmp_ids[i], CALIBRATION_R_PRESENT_POSITION_L, 6, ctx->tmp_uint8, &timing[i]);
+		if (dynamixel_ret!=6) {
+			return ZMQ_ERR_BUS_ERROR;
+		}
+		ctx->tmp_raw[0][i]=register_decode_word(ctx->tmp_uint8);
+		ctx->tmp_raw[1][i]=register_decode_word(ctx->tmp_uint8+2);
+		ctx->tmp_raw[2][i]=register_decode_word(ctx->tmp_uint8+4);
+	}
+	calibration_ticks_to_rad(ctx->calibration, ctx->tmp_ids, ctx->tmp_raw[0], ctx->tmp_float[0], id_count);
+	calibration_speed_to_rad_s(ctx->calibration, ctx->tmp_ids, ctx->tmp_raw[1], ctx->tmp_float[1], id_count);
+	calibration_load_to_norm(ctx->tmp_raw[2], ctx->tmp_float[2], id_count);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	for (uint8_t i=0; i<id_count; i++) {
+		tx_vect.push_back((int16_t)lrintf(ctx->tmp_float[0][i]*1000.0f));
+		tx_vect.push_back((int16_t)lrintf(ctx->tmp_float[1][i]*1000.0f));
+		tx_vect.push_back((int16_t)lrintf(ctx->tmp_float[2][i]*1000.0f));
+		if (timed) {
+			command_push_timing(tx_vect, &timing[i]);
+		}
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_unit_read_state_def={
+	DYNAMIXEL_RQ_UNIT_READ_STATE, "unit_read_state", command_unit_read_state, COMMAND_NEEDS_BUS,
+	1, CALIBRATION_MAX_BATCH-1, COMMAND_ID(0, CALIBRATION_MAX_ID-1),
+	0, {}
+};
+COMMAND_REGISTER(command_unit_read_state_def)
+static const command_t command_unit_read_state_timed_def={
+	DYNAMIXEL_RQ_UNIT_READ_STATE_TIMED, "unit_read_state_timed", command_unit_read_state, COMMAND_NEEDS_BUS,
+	1, CALIBRATION_MAX_BATCH-1, COMMAND_ID(0, CALIBRATION_MAX_ID-1),
+	0, {}
+};
+COMMAND_REGISTER(command_unit_read_state_timed_def)
+
+static int16_t command_move_sync(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<duration ms>,<id>,<goal mrad>,<id+1>,...
+	//reply:       <err>,<bus ret>,<arrival spread us>
+	uint8_t id_count=(rx_vect.size()-2)/2;
+	float duration=rx_vect[1]/1000.0f;
+	float* arrival=ctx->tmp_float[1];
+	float first=1e9f;
+	float last=0.0f;
+	struct timespec now;
+	uint64_t now_ns;
+	int16_t dynamixel_ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ns=(uint64_t)now.tv_sec*1000000000ULL+now.tv_nsec;
+	for (uint8_t i=0; i<id_count; i++) {
+		uint8_t id=rx_vect[2+i*2];
+		ctx->tmp_ids[i]=id;
+		ctx->tmp_float[0][i]=rx_vect[3+i*2]/1000.0f;
+		/* our last goal is the position once the move is over and nobody else wrote one */
+		if ((ctx->move_goal_tag[id]!=0) && (now_ns>=ctx->move_end_ns[id]) &&
+				(__atomic_load_n(&ctx->bus->goal_tag[id], __ATOMIC_RELAXED)==ctx->move_goal_tag[id])) {
+			ctx->tmp_raw[1][i]=ctx->move_goal[id];
+			continue;
+		}
+		dynamixel_ret=dynamixel_bus_read_data(ctx->bus, id, CALIBRATION_R_PRESENT_POSITION_L, 2, ctx->tmp_uint8);
+		if (dynamixel_ret!=2) {
+			return ZMQ_ERR_BUS_ERROR;
+		}
+		ctx->tmp_raw[1][i]=register_decode_word(ctx->tmp_uint8);
+	}
+	calibration_rad_to_ticks(ctx->calibration, ctx->tmp_ids, ctx->tmp_float[0], ctx->tmp_raw[0], id_count);
+	calibration_move_speed(ctx->calibration, ctx->tmp_ids, ctx->tmp_raw[1], ctx->tmp_raw[0], duration, ctx->tmp_raw[2], arrival, id_count);
+	/* goal position and moving speed in one sync write, so all servos start together */
+	for (uint8_t i=0; i<id_count; i++) {
+		ctx->tmp_uint16[i*3]=ctx->tmp_ids[i];
+		ctx->tmp_uint16[i*3+1]=ctx->tmp_raw[0][i];
+		ctx->tmp_uint16[i*3+2]=ctx->tmp_raw[2][i];
+	}
+	if (++ctx->move_tag==0) {
+		ctx->move_tag=1;
+	}
+	dynamixel_ret=dynamixel_bus_sync_write_goals(ctx->bus, id_count, ctx->tmp_uint16, ctx->move_tag);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ns=(uint64_t)now.tv_sec*1000000000ULL+now.tv_nsec;
+	for (uint8_t i=0; i<id_count; i++) {
+		uint8_t id=ctx->tmp_ids[i];
+		/* after a failed write the next move reads the positions again */
+		if (dynamixel_ret>=0) {
+			ctx->move_goal[id]=ctx->tmp_raw[0][i];
+			ctx->move_goal_tag[id]=ctx->move_tag;
+			ctx->move_end_ns[id]=now_ns+(uint64_t)(arrival[i]*1e9f);
+		}
+		/* servos that stay put don't count for the spread */
+		if (ctx->tmp_raw[0][i]!=ctx->tmp_raw[1][i]) {
+			first=fminf(first, arrival[i]);
+			last=fmaxf(last, arrival[i]);
+		}
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	tx_vect.push_back((last>first) ? (int16_t)fminf((last-first)*1e6f, INT16_MAX) : 0);
+	return ZMQ_ERR_NO_ERROR;
+}
+/* pairs of id and goal */
+static int16_t command_move_sync_validate(const std::vector<int16_t>& rx_vect) {
+	if ((rx_vect.size()-2)%2) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	return command_check_ids(rx_vect, 2, 2, CALIBRATION_MAX_ID);
+}
+static const command_t command_move_sync_def={
+	DYNAMIXEL_RQ_MOVE_SYNC, "move_sync", command_move_sync, COMMAND_NEEDS_BUS,
+	3, 1+COMMAND_MOVE_MAX_IDS*2, COMMAND_ANY,
+	1, {COMMAND_VALUE(1, INT16_MAX)},
+	command_move_sync_validate
+};
+COMMAND_REGISTER(command_move_sync_def)
+
+static int16_t command_echo(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<data>,<data+n>
+	tx_vect=rx_vect;
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_echo_def={
+	DYNAMIXEL_RQ_ZMQ_ECHO, "echo", command_echo, 0,
+	0, COMMAND_ARGS_ANY, COMMAND_ANY,
+	0, {}
+};
+COMMAND_REGISTER(command_echo_def)
+
+static int16_t command_time_sync(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>
+	//reply:       <err>,<t_rx>,<t_tx> (4 words each)
+	//clients take t0 before sending and t3 on reception, the offset of the
+	//service clock is ((t_rx-t0)+(t_tx-t3))/2 and the round trip
+	//(t3-t0)-(t_tx-t_rx) bounds its error.
+	struct timespec t_reply;
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	command_push_time(tx_vect, ctx->t_receive_ns);
+	clock_gettime(CLOCK_MONOTONIC, &t_reply);
+	command_push_time(tx_vect, (uint64_t)t_reply.tv_sec*1000000000ULL+t_reply.tv_nsec);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_time_sync_def={
+	DYNAMIXEL_RQ_TIME_SYNC, "time_sync", command_time_sync, 0,
+	0, 0, COMMAND_ANY,
+	0, {}
+};
+COMMAND_REGISTER(command_time_sync_def)
+
+#ifdef ENABLE_TROSSEN_COMMANDER
+static int16_t command_trossen(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<right_V>,<right_H>,<left_V>,<left_H>,<buttons>
+	trossen_cmd_t command;
+	int16_t dynamixel_ret;
+
+	command.right_V		=rx_vect[1];
+	command.right_H		=rx_vect[2];
+	command.left_V		=rx_vect[3];
+	command.left_H		=rx_vect[4];
+	command.buttons		=rx_vect[5];
+#ifdef ENABLE_GAIT_ENGINE
+	if (ctx->gait->command.enabled) {
+		/* walking is done here, don't forward to the controller */
+		gait_set_commander(ctx->gait, &command);
+		dynamixel_ret=0;
+	} else
+#endif
+	dynamixel_ret=dynamixel_bus_trossen_cmd(ctx->bus, &command);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(dynamixel_ret);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_trossen_def={
+	TROSSEN_COMMANDER, "trossen_commander", command_trossen, COMMAND_NEEDS_BUS,
+	5, 5, COMMAND_ANY,
+	0, {}
+};
+COMMAND_REGISTER(command_trossen_def)
+#endif
+
+#endif
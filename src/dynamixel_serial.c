@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_SERIAL_C
+#define DYNAMIXEL_SERIAL_C
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <linux/serial.h>
+#include "dynamixel_serial.h"
+
+static speed_t dynamixel_serial_speed(uint32_t baud) {
+	switch (baud) {
+		case 9600:			return B9600;
+		case 19200:			return B19200;
+		case 38400:			return B38400;
+		case 57600:			return B57600;
+		case 115200:		return B115200;
+		case 230400:		return B230400;
+		case 460800:		return B460800;
+		case 500000:		return B500000;
+		case 576000:		return B576000;
+		case 921600:		return B921600;
+		case 1000000:		return B1000000;
+		case 1152000:		return B1152000;
+		case 1500000:		return B1500000;
+		case 2000000:		return B2000000;
+		case 2500000:		return B2500000;
+		case 3000000:		return B3000000;
+	}
+	return B0;
+}
+
+int dynamixel_serial_open(dynamixel_serial_t* port, const char* device, uint32_t baud) {
+	struct termios tio;
+	struct serial_struct serial;
+	struct epoll_event event;
+	speed_t speed=dynamixel_serial_speed(baud);
+
+	port->fd=-1;
+	port->epoll_fd=-1;
+	port->timer_fd=-1;
+	if (speed==B0) {
+		std::cerr << "Unsupported baud rate " << baud << std::endl;
+		return -1;
+	}
+	port->fd=open(device, O_RDWR|O_NOCTTY|O_NONBLOCK|O_CLOEXEC);
+	if (port->fd<0) {
+		std::cerr << "Can't open " << device << ": " << strerror(errno) << std::endl;
+		return -1;
+	}
+	if (tcgetattr(port->fd, &tio)!=0) {
+		std::cerr << device << " is not a tty" << std::endl;
+		dynamixel_serial_close(port);
+		return -1;
+	}
+	cfmakeraw(&tio);
+	tio.c_cflag|=CLOCAL|CREAD;
+	tio.c_cflag&=~(CSTOPB|CRTSCTS);
+	tio.c_cc[VMIN]=0;
+	tio.c_cc[VTIME]=0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	if (tcsetattr(port->fd, TCSANOW, &tio)!=0) {
+		std::cerr << "Can't configure " << device << ": " << strerror(errno) << std::endl;
+		dynamixel_serial_close(port);
+		return -1;
+	}
+
+	/* usb adapters (ftdi) deliver bytes every 16ms unless asked not to */
+	port->low_latency=false;
+	if (ioctl(port->fd, TIOCGSERIAL, &serial)==0) {
+		serial.flags|=ASYNC_LOW_LATENCY;
+		port->low_latency=(ioctl(port->fd, TIOCSSERIAL, &serial)==0);
+	}
+
+	port->timer_fd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+	port->epoll_fd=epoll_create1(EPOLL_CLOEXEC);
+	if ((port->timer_fd<0) || (port->epoll_fd<0)) {
+		std::cerr << "Can't create epoll/timerfd: " << strerror(errno) << std::endl;
+		dynamixel_serial_close(port);
+		return -1;
+	}
+	event.events=EPOLLIN;
+	event.data.fd=port->fd;
+	if (epoll_ctl(port->epoll_fd, EPOLL_CTL_ADD, port->fd, &event)!=0) {
+		std::cerr << "Can't wait on " << device << ": " << strerror(errno) << std::endl;
+		dynamixel_serial_close(port);
+		return -1;
+	}
+	event.data.fd=port->timer_fd;
+	if (epoll_ctl(port->epoll_fd, EPOLL_CTL_ADD, port->timer_fd, &event)!=0) {
+		std::cerr << "Can't wait on the timerfd: " << strerror(errno) << std::endl;
+		dynamixel_serial_close(port);
+		return -1;
+	}
+
+	port->baud=baud;
+	port->byte_ns=10*1000000000ULL/baud;
+	port->margin_us=DYNAMIXEL_SERIAL_MARGIN_US;
+	port->busy_until_ns=0;
+	memset(&port->stats, 0, sizeof(port->stats));
+	dynamixel_serial_set_status_return(port, DYNAMIXEL_SERIAL_BROADCAST_ID, DYNAMIXEL_SERIAL_RETURN_ALL);
+
+	if (port->debug) {
+		std::cout << "Native transport on " << device << " @" << baud
+			<< " (" << port->byte_ns << "ns/byte, low latency " << (port->low_latency ? "on" : "off") << ")" << std::endl;
+	}
+	return 0;
+}
+
+/* also cleans up a half opened port, fds not opened yet are -1 */
+void dynamixel_serial_close(dynamixel_serial_t* port) {
+	if (port->epoll_fd>=0) {
+		close(port->epoll_fd);
+		port->epoll_fd=-1;
+	}
+	if (port->timer_fd>=0) {
+		close(port->timer_fd);
+		port->timer_fd=-1;
+	}
+	if (port->fd>=0) {
+		close(port->fd);
+		port->fd=-1;
+	}
+}
+
+/* the broadcast id sets the level of all servos */
+void dynamixel_serial_set_status_return(dynamixel_serial_t* port, uint8_t id, uint8_t level) {
+	if (id==DYNAMIXEL_SERIAL_BROADCAST_ID) {
+		memset(port->status_return, level, sizeof(port->status_return));
+	} else if (id<DYNAMIXEL_SERIAL_BROADCAST_ID) {
+		port->status_return[id]=level;
+	}
+}
+
+static bool dynamixel_serial_expects_reply(dynamixel_serial_t* port, uint8_t id, uint8_t instruction) {
+	if (id>=DYNAMIXEL_SERIAL_BROADCAST_ID) {
+		return false;
+	}
+	switch (instruction) {
+		case DYNAMIXEL_SERIAL_PING:
+			return true;
+		case DYNAMIXEL_SERIAL_READ_DATA:
+			return port->status_return[id]>=DYNAMIXEL_SERIAL_RETURN_READ;
+	}
+	return port->status_return[id]>=DYNAMIXEL_SERIAL_RETURN_ALL;
+}
+
+void dynamixel_serial_parser_reset(dynamixel_serial_parser_t* parser, uint8_t expected_id) {
+	parser->state=DYNAMIXEL_SERIAL_PARSE_HEADER1;
+	parser->expected_id=expected_id;
+	parser->error=0;
+	parser->count=0;
+}
+
+/*
+ * returns 1 once a status packet of the expected id is complete, 0 while
+ * more bytes are needed. Packets of other ids (late replies) are skipped.
+ */
+int dynamixel_serial_parser_feed(dynamixel_serial_parser_t* parser, uint8_t byte) {
+	switch (parser->state) {
+		case DYNAMIXEL_SERIAL_PARSE_HEADER1:
+			if (byte==0xFF) {
+				parser->state=DYNAMIXEL_SERIAL_PARSE_HEADER2;
+			}
+			break;
+		case DYNAMIXEL_SERIAL_PARSE_HEADER2:
+			parser->state=(byte==0xFF) ? DYNAMIXEL_SERIAL_PARSE_ID : DYNAMIXEL_SERIAL_PARSE_HEADER1;
+			break;
+		case DYNAMIXEL_SERIAL_PARSE_ID:
+			if (byte!=0xFF) {
+				parser->id=byte;
+				parser->checksum=byte;
+				parser->state=DYNAMIXEL_SERIAL_PARSE_LENGTH;
+			}
+			break;
+		case DYNAMIXEL_SERIAL_PARSE_LENGTH:
+			if ((byte<2) || (byte>DYNAMIXEL_MAX_PARAMETER_COUNT+2)) {
+				parser->state=DYNAMIXEL_SERIAL_PARSE_HEADER1;
+				break;
+			}
+			parser->length=byte;
+			parser->checksum+=byte;
+			parser->state=DYNAMIXEL_SERIAL_PARSE_ERROR;
+			break;
+		case DYNAMIXEL_SERIAL_PARSE_ERROR:
+			parser->error=byte;
+			parser->checksum+=byte;
+			parser->count=0;
+			parser->state=(parser->length==2) ? DYNAMIXEL_SERIAL_PARSE_CHECKSUM : DYNAMIXEL_SERIAL_PARSE_PARAMS;
+			break;
+		case DYNAMIXEL_SERIAL_PARSE_PARAMS:
+			parser->params[parser->count++]=byte;
+			parser->checksum+=byte;
+			if (parser->count==parser->length-2) {
+				parser->state=DYNAMIXEL_SERIAL_PARSE_CHECKSUM;
+			}
+			break;
+		case DYNAMIXEL_SERIAL_PARSE_CHECKSUM:
+			parser->state=DYNAMIXEL_SERIAL_PARSE_HEADER1;
+			if (parser->id!=parser->expected_id) {
+				break;
+			}
+			if ((uint8_t)~parser->checksum!=byte) {
+				return DYNAMIXEL_SERIAL_ERR_CHECKSUM;
+			}
+			return 1;
+	}
+	return 0;
+}
+
+static int dynamixel_serial_write_all(dynamixel_serial_t* port, const uint8_t* data, size_t len) {
+	struct pollfd pfd;
+	size_t done=0;
+	ssize_t ret;
+
+	pfd.fd=port->fd;
+	pfd.events=POLLOUT;
+	while (done<len) {
+		ret=write(port->fd, data+done, len-done);
+		if (ret>0) {
+			done+=ret;
+		} else if ((ret<0) && ((errno==EAGAIN) || (errno==EWOULDBLOCK))) {
+			poll(&pfd, 1, -1);
+		} else if ((ret<0) && (errno!=EINTR)) {
+			return DYNAMIXEL_SERIAL_ERR_IO;
+		}
+	}
+	return 0;
+}
+
+/* feeds everything readable into the parser */
+static int dynamixel_serial_receive(dynamixel_serial_t* port) {
+	uint8_t buffer[64];
+	struct timespec t_read;
+	ssize_t count;
+	int ret;
+
+	while ((count=read(port->fd, buffer, sizeof(buffer)))>0) {
+		clock_gettime(CLOCK_MONOTONIC, &t_read);
+		for (ssize_t i=0; i<count; i++) {
+			ret=dynamixel_serial_parser_feed(&port->parser, buffer[i]);
+			if (ret==1) {
+				port->t_reply_ns=(uint64_t)t_read.tv_sec*1000000000ULL+t_read.tv_nsec;
+			}
+			if (ret!=0) {
+				return ret;
+			}
+		}
+	}
+	if ((count<0) && (errno!=EAGAIN) && (errno!=EWOULDBLOCK) && (errno!=EINTR)) {
+		return DYNAMIXEL_SERIAL_ERR_IO;
+	}
+	return 0;
+}
+
+/*
+ * sends a complete instruction packet and, if the servo answers it, waits
+ * for the status packet with reply_count parameters. Returns the status
+ * error byte (0 if no reply is expected) or a negative DYNAMIXEL_SERIAL_ERR_*,
+ * the parameters are left in port->parser.params.
+ */
+static int16_t dynamixel_serial_exchange(dynamixel_serial_t* port, const uint8_t* packet, size_t len, uint8_t reply_count) {
+	uint8_t id=packet[2];
+	bool reply=dynamixel_serial_expects_reply(port, id, packet[4]);
+	struct itimerspec deadline;
+	struct epoll_event events[2];
+	struct timespec t_start;
+	struct timespec t_end;
+	uint64_t timeout_ns=0;
+	uint64_t queued_ns;
+	uint64_t now_ns;
+	uint64_t wall_ns;
+	int16_t ret=0;
+	int count;
+
+	/* nothing of the last status packet may pass for this one's */
+	dynamixel_serial_parser_reset(&port->parser, id);
+	/* only writes go out without a reply, a READ nobody answers has no result */
+	if ((!reply) && (packet[4]==DYNAMIXEL_SERIAL_READ_DATA)) {
+		return DYNAMIXEL_SERIAL_ERR_NO_STATUS;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	now_ns=(uint64_t)t_start.tv_sec*1000000000ULL+t_start.tv_nsec;
+	if (!port->stats.t_first_ns) {
+		port->stats.t_first_ns=now_ns;
+	}
+	/* pipelined packets may still be on their way out */
+	queued_ns=(port->busy_until_ns>now_ns) ? port->busy_until_ns-now_ns : 0;
+	port->busy_until_ns=now_ns+queued_ns+len*port->byte_ns;
+	port->stats.wire_ns_sum+=len*port->byte_ns;
+	if (reply) {
+		/* queued bytes, both packets, return delay and adapter latency */
+		timeout_ns=queued_ns+(uint64_t)(len+6+reply_count)*port->byte_ns+(uint64_t)port->margin_us*1000;
+		deadline.it_interval.tv_sec=0;
+		deadline.it_interval.tv_nsec=0;
+		deadline.it_value.tv_sec=timeout_ns/1000000000ULL;
+		deadline.it_value.tv_nsec=timeout_ns%1000000000ULL;
+		timerfd_settime(port->timer_fd, 0, &deadline, NULL);
+		tcflush(port->fd, TCIFLUSH);
+	}
+	if (dynamixel_serial_write_all(port, packet, len)<0) {
+		return DYNAMIXEL_SERIAL_ERR_IO;
+	}
+
+	if (!reply) {
+		port->stats.pipelined++;
+	}
+	while (reply) {
+		count=epoll_wait(port->epoll_fd, events, 2, -1);
+		if (count<0) {
+			if (errno==EINTR) {
+				continue;
+			}
+			ret=DYNAMIXEL_SERIAL_ERR_IO;
+			break;
+		}
+		/* bytes first, a reply and the deadline may show up together */
+		for (int i=0; i<count; i++) {
+			if (events[i].data.fd==port->fd) {
+				ret=dynamixel_serial_receive(port);
+			}
+		}
+		if (ret==1) {
+			ret=port->parser.error;
+			port->stats.wire_ns_sum+=(6+port->parser.count)*port->byte_ns;
+			break;
+		}
+		if (ret<0) {
+			if (ret==DYNAMIXEL_SERIAL_ERR_CHECKSUM) {
+				port->stats.checksum_errors++;
+			}
+			break;
+		}
+		for (int i=0; i<count; i++) {
+			if (events[i].data.fd==port->timer_fd) {
+				uint64_t expirations;
+				if (read(port->timer_fd, &expirations, sizeof(expirations))>0) {
+					ret=DYNAMIXEL_SERIAL_ERR_TIMEOUT;
+				}
+			}
+		}
+		if (ret==DYNAMIXEL_SERIAL_ERR_TIMEOUT) {
+			port->stats.timeouts++;
+			if (port->debug) {
+				std::cout << "Serial timeout for id " << (int)id << " after " << timeout_ns/1000 << "us" << std::endl;
+			}
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	wall_ns=(t_end.tv_sec-t_start.tv_sec)*1000000000ULL+t_end.tv_nsec-t_start.tv_nsec;
+	if (reply) {
+		/* whatever we sent is out, the reply is in */
+		port->busy_until_ns=now_ns+wall_ns;
+	}
+	if ((!reply) || (ret<0)) {
+		port->t_reply_ns=now_ns+wall_ns;
+	}
+	port->wall_ns=wall_ns;
+	port->stats.transactions++;
+	port->stats.wall_ns_sum+=wall_ns;
+	if (wall_ns>port->stats.wall_ns_max) {
+		port->stats.wall_ns_max=wall_ns;
+	}
+	if ((port->debug) && ((port->stats.transactions%1000)==0)) {
+		uint64_t elapsed_ns=now_ns+wall_ns-port->stats.t_first_ns;
+		std::cout << "Serial: " << port->stats.transactions << " transactions ("
+			<< port->stats.pipelined << " pipelined), avg "
+			<< port->stats.wall_ns_sum/port->stats.transactions/1000 << "us, max "
+			<< port->stats.wall_ns_max/1000 << "us, "
+			<< port->stats.timeouts << " timeouts, "
+			<< port->stats.checksum_errors << " checksum errors, bus utilization "
+			<< (elapsed_ns ? port->stats.wire_ns_sum*100/elapsed_ns : 0) << "%" << std::endl;
+	}
+	return ret;
+}
+
+int16_t dynamixel_serial_transaction(dynamixel_serial_t* port, uint8_t id, uint8_t instruction, const uint8_t* params, uint8_t param_count, uint8_t reply_count) {
+	uint8_t* packet=port->tx;
+	uint8_t checksum;
+
+	if (param_count>DYNAMIXEL_MAX_PARAMETER_COUNT) {
+		return DYNAMIXEL_SERIAL_ERR_LENGTH;
+	}
+	packet[0]=0xFF;
+	packet[1]=0xFF;
+	packet[2]=id;
+	packet[3]=param_count+2;
+	packet[4]=instruction;
+	checksum=id+packet[3]+instruction;
+	for (uint8_t i=0; i<param_count; i++) {
+		packet[5+i]=params[i];
+		checksum+=params[i];
+	}
+	packet[5+param_count]=~checksum;
+	return dynamixel_serial_exchange(port, packet, param_count+6, reply_count);
+}
+
+/*
+ * sends a packet that was encoded beforehand, checksum included, straight
+ * from the caller's buffer. Only the framing is checked. Status return
+ * levels written this way are not followed.
+ */
+int16_t dynamixel_serial_write_packet(dynamixel_serial_t* port, const uint8_t* packet, uint16_t len) {
+	if ((len<6) || (len>DYNAMIXEL_SERIAL_MAX_PACKET) || (packet[0]!=0xFF) || (packet[1]!=0xFF) || (packet[3]+4!=len)) {
+		return DYNAMIXEL_SERIAL_ERR_LENGTH;
+	}
+	return dynamixel_serial_exchange(port, packet, len, 0);
+}
+
+int16_t dynamixel_serial_ping(dynamixel_serial_t* port, uint8_t id) {
+	return dynamixel_serial_transaction(port, id, DYNAMIXEL_SERIAL_PING, NULL, 0, 0);
+}
+
+/* returns the number of bytes read */
+int16_t dynamixel_serial_read_data(dynamixel_serial_t* port, uint8_t id, uint8_t address, uint8_t count, uint8_t* data) {
+	uint8_t params[2]={address, count};
+	int16_t ret=dynamixel_serial_transaction(port, id, DYNAMIXEL_SERIAL_READ_DATA, params, 2, count);
+
+	if (ret<0) {
+		return ret;
+	}
+	if (port->parser.count!=count) {
+		return DYNAMIXEL_SERIAL_ERR_LENGTH;
+	}
+	memcpy(data, port->parser.params, count);
+	if ((address<=DYNAMIXEL_SERIAL_R_STATUS_RETURN) && (address+count>DYNAMIXEL_SERIAL_R_STATUS_RETURN)) {
+		dynamixel_serial_set_status_return(port, id, data[DYNAMIXEL_SERIAL_R_STATUS_RETURN-address]);
+	}
+	return count;
+}
+
+/* WRITE_DATA or REG_WRITE */
+int16_t dynamixel_serial_write_data(dynamixel_serial_t* port, uint8_t id, uint8_t instruction, uint8_t address, uint8_t count, const uint8_t* data) {
+	uint8_t params[DYNAMIXEL_MAX_PARAMETER_COUNT];
+
+	if (count+1>DYNAMIXEL_MAX_PARAMETER_COUNT) {
+		return DYNAMIXEL_SERIAL_ERR_LENGTH;
+	}
+	params[0]=address;
+	memcpy(params+1, data, count);
+	/* the reply to this very write already follows the new level */
+	if ((instruction==DYNAMIXEL_SERIAL_WRITE_DATA) &&
+			(address<=DYNAMIXEL_SERIAL_R_STATUS_RETURN) && (address+count>DYNAMIXEL_SERIAL_R_STATUS_RETURN)) {
+		dynamixel_serial_set_status_return(port, id, data[DYNAMIXEL_SERIAL_R_STATUS_RETURN-address]);
+	}
+	return dynamixel_serial_transaction(port, id, instruction, params, count+1, 0);
+}
+
+/* data: <id>,<param>..<param>,<id+1>,... */
+int16_t dynamixel_serial_sync_write(dynamixel_serial_t* port, uint8_t address, uint8_t id_count, uint8_t param_count, const uint8_t* data) {
+	uint8_t params[DYNAMIXEL_MAX_PARAMETER_COUNT];
+	uint16_t len=id_count*(param_count+1);
+
+	if (len+2>DYNAMIXEL_MAX_PARAMETER_COUNT) {
+		return DYNAMIXEL_SERIAL_ERR_LENGTH;
+	}
+	params[0]=address;
+	params[1]=param_count;
+	memcpy(params+2, data, len);
+	if ((address<=DYNAMIXEL_SERIAL_R_STATUS_RETURN) && (address+param_count>DYNAMIXEL_SERIAL_R_STATUS_RETURN)) {
+		for (uint8_t i=0; i<id_count; i++) {
+			const uint8_t* entry=data+i*(param_count+1);
+			dynamixel_serial_set_status_return(port, entry[0], entry[1+DYNAMIXEL_SERIAL_R_STATUS_RETURN-address]);
+		}
+	}
+	return dynamixel_serial_transaction(port, DYNAMIXEL_SERIAL_BROADCAST_ID, DYNAMIXEL_SERIAL_SYNC_WRITE, params, len+2, 0);
+}
+
+/* data: <id>,<word>..<word>,<id+1>,... words go out little endian */
+int16_t dynamixel_serial_sync_write_words(dynamixel_serial_t* port, uint8_t address, uint8_t id_count, uint8_t word_count, const uint16_t* data) {
+	uint8_t params[DYNAMIXEL_MAX_PARAMETER_COUNT];
+	uint8_t* p=params+2;
+
+	if (id_count*(word_count*2+1)+2>DYNAMIXEL_MAX_PARAMETER_COUNT) {
+		return DYNAMIXEL_SERIAL_ERR_LENGTH;
+	}
+	params[0]=address;
+	params[1]=word_count*2;
+	for (uint8_t i=0; i<id_count; i++) {
+		const uint16_t* entry=data+i*(word_count+1);
+		*p++=entry[0];
+		for (uint8_t w=0; w<word_count; w++) {
+			*p++=entry[1+w]&0xFF;
+			*p++=entry[1+w]>>8;
+		}
+	}
+	return dynamixel_serial_transaction(port, DYNAMIXEL_SERIAL_BROADCAST_ID, DYNAMIXEL_SERIAL_SYNC_WRITE, params, p-params, 0);
+}
+
+#endif
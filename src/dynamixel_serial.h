@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_SERIAL_H
+#define DYNAMIXEL_SERIAL_H
+
+/*
+ * Native protocol 1.0 transport (dyn_zmq --transport native).
+ *
+ * The tty is non-blocking and waited on with epoll together with a timerfd.
+ * Each transaction gets its own deadline: the wire time of the instruction
+ * and of the expected status packet at the configured baud rate plus a
+ * fixed margin for the return delay and the adapter latency. Status packets
+ * are parsed byte by byte as they arrive, so a transaction ends with the
+ * checksum byte and not with a generic read timeout.
+ *
+ * Writes to servos whose status return level suppresses the reply are not
+ * waited for, they are queued back to back and the caller continues as soon
+ * as the bytes are with the kernel. A READ_DATA such a servo would not
+ * answer is not sent at all and fails with DYNAMIXEL_SERIAL_ERR_NO_STATUS.
+ * busy_until_ns follows the bytes still on their way out, so the deadline
+ * of the next reply accounts for them.
+ *
+ * After each transaction t_reply_ns holds the CLOCK_MONOTONIC time the
+ * read() that completed the status packet returned (the end of the write
+ * if there is no reply) and wall_ns how long the whole transaction took.
+ *
+ * Only the bus thread uses it, like the libdynamixel handle.
+ */
+#include <stdint.h>
+
+#define DYNAMIXEL_SERIAL_MARGIN_US      2000	/* return delay + usb latency */
+#define DYNAMIXEL_SERIAL_BROADCAST_ID   0xFE
+#define DYNAMIXEL_SERIAL_MAX_PACKET     (DYNAMIXEL_MAX_PARAMETER_COUNT+6)
+#define DYNAMIXEL_SERIAL_R_STATUS_RETURN 16
+
+/* status return level, same values as the servo register */
+#define DYNAMIXEL_SERIAL_RETURN_PING    0			/* only PING is answered */
+#define DYNAMIXEL_SERIAL_RETURN_READ    1			/* PING and READ_DATA */
+#define DYNAMIXEL_SERIAL_RETURN_ALL     2
+
+/* instructions */
+#define DYNAMIXEL_SERIAL_PING           0x01
+#define DYNAMIXEL_SERIAL_READ_DATA      0x02
+#define DYNAMIXEL_SERIAL_WRITE_DATA     0x03
+#define DYNAMIXEL_SERIAL_REG_WRITE      0x04
+#define DYNAMIXEL_SERIAL_ACTION         0x05
+#define DYNAMIXEL_SERIAL_RESET          0x06
+#define DYNAMIXEL_SERIAL_SYNC_WRITE     0x83
+
+/* errors, the servo's own error bits are returned as they are (>=0) */
+#define DYNAMIXEL_SERIAL_ERR_IO         -1
+#define DYNAMIXEL_SERIAL_ERR_TIMEOUT    -2
+#define DYNAMIXEL_SERIAL_ERR_CHECKSUM   -3
+#define DYNAMIXEL_SERIAL_ERR_LENGTH     -4
+#define DYNAMIXEL_SERIAL_ERR_NO_STATUS  -5		/* READ_DATA to a servo whose status return level is 0 */
+
+typedef enum {
+	DYNAMIXEL_SERIAL_PARSE_HEADER1,
+	DYNAMIXEL_SERIAL_PARSE_HEADER2,
+	DYNAMIXEL_SERIAL_PARSE_ID,
+	DYNAMIXEL_SERIAL_PARSE_LENGTH,
+	DYNAMIXEL_SERIAL_PARSE_ERROR,
+	DYNAMIXEL_SERIAL_PARSE_PARAMS,
+	DYNAMIXEL_SERIAL_PARSE_CHECKSUM,
+} dynamixel_serial_parse_state_t;
+
+typedef struct {
+	uint8_t														state;
+	uint8_t														expected_id;
+	uint8_t														id;
+	uint8_t														length;				/* parameters + 2 */
+	uint8_t														error;
+	uint8_t														count;
+	uint8_t														checksum;
+	uint8_t														params[DYNAMIXEL_MAX_PARAMETER_COUNT];
+} dynamixel_serial_parser_t;
+
+typedef struct {
+	uint32_t													transactions;
+	uint32_t													timeouts;
+	uint32_t													checksum_errors;
+	uint64_t													wall_ns_sum;
+	uint64_t													wall_ns_max;
+	uint32_t													pipelined;		/* packets sent without waiting */
+	uint64_t													wire_ns_sum;	/* time the line carried bytes */
+	uint64_t													t_first_ns;
+} dynamixel_serial_stats_t;
+
+typedef struct {
+	bool															debug;
+	int																fd;
+	int																epoll_fd;
+	int																timer_fd;
+	uint32_t													baud;
+	uint32_t													byte_ns;			/* start + 8 data + stop bit */
+	uint32_t													margin_us;
+	bool															low_latency;
+	uint64_t													busy_until_ns;	/* CLOCK_MONOTONIC when the line is free */
+	uint8_t														status_return[DYNAMIXEL_SERIAL_BROADCAST_ID];
+	uint64_t													t_reply_ns;		/* last transaction */
+	uint64_t													wall_ns;
+	uint8_t														tx[DYNAMIXEL_SERIAL_MAX_PACKET];
+	dynamixel_serial_parser_t					parser;
+	dynamixel_serial_stats_t					stats;
+} dynamixel_serial_t;
+
+int dynamixel_serial_open(dynamixel_serial_t* port, const char* device, uint32_t baud);
+void dynamixel_serial_close(dynamixel_serial_t* port);
+void dynamixel_serial_set_status_return(dynamixel_serial_t* port, uint8_t id, uint8_t level);
+
+void dynamixel_serial_parser_reset(dynamixel_serial_parser_t* parser, uint8_t expected_id);
+int dynamixel_serial_parser_feed(dynamixel_serial_parser_t* parser, uint8_t byte);
+
+int16_t dynamixel_serial_transaction(dynamixel_serial_t* port, uint8_t id, uint8_t instruction, const uint8_t* params, uint8_t param_count, uint8_t reply_count);
+int16_t dynamixel_serial_write_packet(dynamixel_serial_t* port, const uint8_t* packet, uint16_t len);
+
+int16_t dynamixel_serial_ping(dynamixel_serial_t* port, uint8_t id);
+int16_t dynamixel_serial_read_data(dynamixel_serial_t* port, uint8_t id, uint8_t address, uint8_t count, uint8_t* data);
+int16_t dynamixel_serial_write_data(dynamixel_serial_t* port, uint8_t id, uint8_t instruction, uint8_t address, uint8_t count, const uint8_t* data);
+int16_t dynamixel_serial_sync_write(dynamixel_serial_t* port, uint8_t address, uint8_t id_count, uint8_t param_count, const uint8_t* data);
+int16_t dynamixel_serial_sync_write_words(dynamixel_serial_t* port, uint8_t address, uint8_t id_count, uint8_t word_count, const uint16_t* data);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_SHM_H
+#define DYNAMIXEL_SHM_H
+
+/*
+ * Shared memory channel for clients on the same host (dyn_zmq --shm <name>).
+ *
+ * The service publishes the last known state of every servo, each slot is
+ * protected by a seqlock so readers never block and never enter the kernel.
+ * Goal positions go the other way through a lock-free multi-producer ring,
+ * which the service drains into one sync write per tick.
+ *
+ * This header is plain C and has no dependencies besides libc (and -lrt on
+ * older systems), clients just include it:
+ *
+ *   dynamixel_shm_t* shm=dynamixel_shm_open("/dyn_zmq");
+ *   dynamixel_shm_state_t state;
+ *   if (dynamixel_shm_read_state(shm, 1, &state)==0) { ... }
+ *   dynamixel_shm_write_goal(shm, 1, 512, 0);
+ */
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define DYNAMIXEL_SHM_MAGIC           0x44594E58	/* "DYNX" */
+#define DYNAMIXEL_SHM_VERSION         2
+#define DYNAMIXEL_SHM_MAX_ID          254
+#define DYNAMIXEL_SHM_RING_SIZE       256					/* power of two */
+#define DYNAMIXEL_SHM_CACHE_LINE      64
+
+typedef struct {
+	uint64_t			timestamp_ns;				/* CLOCK_MONOTONIC when the status packet arrived */
+	uint32_t			transaction_ns;			/* duration of the read on the bus */
+	uint16_t			position;
+	uint16_t			speed;
+	uint16_t			load;
+	uint8_t				voltage;
+	uint8_t				temperature;
+	uint8_t				valid;
+} dynamixel_shm_state_t;
+
+typedef struct {
+	uint32_t							seq;				/* odd while the service writes */
+	dynamixel_shm_state_t	state;
+} __attribute__((aligned(DYNAMIXEL_SHM_CACHE_LINE))) dynamixel_shm_slot_t;
+
+typedef struct {
+	uint32_t			seq;
+	uint8_t				id;
+	uint8_t				with_speed;
+	uint16_t			goal_position;
+	uint16_t			moving_speed;
+} dynamixel_shm_command_t;
+
+typedef struct {
+	uint32_t								magic;
+	uint32_t								version;
+	uint32_t								ring_size;
+	uint32_t								max_id;
+	uint32_t								head __attribute__((aligned(DYNAMIXEL_SHM_CACHE_LINE)));	/* producers */
+	uint32_t								tail __attribute__((aligned(DYNAMIXEL_SHM_CACHE_LINE)));	/* service */
+	dynamixel_shm_command_t	ring[DYNAMIXEL_SHM_RING_SIZE] __attribute__((aligned(DYNAMIXEL_SHM_CACHE_LINE)));
+	dynamixel_shm_slot_t		servo[DYNAMIXEL_SHM_MAX_ID];
+} dynamixel_shm_t;
+
+static inline dynamixel_shm_t* dynamixel_shm_open(const char* name) {
+	int fd;
+	void* p;
+	dynamixel_shm_t* shm;
+
+	fd=shm_open(name, O_RDWR, 0);
+	if (fd<0) {
+		return NULL;
+	}
+	p=mmap(NULL, sizeof(dynamixel_shm_t), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p==MAP_FAILED) {
+		return NULL;
+	}
+	shm=(dynamixel_shm_t*)p;
+	if ((shm->magic!=DYNAMIXEL_SHM_MAGIC) || (shm->version!=DYNAMIXEL_SHM_VERSION)) {
+		munmap(p, sizeof(dynamixel_shm_t));
+		return NULL;
+	}
+	return shm;
+}
+
+static inline void dynamixel_shm_close(dynamixel_shm_t* shm) {
+	munmap((void*)shm, sizeof(dynamixel_shm_t));
+}
+
+/* returns 0 on success, -1 for an invalid id or a servo never read */
+static inline int dynamixel_shm_read_state(const dynamixel_shm_t* shm, uint8_t id, dynamixel_shm_state_t* state) {
+	const dynamixel_shm_slot_t* slot;
+	uint32_t s1, s2;
+
+	if (id>=DYNAMIXEL_SHM_MAX_ID) {
+		return -1;
+	}
+	slot=&shm->servo[id];
+	do {
+		s1=__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		memcpy(state, (const void*)&slot->state, sizeof(*state));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2=__atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+	} while ((s1&1) || (s1!=s2));
+	return state->valid ? 0 : -1;
+}
+
+/* service side of the seqlock */
+static inline void dynamixel_shm_write_state(dynamixel_shm_t* shm, uint8_t id, const dynamixel_shm_state_t* state) {
+	dynamixel_shm_slot_t* slot=&shm->servo[id];
+	uint32_t seq=slot->seq;
+
+	__atomic_store_n(&slot->seq, seq+1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy((void*)&slot->state, state, sizeof(*state));
+	__atomic_store_n(&slot->seq, seq+2, __ATOMIC_RELEASE);
+}
+
+/*
+ * queues a goal position for the next tick, a moving_speed of 0 leaves the
+ * speed register alone. returns 0 on success, -1 if the ring is full or the
+ * id is invalid.
+ */
+static inline int dynamixel_shm_write_goal(dynamixel_shm_t* shm, uint8_t id, uint16_t goal_position, uint16_t moving_speed) {
+	dynamixel_shm_command_t* cell;
+	uint32_t pos;
+	uint32_t seq;
+	int32_t diff;
+
+	if (id>=DYNAMIXEL_SHM_MAX_ID) {
+		return -1;
+	}
+	pos=__atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+	while (1) {
+		cell=&shm->ring[pos&(DYNAMIXEL_SHM_RING_SIZE-1)];
+		seq=__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		diff=(int32_t)(seq-pos);
+		if (diff==0) {
+			if (__atomic_compare_exchange_n(&shm->head, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (diff<0) {
+			return -1;
+		} else {
+			pos=__atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+		}
+	}
+	cell->id=id;
+	cell->with_speed=(moving_speed!=0);
+	cell->goal_position=goal_position;
+	cell->moving_speed=moving_speed;
+	__atomic_store_n(&cell->seq, pos+1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* service side of the ring, single consumer. returns 0 if a command was taken */
+static inline int dynamixel_shm_take_command(dynamixel_shm_t* shm, dynamixel_shm_command_t* command) {
+	uint32_t pos=shm->tail;
+	dynamixel_shm_command_t* cell=&shm->ring[pos&(DYNAMIXEL_SHM_RING_SIZE-1)];
+	uint32_t seq=__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+
+	if ((int32_t)(seq-(pos+1))<0) {
+		return -1;
+	}
+	*command=*cell;
+	__atomic_store_n(&cell->seq, pos+DYNAMIXEL_SHM_RING_SIZE, __ATOMIC_RELEASE);
+	__atomic_store_n(&shm->tail, pos+1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_SHM_SERVICE_C
+#define DYNAMIXEL_SHM_SERVICE_C
+
+#include <sys/stat.h>
+#include "dynamixel_shm_service.h"
+
+/* writes all ids with the given pending mode, split to fit into one packet each */
+static void dynamixel_shm_service_flush(dynamixel_shm_service_t* service, uint8_t mode) {
+	uint8_t word_count=mode;
+	uint8_t max_ids=DYNAMIXEL_MAX_PARAMETER_COUNT/(1+2*word_count);
+	uint8_t id_count=0;
+	int16_t dynamixel_ret;
+
+	for (uint16_t id=0; id<=DYNAMIXEL_SHM_MAX_ID; id++) {
+		if ((id<DYNAMIXEL_SHM_MAX_ID) && (service->pending[id]==mode)) {
+			uint16_t* p=&service->data[id_count*(word_count+1)];
+			p[0]=id;
+			p[1]=service->goal[id];
+			if (word_count==2) {
+				p[2]=service->speed[id];
+			}
+			service->pending[id]=0;
+			id_count++;
+		}
+		if ((id_count==max_ids) || ((id==DYNAMIXEL_SHM_MAX_ID) && id_count)) {
+			dynamixel_ret=dynamixel_bus_sync_write_words(
+				service->bus,
+				DYNAMIXEL_R_GOAL_POSITION_L,		/*register*/
+				id_count,												/*id-count*/
+				word_count,											/*word_count*/
+				service->data,
+				false
+			);
+			if ((dynamixel_ret<0) && (service->debug)) {
+				std::cout << "Shm goal write failed: " << dynamixel_ret << std::endl;
+			}
+			id_count=0;
+		}
+	}
+}
+
+static void dynamixel_shm_service_poll(dynamixel_shm_service_t* service) {
+	dynamixel_shm_state_t state;
+	dynamixel_bus_timing_t timing;
+	uint8_t data[8];
+	uint8_t id;
+	int16_t dynamixel_ret;
+
+	for (uint8_t i=0; (i<DYNAMIXEL_SHM_SERVICE_POLL) && (i<service->servo_count); i++) {
+		id=service->poll_next+1;
+		service->poll_next=(service->poll_next+1)%service->servo_count;
+
+		/* present position, speed, load, voltage and temperature */
+		dynamixel_ret=dynamixel_bus_read_data_timed(service->bus, id, CALIBRATION_R_PRESENT_POSITION_L, 8, data, &timing);
+		if (dynamixel_ret!=8) {
+			continue;
+		}
+		state.timestamp_ns=timing.t_reply_ns;
+		state.transaction_ns=timing.duration_ns;
+		state.position=register_decode_word(data);
+		state.speed=register_decode_word(data+2);
+		state.load=register_decode_word(data+4);
+		state.voltage=data[6];
+		state.temperature=data[7];
+		state.valid=1;
+		dynamixel_shm_write_state(service->shm, id, &state);
+	}
+}
+
+/* one tick: drains the ring, writes the coalesced goals and polls a few servos */
+void dynamixel_shm_service_tick(dynamixel_shm_service_t* service) {
+	dynamixel_shm_command_t command;
+	bool have_goal=false;
+	bool have_speed=false;
+
+	while (dynamixel_shm_take_command(service->shm, &command)==0) {
+		service->goal[command.id]=command.goal_position;
+		if (command.with_speed) {
+			service->speed[command.id]=command.moving_speed;
+			service->pending[command.id]=2;
+			have_speed=true;
+		} else if (service->pending[command.id]!=2) {
+			service->pending[command.id]=1;
+			have_goal=true;
+		}
+	}
+	if (have_goal) {
+		dynamixel_shm_service_flush(service, 1);
+	}
+	if (have_speed) {
+		dynamixel_shm_service_flush(service, 2);
+	}
+	if (service->servo_count) {
+		dynamixel_shm_service_poll(service);
+	}
+}
+
+void *dynamixel_shm_service_thread(void* arg) {
+	dynamixel_shm_service_t* service=(dynamixel_shm_service_t*)arg;
+	struct timespec next;
+	long period_ns=1000000000L/service->rate;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (true) {
+		dynamixel_shm_service_tick(service);
+
+		next.tv_nsec+=period_ns;
+		if (next.tv_nsec>=1000000000L) {
+			next.tv_nsec-=1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+	return NULL;
+}
+
+bool dynamixel_shm_service_create(dynamixel_shm_service_t* service, dynamixel_bus_t* bus, const std::string& name, uint16_t servo_count) {
+	int fd;
+	void* p;
+
+	service->bus=bus;
+	service->name=name;
+	service->rate=DYNAMIXEL_SHM_SERVICE_RATE;
+	service->servo_count=(servo_count<DYNAMIXEL_SHM_MAX_ID) ? servo_count : DYNAMIXEL_SHM_MAX_ID-1;
+	service->poll_next=0;
+	memset(service->pending, 0, sizeof(service->pending));
+
+	/*
+	 * a region left by a service that was killed is replaced, not reused:
+	 * clients still mapping it keep the old one and see it go stale
+	 */
+	shm_unlink(name.c_str());
+	fd=shm_open(name.c_str(), O_CREAT|O_EXCL|O_RDWR, 0660);
+	if (fd<0) {
+		std::cerr << "Can't create shared memory " << name << std::endl;
+		return false;
+	}
+	if (ftruncate(fd, sizeof(dynamixel_shm_t))!=0) {
+		std::cerr << "Can't resize shared memory " << name << std::endl;
+		close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+	p=mmap(NULL, sizeof(dynamixel_shm_t), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p==MAP_FAILED) {
+		std::cerr << "Can't map shared memory " << name << std::endl;
+		shm_unlink(name.c_str());
+		return false;
+	}
+	service->shm=(dynamixel_shm_t*)p;
+
+	/* clients check the magic, so set it last */
+	memset(p, 0, sizeof(dynamixel_shm_t));
+	for (uint32_t i=0; i<DYNAMIXEL_SHM_RING_SIZE; i++) {
+		service->shm->ring[i].seq=i;
+	}
+	service->shm->version=DYNAMIXEL_SHM_VERSION;
+	service->shm->ring_size=DYNAMIXEL_SHM_RING_SIZE;
+	service->shm->max_id=DYNAMIXEL_SHM_MAX_ID;
+	__atomic_store_n(&service->shm->magic, (uint32_t)DYNAMIXEL_SHM_MAGIC, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool dynamixel_shm_service_init(dynamixel_shm_service_t* service, dynamixel_bus_t* bus, const std::string& name, uint16_t servo_count) {
+	if (!dynamixel_shm_service_create(service, bus, name, servo_count)) {
+		return false;
+	}
+	if (service->debug) {
+		std::cout << "Shared memory " << name << " ready (" << sizeof(dynamixel_shm_t) << " bytes)" << std::endl;
+	}
+
+	pthread_create(&service->thread, NULL, &dynamixel_shm_service_thread, (void*)service);
+	return true;
+}
+
+/* removes the name, clients that have the region mapped keep it until they close it */
+void dynamixel_shm_service_unlink(dynamixel_shm_service_t* service) {
+	shm_unlink(service->name.c_str());
+}
+
+#endif
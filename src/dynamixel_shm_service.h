@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef DYNAMIXEL_SHM_SERVICE_H
+#define DYNAMIXEL_SHM_SERVICE_H
+
+#include <pthread.h>
+#include <string>
+#include "dynamixel_shm.h"
+
+#define DYNAMIXEL_SHM_SERVICE_RATE      100		/* Hz */
+#define DYNAMIXEL_SHM_SERVICE_POLL      4			/* servo state reads per tick */
+
+typedef struct {
+	bool											debug;
+	dynamixel_bus_t*					bus;
+	dynamixel_shm_t*					shm;
+	std::string								name;
+	uint16_t									rate;
+	uint8_t										servo_count;		/* ids 1..servo_count are polled */
+	uint8_t										poll_next;
+	/* last goal per id, coalesced over one tick */
+	uint16_t									goal[DYNAMIXEL_SHM_MAX_ID];
+	uint16_t									speed[DYNAMIXEL_SHM_MAX_ID];
+	uint8_t										pending[DYNAMIXEL_SHM_MAX_ID];	/* 1: goal, 2: goal+speed */
+	uint16_t									data[DYNAMIXEL_MAX_PARAMETER_COUNT];
+	pthread_t									thread;
+} dynamixel_shm_service_t;
+
+/* maps and formats the region, init also starts the service thread */
+bool dynamixel_shm_service_create(dynamixel_shm_service_t* service, dynamixel_bus_t* bus, const std::string& name, uint16_t servo_count);
+bool dynamixel_shm_service_init(dynamixel_shm_service_t* service, dynamixel_bus_t* bus, const std::string& name, uint16_t servo_count);
+void dynamixel_shm_service_tick(dynamixel_shm_service_t* service);
+void dynamixel_shm_service_unlink(dynamixel_shm_service_t* service);
+
+#endif
@@ -6,6 +6,7 @@
  */
 
 #include <unistd.h>
+#include <signal.h>
 
 #include "boost/program_options.hpp"
 #include <iostream>
@@ -20,164 +21,96 @@
 #include <dynamixel-rtu.h>
 
 #include "config.h"
+#include "dynamixel_zmq.h"
 
-#ifdef ENABLE_PYPOSE_COMMANDS
-#define PYPOSE_ID             253
-#define PYPOSE_MAX_POSE_SIZE  32
-#define PYPOSE_MAX_POSE_COUNT 255
-#define PYPOSE_MAX_SEQUENCE_COUNT 255
-typedef struct {
-	uint8_t len;
-	uint16_t *values;
-} pypose_pose_t;
+#include "dynamixel_serial.h"
+#include "dynamixel_serial.c"
 
-pypose_pose_t* pyPose_Poses[PYPOSE_MAX_POSE_COUNT];
+#include "dynamixel_bus.h"
+#include "dynamixel_bus.c"
 
-typedef struct {
-	uint8_t pose_id;
-	uint16_t delay;
-} pypose_seq_part_t;
+#include "calibration.h"
+#include "calibration.c"
 
-typedef struct {
-	uint8_t len;
-	pypose_seq_part_t* parts;
-} pypose_sequence_t;
+#include "register_map.h"
+#include "register_map.c"
 
-pypose_sequence_t* pyPose_Sequences[PYPOSE_MAX_SEQUENCE_COUNT];
+#include "dynamixel_shm_service.h"
+#include "dynamixel_shm_service.c"
 
-uint8_t pyPose_PoseSize=0;
+#include "subscription.h"
+#include "subscription.c"
 
+#ifdef ENABLE_PYPOSE_COMMANDS
+#include "pypose.h"
+#include "pypose_player.h"
+#include "pypose.c"
+#include "pypose_player.c"
 #endif
 
-#include "dynamixel.h"
-typedef enum {
-	/* default dynamixel commands */
-	DYNAMIXEL_RQ_PING					=0x01,
-	DYNAMIXEL_RQ_READ_DATA		=0x02,
-	DYNAMIXEL_RQ_WRITE_DATA		=0x03,
-	DYNAMIXEL_RQ_REG_WRITE		=0x04,
-	DYNAMIXEL_RQ_REG_ACTION		=0x05,
-	DYNAMIXEL_RQ_RESET				=0x06,
-	DYNAMIXEL_RQ_SYNC_WRITE		=0x83,
-	
-	/* custom commands */
-	DYNAMIXEL_RQ_ZMQ_ECHO					=0x100,
-	
-	DYNAMIXEL_RQ_SYNC_WRITE_WORDS	=0x183, 
+#ifdef ENABLE_GAIT_ENGINE
+#include "gait.h"
+#include "gait.c"
+#endif
+
+/* every module registers its own commands */
+#include "command.h"
+#include "command.c"
+#include "dynamixel_commands.c"
+#include "subscription_commands.c"
 #ifdef ENABLE_PYPOSE_COMMANDS
-	/*0x07, <pose-size>*/
-	PYPOSE_SET_POSESIZE				=0x07,
-	/*0x08, <index>. <pos1_L>, <pos1_H> */
-	PYPOSE_LOAD_POSE					=0x08,
-	/*0x08, <index>. <pos1_L>, <pos1_H> */
-	PYPOSE_LOAD_SEQUENCE			=0x09,
-	
-	PYPOSE_PLAY_SEQUENCE			=0x0A,
-	PYPOSE_LOOP_SEQUENCE			=0x0B,
-	PYPOSE_TEST								=0x19,
+#include "pypose_commands.c"
 #endif
-#ifdef ENABLE_TROSSEN_COMMANDER
-	TROSSEN_COMMANDER					=0x200,
+#ifdef ENABLE_GAIT_ENGINE
+#include "gait_commands.c"
 #endif
-} dynamixel_request_t;
-
-#define DESCRIPTION "dyn_zmq - Dynamixel ZeroMQ service"
-namespace { 
-	const size_t ERROR_IN_COMMAND_LINE = 1; 
-	const size_t SUCCESS = 0; 
-	const size_t ERROR_UNHANDLED_EXCEPTION = 2; 
-}
-
-typedef enum {
-	ZMQ_ERR_NO_ERROR								= 0,
-	ZMQ_ERR_INVALID_COMMAND					= -1000,
-	ZMQ_ERR_INVALID_FORMAT					= -1001,
-	ZMQ_ERR_INVALID_PARAMETERS			= -1002,
-	ZMQ_ERR_INVALID_PARAMETER_COUNT	= -1003,
-	ZMQ_ERR_INVALID_ID							= -1004,
-	ZMQ_ERR_BUS_OFFLINE							= -1010,
-	
-} zmq_error_code_t;
-//using namespace std;
-//using namespace dynapi;
 
+/* the shm region outlives the process unless its name is removed */
+static dynamixel_shm_service_t* shm_service_active=NULL;
 
-#ifdef ENABLE_PYPOSE_COMMANDS
-/* stuff for sequence playing */
-#include <pthread.h>
-#include <time.h>
-pthread_cond_t pyPose_SequencePlayer_active = PTHREAD_COND_INITIALIZER;
-
-typedef struct {
-	uint8_t state;
-	bool								enabled;
-	dynamixel_t*				dynamixel_ctx;
-	pypose_pose_t*			poses;
-	pypose_sequence_t* 	sequences;
-
-	pthread_mutex_t lock;
-	pthread_cond_t cond;
-} pypose_player_ctx_t;
-
-
-void *pyPose_SequencePlayer(void* arg){
-	pypose_player_ctx_t* player_ctx = (pypose_player_ctx_t*)arg;
-	int i=0;
-	while(true) {
-		pthread_mutex_lock(&player_ctx->lock);
-		while (player_ctx->enabled == false) {
-			i++;
-			std::cout << "Sleeping: " << i << std::endl;
-			pthread_cond_wait(&player_ctx->cond, &player_ctx->lock);
-		}
-		pthread_mutex_unlock(&player_ctx->lock);
-		i++;
-		sleep(1);
-		std::cout << "Threading: " << i << std::endl;
+static void dynamixel_zmq_terminate(int sig) {
+	if (shm_service_active) {
+		dynamixel_shm_service_unlink(shm_service_active);
 	}
-	//pthread_cond_broadcast(&player_ctx->cond);
-	//
-	return NULL;
+	signal(sig, SIG_DFL);
+	raise(sig);
 }
 
-void pyPose_SequencePlayer_cmd(uint8_t command);
-#endif
-
 int main(int argc, char** argv) {
 	// === program parameters ===
 	std::string zmq_uri="tcp://*:5555";
 	std::string serial_port="/dev/ttyUSB0";
 	std::string interface_type="rs232";
+	std::string transport="libdynamixel";
+	uint16_t status_return=DYNAMIXEL_SERIAL_RETURN_ALL;
 	uint32_t serial_speed=1000000;
 	
 	bool debug=false;
 	
 	int16_t tx_error_code=0;
 	
-	int16_t dynamixel_ret=0;
+	command_ctx_t commands;
+
+	std::string calibration_file;
+	calibration_t calibration;
+
+	std::string shm_name;
+	uint16_t shm_servos=18;
+	dynamixel_shm_service_t shm_service;
+
+	std::string pub_uri;
+	uint16_t pub_rate=SUBSCRIPTION_RATE;
+	static subscription_service_t subscriptions;		/* too large for the stack */
 	
 #ifdef ENABLE_PYPOSE_COMMANDS
-	//void* print_message(void*);
-	
 	pypose_player_ctx_t pyPose_Player_Context;
-	pyPose_Player_Context.enabled=true;
-	pthread_mutex_init(&pyPose_Player_Context.lock, NULL);
-	pthread_cond_init(&pyPose_Player_Context.cond, NULL);
-	
 	pthread_t pyPose_Player_Thread;
-	pthread_create(&pyPose_Player_Thread, NULL, &pyPose_SequencePlayer, (void*)&pyPose_Player_Context);
 
-	//sleep(10);
-	pyPose_Player_Context.enabled=false;
-	
-	uint16_t pose_idx;
-	for (pose_idx=0; pose_idx<PYPOSE_MAX_POSE_COUNT; pose_idx++) {
-		pyPose_Poses[pose_idx]=NULL;
-	}
-	uint16_t seq_idx;
-	for (seq_idx=0; seq_idx<PYPOSE_MAX_SEQUENCE_COUNT; seq_idx++) {
-		pyPose_Sequences[seq_idx]=NULL;
-	}
+	pypose_library_init();
+#endif
+#ifdef ENABLE_GAIT_ENGINE
+	gait_ctx_t gait;
+	uint16_t gait_rate=GAIT_MIN_RATE;
 #endif
 	namespace po = boost::program_options;
 
@@ -189,8 +122,18 @@ int main(int argc, char** argv) {
 		("port", po::value< std::string >( &serial_port ),		"serial port       | default: /dev/ttyUSB0" )
 		("speed", po::value< uint32_t >( &serial_speed ),			"serial speed      | default: 1000000" )
 		("type", po::value< std::string >( &interface_type ),	"interface type    | default: rs232" )
+		("transport", po::value< std::string >( &transport ),	"bus transport     | default: libdynamixel, or native" )
+		("status-return", po::value< uint16_t >( &status_return ),	"status return level of all servos (native) | default: 2" )
+		("calibration", po::value< std::string >( &calibration_file ),	"servo calibration file" )
+		("shm", po::value< std::string >( &shm_name ),				"publish servo state in shared memory, e.g. /dyn_zmq" )
+		("shm-servos", po::value< uint16_t >( &shm_servos ),	"servo ids polled for shm | default: 18 (1..18)" )
+		("pub", po::value< std::string >( &pub_uri ),					"publish subscription notifications, e.g. tcp://*:5556" )
+		("pub-rate", po::value< uint16_t >( &pub_rate ),			"subscription poll rate | default: 50 Hz" )
 		("dynamixel-scan", "scan for dynamixel servos")
 		("debug", "print out debugging info")
+#ifdef ENABLE_GAIT_ENGINE
+		("gait-rate", po::value< uint16_t >( &gait_rate ),		"gait engine rate  | default: 100 (100..200 Hz)" )
+#endif
 	;
 
   po::variables_map vm;
@@ -208,6 +151,9 @@ int main(int argc, char** argv) {
 #ifdef ENABLE_TROSSEN_COMMANDER
 			std::cout << "  * Trossen Commander support" << std::endl;
 #endif
+#ifdef ENABLE_GAIT_ENGINE
+			std::cout << "  * Gait engine" << std::endl;
+#endif
 			
 			return SUCCESS; 
 		}
@@ -215,6 +161,15 @@ int main(int argc, char** argv) {
 		if (vm.count("debug")) {
 			debug=true;
 		}
+		if ((transport!="libdynamixel") && (transport!="native")) {
+			throw po::validation_error(po::validation_error::invalid_option_value, "transport", transport);
+		}
+		if (status_return>DYNAMIXEL_SERIAL_RETURN_ALL) {
+			throw po::validation_error(po::validation_error::invalid_option_value, "status-return");
+		}
+		if ((pub_rate==0) || (pub_rate>1000)) {
+			throw po::validation_error(po::validation_error::invalid_option_value, "pub-rate");
+		}
 	} catch(po::error& e) {
 		std::cerr << "ERROR: " << e.what() << std::endl << std::endl; 
 		std::cerr << desc << std::endl; 
@@ -227,16 +182,43 @@ int main(int argc, char** argv) {
 		std::cout << "speed = " << serial_speed << std::endl;
 	}
 	
+	calibration_init(&calibration);
+	if (calibration_file.size() && !calibration_load(&calibration, calibration_file, debug)) {
+		return ERROR_IN_COMMAND_LINE;
+	}
+
 	// === dynamixel part ===
-	dynamixel_t *dyn;
-	dyn = dynamixel_new_rtu(serial_port.c_str(), (uint32_t)serial_speed, _DYNAMIXEL_SERIAL_DEFAULTS);
+	dynamixel_t *dyn=NULL;
+	dynamixel_serial_t serial;
 
 	int8_t dyn_connected;
-	dynamixel_set_debug(dyn,debug);
-	dyn_connected=dynamixel_connect(dyn);
+	if (transport=="native") {
+		serial.debug=debug;
+		dyn_connected=dynamixel_serial_open(&serial, serial_port.c_str(), serial_speed);
+		if (dyn_connected!=0) {
+			/* like libdynamixel: the service runs, bus commands fail with ZMQ_ERR_BUS_OFFLINE */
+			std::cerr << "ERROR: can't open " << serial_port << " with the native transport" << std::endl;
+		}
+		/* corrected per servo whenever register 16 is read or written */
+		dynamixel_serial_set_status_return(&serial, DYNAMIXEL_SERIAL_BROADCAST_ID, status_return);
+	} else {
+		dyn = dynamixel_new_rtu(serial_port.c_str(), (uint32_t)serial_speed, _DYNAMIXEL_SERIAL_DEFAULTS);
+		dynamixel_set_debug(dyn,debug);
+		dyn_connected=dynamixel_connect(dyn);
+	}
 	
 	if (vm.count("dynamixel-scan")) {
-		if (dyn_connected==0) {
+		if ((dyn_connected==0) && (dyn==NULL)) {
+			uint8_t id_count=0;
+			for (uint8_t id=1; id<=30; id++) {
+				if (dynamixel_serial_ping(&serial, id)>=0) {
+					printf("  * Dynamixels #% 3i found @ % 2i\n", id_count++, id);
+				}
+			}
+			printf("%i Dynamixels found\n",id_count);
+			dynamixel_serial_close(&serial);
+			return SUCCESS;
+		} else if (dyn_connected==0) {
 			uint8_t *found_ids;
 			uint8_t id_count;
 			id_count=dynamixel_search(dyn, 1,30,&found_ids);
@@ -252,29 +234,75 @@ int main(int argc, char** argv) {
 			dynamixel_free(dyn);
 			return SUCCESS; 
 		} else {
-			dynamixel_free(dyn);
+			if (dyn) {
+				dynamixel_free(dyn);
+			}
 			return 0;
 		}
 	}
-		
+
+	// from here on only the bus thread touches dyn or serial
+	dynamixel_bus_t bus;
+	bus.debug=debug;
+	dynamixel_bus_init(&bus, dyn, (dyn==NULL) ? &serial : NULL);
+
+	if (shm_name.size()) {
+		shm_service.debug=debug;
+		if (!dynamixel_shm_service_init(&shm_service, &bus, shm_name, (dyn_connected==0) ? shm_servos : 0)) {
+			return ERROR_UNHANDLED_EXCEPTION;
+		}
+		shm_service_active=&shm_service;
+		signal(SIGINT, dynamixel_zmq_terminate);
+		signal(SIGTERM, dynamixel_zmq_terminate);
+	}
+
+#ifdef ENABLE_PYPOSE_COMMANDS
+	pyPose_Player_Context.debug=debug;
+	pyPose_Player_Context.bus=&bus;
+	pypose_player_init(&pyPose_Player_Thread, &pyPose_Player_Context);
+#endif
+#ifdef ENABLE_GAIT_ENGINE
+	gait.debug=debug;
+	gait_init(&gait, &bus, &calibration, gait_rate);
+#endif
+
+	commands.debug=debug;
+	commands.bus_online=(dyn_connected==0);
+	commands.bus=&bus;
+	commands.calibration=&calibration;
+	commands.subscriptions=NULL;
+	commands.move_tag=0;
+	memset(commands.move_goal_tag, 0, sizeof(commands.move_goal_tag));
+#ifdef ENABLE_PYPOSE_COMMANDS
+	commands.player=&pyPose_Player_Context;
+#endif
+#ifdef ENABLE_GAIT_ENGINE
+	commands.gait=&gait;
+#endif
 		
 	// === ZMQ part ===
 	zmq::context_t context (1);
 	zmq::socket_t socket (context, ZMQ_REP);
 	socket.bind (zmq_uri.c_str());
 
+	if (pub_uri.size() && (dyn_connected==0)) {
+		subscriptions.debug=debug;
+		if (!subscription_init(&subscriptions, &bus, &context, pub_uri, pub_rate)) {
+			if (shm_service_active) {
+				dynamixel_shm_service_unlink(shm_service_active);
+			}
+			return ERROR_UNHANDLED_EXCEPTION;
+		}
+		commands.subscriptions=&subscriptions;
+	}
+
 	if (debug) {
 		std::cout << "Server started (uri="<<zmq_uri<<")" << std::endl;
 	}
 
-	/* i decided to use a static buffer instead of malloc on every call */
-	uint8_t		tmp_uint8[DYNAMIXEL_MAX_PARAMETER_COUNT];
-	uint16_t	tmp_uint16[DYNAMIXEL_MAX_PARAMETER_COUNT/2];
-	
 	while (true) {
 		zmq::message_t rx_zmq;
 		msgpack::object rx_obj;
-		msgpack::object tx_obj;
 		msgpack::sbuffer tx_msg;
 		msgpack::unpacked rx_msg;
 		std::vector<int16_t> rx_vect;
@@ -282,6 +310,9 @@ int main(int argc, char** argv) {
 
 		//  Wait for next request from client
 		if (socket.recv (&rx_zmq)) {
+			struct timespec t_receive;
+			clock_gettime(CLOCK_MONOTONIC, &t_receive);
+			commands.t_receive_ns=(uint64_t)t_receive.tv_sec*1000000000ULL+t_receive.tv_nsec;
 			// Deserialize the serialized data.
 
 			msgpack::unpack(&rx_msg, static_cast<char*>(rx_zmq.data()), rx_zmq.size());
@@ -307,336 +338,26 @@ int main(int argc, char** argv) {
 			}
 			
 			if (tx_error_code==0) {
+				struct timespec t_start;
+				struct timespec t_end;
 				if (debug) {
-					std::cout << "command: " << (int16_t)rx_vect.at(0) << std::endl;
+					if (rx_vect.size()) {
+						std::cout << "command: " << (int16_t)rx_vect.at(0) << std::endl;
+					}
+					clock_gettime(CLOCK_MONOTONIC, &t_start);
 				}
-				
-
-				switch (rx_vect.at(0)) {
-					case DYNAMIXEL_RQ_PING:
-						//zmq-message: <cmd>,<id>
-						if (rx_vect.size()!=2) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							dynamixel_ret=dynamixel_ping(dyn,(uint8_t)rx_vect.at(1));
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-
-					case DYNAMIXEL_RQ_READ_DATA:
-						//zmq-message: <cmd>,<id>,<register>,<count>
-						if (rx_vect.size()!=4) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							uint8_t *pdata;
-							dynamixel_ret=dynamixel_read_data(
-								dyn,
-								(uint8_t)rx_vect.at(1),							/*id*/
-								(dynamixel_register_t)rx_vect.at(2),/*address*/
-								(uint8_t)rx_vect.at(3),							/*count*/
-								&pdata
-							);
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							if (dynamixel_ret) {
-								for (uint8_t i=0; i<dynamixel_ret;i++) {
-									tx_vect.push_back(pdata[i]);
-								}
-							}
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-					case DYNAMIXEL_RQ_WRITE_DATA:
-						//zmq-message: <cmd>,<id>,<register>,<count>,<data>,<data+1>
-						if ((rx_vect.size()<5) or ((uint16_t)(rx_vect.at(3)+4)>rx_vect.size())) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							/* copy into uint8_t*/
-							for (uint8_t cP=0;cP<(rx_vect.size()-4);cP++) {
-								tmp_uint8[cP]=rx_vect.at(cP+4);
-							}
-							dynamixel_ret=dynamixel_write_data(
-								dyn,
-								(uint8_t)rx_vect.at(1),
-								(dynamixel_register_t)rx_vect.at(2),
-								rx_vect.size()-4,
-								tmp_uint8
-							);
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-					case DYNAMIXEL_RQ_REG_WRITE:
-						//zmq-message: <cmd>,<id>,<register>,<count>,<data>,<data+1>
-						/* this will cut higher bytes from parameters */
-						if (dyn_connected==0) {
-							/* copy into uint8_t*/
-							for (uint8_t cP=0;cP<rx_vect.size()-4;cP++) {
-								tmp_uint8[cP]=rx_vect.at(cP+4);
-							}
-							dynamixel_ret=dynamixel_reg_write(
-								dyn,
-								(uint8_t)rx_vect.at(1),
-								(dynamixel_register_t)rx_vect.at(2),
-								rx_vect.size()-4,
-								tmp_uint8
-							);
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-					case DYNAMIXEL_RQ_REG_ACTION:
-						//zmq-message: <cmd>,<id>
-						if (rx_vect.size()!=2) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							dynamixel_ret=dynamixel_action(dyn,(uint8_t)rx_vect.at(1));
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-						
-					case DYNAMIXEL_RQ_RESET:
-						//zmq-message: <cmd>,<id>
-						if (rx_vect.size()!=2) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							dynamixel_ret=dynamixel_reset(dyn,(uint8_t)rx_vect.at(1));
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-						
-					case DYNAMIXEL_RQ_SYNC_WRITE:
-						//zmq-message: <cmd>,<register>,<id_count>,<parameter_count>,<servo-id>,<data>,<data+n>
-						if ((rx_vect.size()<6) or ((uint16_t)(rx_vect.at(2)*(rx_vect.at(3)+1))>rx_vect.size())) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							/* copy into uint8_t*/
-							for (uint8_t i=0;i<(rx_vect.at(2)*(rx_vect.at(3)+1));i++) {
-								tmp_uint8[i]=rx_vect.at(i+4);
-							}
-							dynamixel_ret=dynamixel_sync_write(
-								dyn,
-								(dynamixel_register_t)rx_vect.at(1),	/*register*/
-								(uint8_t)rx_vect.at(2),								/*id-count*/
-								(uint8_t)rx_vect.at(3),								/*parameter_count*/
-								tmp_uint8
-							);
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-						
-					case DYNAMIXEL_RQ_SYNC_WRITE_WORDS:
-						//zmq-message: <cmd>,<register>,<id_count>,<parameter_count>,<servo-id>,<data>,<data+n>
-						if ((rx_vect.size()<6) or ((uint16_t)(rx_vect.at(2)*(rx_vect.at(3)+1))>rx_vect.size())) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							/* copy into uint8_t*/
-							for (uint8_t i=0;i<(rx_vect.at(2)*(rx_vect.at(3)+1));i++) {
-								tmp_uint16[i]=rx_vect.at(i+4);
-							}
-							dynamixel_ret=dynamixel_sync_write_words(
-								dyn,
-								(dynamixel_register_t)rx_vect.at(1),	/*register*/
-								(uint8_t)rx_vect.at(2),								/*id-count*/
-								(uint8_t)rx_vect.at(3),								/*word_count*/
-								tmp_uint16
-							);
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-						} else {
-							tx_error_code=ZMQ_ERR_BUS_OFFLINE;
-						}
-						break;
-
-					case DYNAMIXEL_RQ_ZMQ_ECHO:
-						//zmq-message: <cmd>,<data>,<data+n>
-						tx_obj=rx_obj;
-						tx_error_code=ZMQ_ERR_NO_ERROR;
-						break;
-#ifdef ENABLE_PYPOSE_COMMANDS
-					case PYPOSE_SET_POSESIZE:
-						//zmq-message: <cmd>,<id>,<size>
-						if (rx_vect.at(1)==PYPOSE_ID) {
-							if (rx_vect.at(2)<PYPOSE_MAX_POSE_SIZE) {
-								pyPose_PoseSize=(uint8_t)rx_vect.at(2);
-								if (debug) {
-									std::cout << "New pose size received: "<< (int)pyPose_PoseSize << std::endl;
-								}
-								tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-								tx_vect.push_back(pyPose_PoseSize);
-							} else {
-								tx_error_code=ZMQ_ERR_INVALID_PARAMETERS;
-							}
-						} else {
-							tx_error_code=ZMQ_ERR_INVALID_ID;
-						}
-						break;
-					case PYPOSE_LOAD_POSE:
-						//zmq-message: <cmd>,<id>,<index>,<pos1_L>, <pos1_H>
-						if (rx_vect.at(1)==PYPOSE_ID) {
-							pose_idx=rx_vect.at(2);
-							if ((pyPose_PoseSize<PYPOSE_MAX_POSE_SIZE) && ((uint16_t)rx_vect.size()==(pyPose_PoseSize*2+3))) {
-								if (pose_idx<PYPOSE_MAX_POSE_COUNT) {
-									if (not pyPose_Poses[pose_idx]) {
-										//pose does not exist already
-										pyPose_Poses[pose_idx]=(pypose_pose_t*)malloc(sizeof(pypose_pose_t));
-										pyPose_Poses[pose_idx]->len=0;
-										pyPose_Poses[pose_idx]->values=NULL;
-									}
-									if ((pyPose_Poses[pose_idx]->values) && (pyPose_Poses[pose_idx]->len != pyPose_PoseSize)) {
-										//pose size not corret
-										free(pyPose_Poses[pose_idx]->values);
-										pyPose_Sequences[seq_idx]->parts=NULL;
-										pyPose_Poses[pose_idx]->len=0;
-									}
-									if (not pyPose_Poses[pose_idx]->len) {
-										//create new memory
-										pyPose_Poses[pose_idx]->values=(uint16_t*)malloc(sizeof(uint16_t)*pyPose_PoseSize);
-										pyPose_Poses[pose_idx]->len=pyPose_PoseSize;
-									}
-									//now do a copy
-									uint16_t* uint16p=pyPose_Poses[pose_idx]->values;
-									for (uint8_t i=0;i<pyPose_PoseSize;i++) {
-										uint16p[i]=rx_vect.at(3+i*2)|(rx_vect.at(4+i*2)<<8);
-									}
-									if (debug) {
-										std::cout << "New pose received." << std::endl;
-										std::cout << "  * length: "<< (int)pyPose_PoseSize  << std::endl;
-										std::cout << "  * id    : "<< pose_idx  << std::endl;
-										std::cout << "  * data  : "<<  std::endl;
-										std::cout << "          : ";
-										for (uint8_t i=0;i<pyPose_PoseSize;i++) {
-											std::cout << uint16p[i] << ",";
-										}
-										std::cout <<  std::endl;
-									}
-									tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-									tx_vect.push_back(pose_idx);
-									tx_vect.push_back(pyPose_PoseSize);
-								} else {
-									tx_error_code=ZMQ_ERR_INVALID_PARAMETERS;
-								}
-							} else {
-								tx_error_code=ZMQ_ERR_INVALID_PARAMETERS;
-							}
-						} else {
-							tx_error_code=ZMQ_ERR_INVALID_ID;
-						}
-						break;
-					case PYPOSE_LOAD_SEQUENCE:
-						//zmq-message: <cmd>,<id>,<pose_id>,<delay_L>,<delay_H>,<???>,<???>,<???>
-						if (rx_vect.at(1)==PYPOSE_ID) {
-							uint8_t no_elements=((uint16_t)rx_vect.size()-2)/3;
-							seq_idx=0;
-							if (!pyPose_Sequences[seq_idx]) {
-								pyPose_Sequences[seq_idx]=(pypose_sequence_t*)malloc(sizeof(pypose_sequence_t));
-								pyPose_Sequences[seq_idx]->len=0;
-								pyPose_Sequences[seq_idx]->parts=NULL;
-							}
-							pypose_sequence_t* cSeq=pyPose_Sequences[seq_idx];
-							if ((cSeq->parts) && (cSeq->len != no_elements)) {
-								//sequence size not corret
-								free(cSeq->parts);
-								cSeq->parts=NULL;
-								cSeq->len=0;
-							}
-							if (not cSeq->len) {
-								cSeq->len=no_elements;
-								//create new memory
-								cSeq->parts=(pypose_seq_part_t*)malloc(sizeof(pypose_seq_part_t)*no_elements);
-							}
-							for (uint8_t i=0;i<no_elements;i++) {
-								cSeq->parts[i].pose_id = rx_vect.at(2+3*i);
-								cSeq->parts[i].delay = rx_vect.at(3+3*i)|(rx_vect.at(4+3*i)<<8);
-							}
-							if (debug) {
-								std::cout << "New sequence received." << std::endl;
-								std::cout << "  * length: "<< (int)no_elements  << std::endl;
-								std::cout << "  * id    : "<< seq_idx  << std::endl;
-								std::cout << "  * data  : "<<  std::endl;
-								std::cout << "          : ";
-								for (uint8_t i=0;i<no_elements;i++) {
-									std::cout << (int)(cSeq->parts[i].pose_id) << ":" << (int)(cSeq->parts[i].delay) << " | ";
-								}
-								std::cout <<  std::endl;
-							}
-									
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(seq_idx);
-							tx_vect.push_back(no_elements);
-						} else {
-							tx_error_code=ZMQ_ERR_INVALID_ID;
-						}
-						break;
-					case PYPOSE_PLAY_SEQUENCE:
-						//zmq-message: <cmd>,<id>
-						if (rx_vect.at(1)==PYPOSE_ID) {
-							if (debug) {
-								std::cout << "Nothing to do for load sequence." << std::endl;
-							}
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-						} else {
-							tx_error_code=ZMQ_ERR_INVALID_ID;
-						}
-						break;
-					case PYPOSE_LOOP_SEQUENCE:
-						if (rx_vect.at(1)==PYPOSE_ID) {
-						} else {
-							tx_error_code=ZMQ_ERR_INVALID_ID;
-						}
-						break;
-					case PYPOSE_TEST:
-						if (rx_vect.at(1)==PYPOSE_ID) {
-						} else {
-							tx_error_code=ZMQ_ERR_INVALID_ID;
-						}
-						break;
-#endif
-#ifdef ENABLE_TROSSEN_COMMANDER
-					case TROSSEN_COMMANDER:
-						if (rx_vect.size()!=6) {
-							tx_error_code=ZMQ_ERR_INVALID_PARAMETER_COUNT;
-						} else if (dyn_connected==0) {
-							trossen_cmd_t command;
-							command.right_V		=rx_vect.at(1);
-							command.right_H		=rx_vect.at(2);
-							command.left_V		=rx_vect.at(3);
-							command.left_H		=rx_vect.at(4);
-							command.buttons		=rx_vect.at(5);
-							dynamixel_ret=dynamixel_adv_trossen_cmd(
-								dyn,
-								&command
-							);
-							tx_vect.push_back(ZMQ_ERR_NO_ERROR);
-							tx_vect.push_back(dynamixel_ret);
-						}
-						break;
-#endif
-					default:
-						tx_error_code=ZMQ_ERR_INVALID_COMMAND;
+
+				tx_error_code=command_dispatch(&commands, rx_vect, tx_vect);
+				if (debug) {
+					clock_gettime(CLOCK_MONOTONIC, &t_end);
+					std::cout << "dispatch: "
+						<< (t_end.tv_sec-t_start.tv_sec)*1000000000L+(t_end.tv_nsec-t_start.tv_nsec) << "ns" << std::endl;
 				}
 				if (tx_error_code) {
+					tx_vect.clear();
 					tx_vect.push_back(tx_error_code);
-				} else if (tx_vect.size()) {
-					msgpack::pack(&tx_msg, tx_vect);
 				}
+				msgpack::pack(&tx_msg, tx_vect);
 			} else {
 				/* invalid incomming type, has to be list */
 				std::vector<int> tx_vect;
@@ -18,6 +18,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #ifndef DYNAMIXEL_ZMQ_H
+#define DYNAMIXEL_ZMQ_H
 
 typedef enum {
 	/* default dynamixel commands */
@@ -31,11 +32,31 @@ typedef enum {
 	
 	/* custom commands */
 	DYNAMIXEL_RQ_ZMQ_ECHO									=0x100,
+	/*0x101 -> <err>, <t_rx 4 words>, <t_tx 4 words> (service CLOCK_MONOTONIC ns, low word first) */
+	DYNAMIXEL_RQ_TIME_SYNC								=0x101,
+	/*0x102, <id>, <model>, <field>, <field+1>, ... see register_map.h */
+	DYNAMIXEL_RQ_READ_FIELDS							=0x102,
+	/* as 0x02 and 0x102, the reply starts with <err>, <t_reply 4 words>, <duration us> */
+	DYNAMIXEL_RQ_READ_DATA_TIMED					=0x103,
+	DYNAMIXEL_RQ_READ_FIELDS_TIMED				=0x104,
+	/*0x110, <id>, <model>, <field>, <mode>, <value>, <min interval ms> -> <err>, <handle>, see subscription.h */
+	DYNAMIXEL_RQ_SUBSCRIBE								=0x110,
+	/*0x111, <handle> */
+	DYNAMIXEL_RQ_UNSUBSCRIBE							=0x111,
 	
 	DYNAMIXEL_RQ_SYNC_WRITE_WORDS					=0x183, 
 
+	/* engineering units, see calibration.h */
+	/*0x400, <id_count>, <id>, <pos mrad>, <speed mrad/s>, <id+1>, ... */
+	DYNAMIXEL_RQ_UNIT_SYNC_WRITE					=0x400,
+	/*0x401, <id>, <id+1>, ... */
+	DYNAMIXEL_RQ_UNIT_READ_STATE					=0x401,
+	/*0x402, <id>, <id+1>, ... as 0x401 with <t_reply 4 words>, <duration us> after each id */
+	DYNAMIXEL_RQ_UNIT_READ_STATE_TIMED		=0x402,
+	/*0x403, <duration ms>, <id>, <goal mrad>, <id+1>, ... -> <err>, <bus ret>, <arrival spread us> */
+	DYNAMIXEL_RQ_MOVE_SYNC								=0x403,
+
 #ifdef ENABLE_PYPOSE_COMMANDS
-	DYNAMIXEL_RQ_READ_PYPOSE_PLAYER_STATE	=0x200, 
 	/*0x07, <pose-size>*/
 	PYPOSE_SET_POSESIZE				=0x07,
 	/*0x08, <index>. <pos1_L>, <pos1_H> */
@@ -45,8 +66,27 @@ typedef enum {
 	
 	PYPOSE_PLAY_SEQUENCE			=0x0A,
 	PYPOSE_LOOP_SEQUENCE			=0x0B,
+	/*0x0C, <id>, <pose-size>, <pose-count>, <poses>..., <seq-count>, <sequences>...*/
+	PYPOSE_LOAD_LIBRARY				=0x0C,
+	/*0x0D, <id>[, <track>]*/
+	PYPOSE_STOP								=0x0D,
+	/*0x0E, <id>, <track>, <seq>, <loop>, <speed>, <priority>, <mask_L>, <mask_H>*/
+	PYPOSE_PLAY_TRACK					=0x0E,
+	/*0x0F, <id>*/
+	PYPOSE_READ_PLAYER_STATE	=0x0F,
 	PYPOSE_TEST								=0x19,
 #endif
+#ifdef ENABLE_TROSSEN_COMMANDER
+	TROSSEN_COMMANDER									=0x200,
+#endif
+#ifdef ENABLE_GAIT_ENGINE
+	/*0x300, <enable>, <gait_type> */
+	GAIT_CONTROL											=0x300,
+	/*0x301, <vx mm/s>, <vy mm/s>, <vyaw mrad/s> */
+	GAIT_VELOCITY											=0x301,
+	/*0x302, <x mm>, <y mm>, <z mm>, <roll mrad>, <pitch mrad>, <yaw mrad> */
+	GAIT_BODY													=0x302,
+#endif
 } dynamixel_request_t;
 
 #define DESCRIPTION "dyn_zmq - Dynamixel ZeroMQ service"
@@ -64,7 +104,9 @@ typedef enum {
 	ZMQ_ERR_INVALID_PARAMETER_COUNT	= -1003,
 	ZMQ_ERR_INVALID_ID							= -1004,
 	ZMQ_ERR_BUS_OFFLINE							= -1010,
+	ZMQ_ERR_BUS_ERROR								= -1011,
 	ZMQ_ERR_PLAYER_RUNNING					= -1100,
+	ZMQ_ERR_SUBSCRIPTIONS_FULL			= -1200,
 	
 } zmq_error_code_t;
 #endif
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef GAIT_C
+#define GAIT_C
+
+#include <math.h>
+#include "gait.h"
+
+#define GAIT_COMMANDER_SPEED      150.0f	/* mm/s at full stick */
+#define GAIT_COMMANDER_TURN       1.0f		/* rad/s at full stick */
+#define GAIT_COMMANDER_PITCH      0.25f		/* rad at full stick */
+
+/* phase offset per leg, RF, RM, RR, LF, LM, LR */
+static const float gait_phase_offset[GAIT_TYPE_COUNT][GAIT_LEG_COUNT]={
+	{0.0f,     0.5f,     0.0f,     0.5f,     0.0f,     0.5f},		/* tripod */
+	{4/6.0f,   2/6.0f,   0.0f,     1/6.0f,   5/6.0f,   3/6.0f},		/* ripple */
+	{2/6.0f,   1/6.0f,   0.0f,     5/6.0f,   4/6.0f,   3/6.0f},		/* wave */
+};
+/* part of the cycle a leg is in the air */
+static const float gait_swing_fraction[GAIT_TYPE_COUNT]={
+	1/2.0f,
+	1/3.0f,
+	1/6.0f,
+};
+
+void gait_config_default(gait_config_t* config) {
+	/* PhantomX style body */
+	static const float mount_x[GAIT_LEG_COUNT]={ 120.0f,    0.0f, -120.0f,  120.0f,   0.0f, -120.0f};
+	static const float mount_y[GAIT_LEG_COUNT]={ -60.0f, -100.0f,  -60.0f,   60.0f, 100.0f,   60.0f};
+	static const float mount_a[GAIT_LEG_COUNT]={ -45.0f,  -90.0f, -135.0f,   45.0f,  90.0f,  135.0f};
+	static const uint8_t servo_id[GAIT_JOINT_COUNT]={
+		 2,  4,  6,
+		14, 16, 18,
+		 8, 10, 12,
+		 1,  3,  5,
+		13, 15, 17,
+		 7,  9, 11,
+	};
+	float reach;
+
+	config->coxa_length=52.0f;
+	config->femur_length=66.0f;
+	config->tibia_length=132.0f;
+	config->step_height=30.0f;
+	config->max_stride=50.0f;
+	config->cycle_time[GAIT_TRIPOD]=1.0f;
+	config->cycle_time[GAIT_RIPPLE]=1.2f;
+	config->cycle_time[GAIT_WAVE]=1.8f;
+
+	reach=config->coxa_length+config->femur_length;
+	for (uint8_t leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		float a=mount_a[leg]*(float)M_PI/180.0f;
+		config->mount.x[leg]=mount_x[leg];
+		config->mount.y[leg]=mount_y[leg];
+		config->mount.z[leg]=0.0f;
+		config->mount_cos[leg]=cosf(a);
+		config->mount_sin[leg]=sinf(a);
+		config->neutral.x[leg]=mount_x[leg]+reach*cosf(a);
+		config->neutral.y[leg]=mount_y[leg]+reach*sinf(a);
+		config->neutral.z[leg]=-100.0f;
+		for (uint8_t joint=0; joint<3; joint++) {
+			config->servo_id[leg*3+joint]=servo_id[leg*3+joint];
+			/* left side femur and tibia are mirrored */
+			config->servo_sign[leg*3+joint]=((leg>=3) && (joint>0)) ? -1 : 1;
+		}
+	}
+}
+
+void gait_step(gait_ctx_t* gait, const gait_command_t* command, float dt) {
+	const gait_config_t* config=&gait->config;
+	const float* offset=gait_phase_offset[command->type];
+	float swing=gait_swing_fraction[command->type];
+	float cycle=config->cycle_time[command->type];
+	float stance_time=cycle*(1.0f-swing);
+	float dphase=dt/cycle;
+	float vfx[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float vfy[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float p[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	bool moving;
+	uint8_t leg;
+
+	moving=(fabsf(command->vx)>0.5f) || (fabsf(command->vy)>0.5f) || (fabsf(command->vyaw)>0.005f);
+
+	/* foot velocity in body frame, translation plus rotation around the body center */
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		vfx[leg]=command->vx-command->vyaw*config->neutral.y[leg];
+		vfy[leg]=command->vy+command->vyaw*config->neutral.x[leg];
+	}
+
+	if (!moving) {
+		/* hold the cycle once every leg is back on the ground */
+		bool lifted=false;
+		for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+			lifted|=(gait->foot.z[leg]>0.0f);
+		}
+		if (!lifted) {
+			dphase=0.0f;
+		}
+	}
+	gait->phase+=dphase;
+	if (gait->phase>=1.0f) {
+		gait->phase-=1.0f;
+	}
+
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		p[leg]=gait->phase+offset[leg];
+		if (p[leg]>=1.0f) {
+			p[leg]-=1.0f;
+		}
+	}
+
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		if ((dphase>0.0f) && (p[leg]<swing)) {
+			/* swing: close the gap to the touchdown point over the remaining ticks */
+			float remaining=(swing-p[leg])/dphase;
+			float k=(remaining>1.0f) ? 1.0f/remaining : 1.0f;
+			float tx=vfx[leg]*stance_time*0.5f;
+			float ty=vfy[leg]*stance_time*0.5f;
+			gait->foot.x[leg]+=(tx-gait->foot.x[leg])*k;
+			gait->foot.y[leg]+=(ty-gait->foot.y[leg])*k;
+			gait->foot.z[leg]=config->step_height*sinf((float)M_PI*p[leg]/swing);
+		} else {
+			/* stance: the ground moves under the body */
+			gait->foot.x[leg]-=vfx[leg]*dt;
+			gait->foot.y[leg]-=vfy[leg]*dt;
+			gait->foot.z[leg]=0.0f;
+		}
+	}
+
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		float r=sqrtf(gait->foot.x[leg]*gait->foot.x[leg]+gait->foot.y[leg]*gait->foot.y[leg]);
+		if (r>config->max_stride) {
+			gait->foot.x[leg]*=config->max_stride/r;
+			gait->foot.y[leg]*=config->max_stride/r;
+		}
+	}
+}
+
+/*
+ * Each stage runs over all legs before the next one starts so the loops
+ * stay free of cross-lane dependencies and can be vectorized.
+ */
+void gait_solve(const gait_config_t* config, const gait_command_t* command, const gait_vec_t* foot, gait_joints_t* joints) {
+	gait_vec_t body;
+	gait_vec_t leg_pos;
+	float d[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float r[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float F=config->femur_length;
+	float T=config->tibia_length;
+	float d_min=fabsf(F-T)+1.0f;
+	float d_max=F+T-1.0f;
+	uint8_t leg;
+
+	/* body rotation R=Rz(yaw)*Ry(pitch)*Rx(roll), feet are transformed by R^T */
+	float cr=cosf(command->body_roll),		sr=sinf(command->body_roll);
+	float cp=cosf(command->body_pitch),		sp=sinf(command->body_pitch);
+	float cy=cosf(command->body_yaw),			sy=sinf(command->body_yaw);
+	float r00=cy*cp,	r01=cy*sp*sr-sy*cr,		r02=cy*sp*cr+sy*sr;
+	float r10=sy*cp,	r11=sy*sp*sr+cy*cr,		r12=sy*sp*cr-cy*sr;
+	float r20=-sp,		r21=cp*sr,						r22=cp*cr;
+
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		float px=config->neutral.x[leg]+foot->x[leg]-command->body_x;
+		float py=config->neutral.y[leg]+foot->y[leg]-command->body_y;
+		float pz=config->neutral.z[leg]+foot->z[leg]-command->body_z;
+		body.x[leg]=r00*px+r10*py+r20*pz;
+		body.y[leg]=r01*px+r11*py+r21*pz;
+		body.z[leg]=r02*px+r12*py+r22*pz;
+	}
+
+	/* into the leg frame, x pointing away from the coxa */
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		float dx=body.x[leg]-config->mount.x[leg];
+		float dy=body.y[leg]-config->mount.y[leg];
+		leg_pos.x[leg]= config->mount_cos[leg]*dx+config->mount_sin[leg]*dy;
+		leg_pos.y[leg]=-config->mount_sin[leg]*dx+config->mount_cos[leg]*dy;
+		leg_pos.z[leg]=body.z[leg];
+	}
+
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		r[leg]=sqrtf(leg_pos.x[leg]*leg_pos.x[leg]+leg_pos.y[leg]*leg_pos.y[leg])-config->coxa_length;
+		d[leg]=sqrtf(r[leg]*r[leg]+leg_pos.z[leg]*leg_pos.z[leg]);
+		d[leg]=fminf(fmaxf(d[leg], d_min), d_max);
+	}
+
+	for (leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		float d2=d[leg]*d[leg];
+		joints->coxa[leg]=atan2f(leg_pos.y[leg], leg_pos.x[leg]);
+		joints->femur[leg]=atan2f(leg_pos.z[leg], r[leg])+acosf((F*F+d2-T*T)/(2.0f*F*d[leg]));
+		joints->tibia[leg]=acosf((F*F+T*T-d2)/(2.0f*F*T))-(float)M_PI/2.0f;
+	}
+}
+
+/* fills <id>,<ticks> pairs for dynamixel_sync_write_words, returns the id count */
+uint8_t gait_pack_ticks(const gait_config_t* config, const gait_joints_t* joints, const calibration_t* calibration, uint16_t* data) {
+	const float* angle[3]={joints->coxa, joints->femur, joints->tibia};
+	float rad[GAIT_JOINT_COUNT] GAIT_ALIGNED;
+	uint16_t ticks[GAIT_JOINT_COUNT];
+
+	for (uint8_t leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		for (uint8_t joint=0; joint<3; joint++) {
+			rad[leg*3+joint]=config->servo_sign[leg*3+joint]*angle[joint][leg];
+		}
+	}
+	calibration_rad_to_ticks(calibration, config->servo_id, rad, ticks, GAIT_JOINT_COUNT);
+	for (uint8_t idx=0; idx<GAIT_JOINT_COUNT; idx++) {
+		data[idx*2]=config->servo_id[idx];
+		data[idx*2+1]=ticks[idx];
+	}
+	return GAIT_JOINT_COUNT;
+}
+
+void *gait_thread(void* arg) {
+	gait_ctx_t* gait=(gait_ctx_t*)arg;
+	gait_command_t command;
+	struct timespec next;
+	struct timespec now;
+	long period_ns=1000000000L/gait->rate;
+	float dt=1.0f/gait->rate;
+	uint8_t id_count;
+	int16_t dynamixel_ret;
+	bool running=false;
+
+	while (true) {
+		pthread_mutex_lock(&gait->lock);
+		while (!gait->command.enabled) {
+			running=false;
+			if (gait->debug) {
+				std::cout << "Gait stopped..." << std::endl;
+			}
+			pthread_cond_wait(&gait->cond, &gait->lock);
+		}
+		command=gait->command;
+		pthread_mutex_unlock(&gait->lock);
+
+		if (!running) {
+			clock_gettime(CLOCK_MONOTONIC, &next);
+			running=true;
+		}
+
+		gait_step(gait, &command, dt);
+		gait_solve(&gait->config, &command, &gait->foot, &gait->joints);
+		id_count=gait_pack_ticks(&gait->config, &gait->joints, gait->calibration, gait->ticks);
+
+		dynamixel_ret=dynamixel_bus_sync_write_words(
+			gait->bus,
+			DYNAMIXEL_R_GOAL_POSITION_L,		/*register*/
+			id_count,												/*id-count*/
+			1,															/*word_count*/
+			gait->ticks,
+			true
+		);
+		if ((dynamixel_ret<0) && (gait->debug)) {
+			std::cout << "Gait write failed: " << dynamixel_ret << std::endl;
+		}
+
+		next.tv_nsec+=period_ns;
+		if (next.tv_nsec>=1000000000L) {
+			next.tv_nsec-=1000000000L;
+			next.tv_sec++;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec>next.tv_sec) || ((now.tv_sec==next.tv_sec) && (now.tv_nsec>next.tv_nsec))) {
+			/* overrun, don't try to catch up */
+			if (gait->debug) {
+				std::cout << "Gait tick overrun" << std::endl;
+			}
+			next=now;
+		} else {
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+	return NULL;
+}
+
+void gait_init(gait_ctx_t* gait, dynamixel_bus_t* bus, const calibration_t* calibration, uint16_t rate) {
+	gait->bus=bus;
+	gait->calibration=calibration;
+	if (rate<GAIT_MIN_RATE) {
+		rate=GAIT_MIN_RATE;
+	} else if (rate>GAIT_MAX_RATE) {
+		rate=GAIT_MAX_RATE;
+	}
+	gait->rate=rate;
+	gait->phase=0.0f;
+	memset(&gait->foot, 0, sizeof(gait->foot));
+	memset(&gait->command, 0, sizeof(gait->command));
+	gait->command.type=GAIT_TRIPOD;
+	gait->command.enabled=false;
+	gait_config_default(&gait->config);
+
+	pthread_mutex_init(&gait->lock, NULL);
+	pthread_cond_init(&gait->cond, NULL);
+
+	pthread_create(&gait->thread, NULL, &gait_thread, (void*)gait);
+}
+
+void gait_set_enabled(gait_ctx_t* gait, bool enabled, gait_type_t type) {
+	pthread_mutex_lock(&gait->lock);
+	gait->command.enabled=enabled;
+	gait->command.type=type;
+	pthread_cond_signal(&gait->cond);
+	pthread_mutex_unlock(&gait->lock);
+}
+
+void gait_set_velocity(gait_ctx_t* gait, float vx, float vy, float vyaw) {
+	pthread_mutex_lock(&gait->lock);
+	gait->command.vx=vx;
+	gait->command.vy=vy;
+	gait->command.vyaw=vyaw;
+	pthread_mutex_unlock(&gait->lock);
+}
+
+void gait_set_body(gait_ctx_t* gait, float x, float y, float z, float roll, float pitch, float yaw) {
+	pthread_mutex_lock(&gait->lock);
+	gait->command.body_x=x;
+	gait->command.body_y=y;
+	gait->command.body_z=z;
+	gait->command.body_roll=roll;
+	gait->command.body_pitch=pitch;
+	gait->command.body_yaw=yaw;
+	pthread_mutex_unlock(&gait->lock);
+}
+
+#ifdef ENABLE_TROSSEN_COMMANDER
+static inline float gait_stick(int16_t value) {
+	float v=value/127.0f;
+	return fminf(fmaxf(v, -1.0f), 1.0f);
+}
+
+/* left stick walks/strafes, right stick turns and pitches the body */
+void gait_set_commander(gait_ctx_t* gait, trossen_cmd_t* command) {
+	pthread_mutex_lock(&gait->lock);
+	gait->command.vx=gait_stick(command->left_V)*GAIT_COMMANDER_SPEED;
+	gait->command.vy=-gait_stick(command->left_H)*GAIT_COMMANDER_SPEED;
+	gait->command.vyaw=-gait_stick(command->right_H)*GAIT_COMMANDER_TURN;
+	gait->command.body_pitch=gait_stick(command->right_V)*GAIT_COMMANDER_PITCH;
+	if (command->buttons&GAIT_BUTTON_TRIPOD) {
+		gait->command.type=GAIT_TRIPOD;
+	} else if (command->buttons&GAIT_BUTTON_RIPPLE) {
+		gait->command.type=GAIT_RIPPLE;
+	} else if (command->buttons&GAIT_BUTTON_WAVE) {
+		gait->command.type=GAIT_WAVE;
+	}
+	pthread_mutex_unlock(&gait->lock);
+}
+#endif
+
+#endif
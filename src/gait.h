@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef GAIT_H
+#define GAIT_H
+
+/*
+ * Hexapod gait generator and leg IK (NUKE style).
+ * body frame: x forward, y left, z up, lengths in mm, angles in rad
+ * legs:       0=RF, 1=RM, 2=RR, 3=LF, 4=LM, 5=LR
+ * joints:     coxa=0 leg points away from the body, servo offsets come from
+ *             the calibration
+ *             femur=0 horizontal, positive is up
+ *             tibia=0 perpendicular to the femur, positive opens the knee
+ */
+#include <pthread.h>
+#include <time.h>
+
+#define GAIT_LEG_COUNT           6
+#define GAIT_JOINT_COUNT         (GAIT_LEG_COUNT*3)
+#define GAIT_MIN_RATE            100
+#define GAIT_MAX_RATE            200
+
+/* trossen commander buttons */
+#define GAIT_BUTTON_TRIPOD       0x01
+#define GAIT_BUTTON_RIPPLE       0x02
+#define GAIT_BUTTON_WAVE         0x04
+
+#define GAIT_ALIGNED             __attribute__((aligned(32)))
+
+typedef enum {
+	GAIT_TRIPOD,
+	GAIT_RIPPLE,
+	GAIT_WAVE,
+	GAIT_TYPE_COUNT,
+} gait_type_t;
+
+/* one lane per leg */
+typedef struct {
+	float x[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float y[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float z[GAIT_LEG_COUNT] GAIT_ALIGNED;
+} gait_vec_t;
+
+typedef struct {
+	float coxa[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float femur[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float tibia[GAIT_LEG_COUNT] GAIT_ALIGNED;
+} gait_joints_t;
+
+typedef struct {
+	float											coxa_length;
+	float											femur_length;
+	float											tibia_length;
+	gait_vec_t								mount;					/* coxa axis in body frame, z unused */
+	float											mount_cos[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	float											mount_sin[GAIT_LEG_COUNT] GAIT_ALIGNED;
+	gait_vec_t								neutral;				/* foot positions in body frame */
+	float											step_height;
+	float											max_stride;			/* radius around the neutral position */
+	float											cycle_time[GAIT_TYPE_COUNT];
+	/* servo ids and directions, [leg*3+joint] joint: 0=coxa, 1=femur, 2=tibia */
+	uint8_t										servo_id[GAIT_JOINT_COUNT];
+	int8_t										servo_sign[GAIT_JOINT_COUNT];
+} gait_config_t;
+
+typedef struct {
+	float											vx;							/* mm/s */
+	float											vy;							/* mm/s */
+	float											vyaw;						/* rad/s */
+	float											body_x;					/* mm */
+	float											body_y;
+	float											body_z;
+	float											body_roll;
+	float											body_pitch;
+	float											body_yaw;
+	gait_type_t								type;
+	bool											enabled;
+} gait_command_t;
+
+typedef struct {
+	bool											debug;
+	dynamixel_bus_t*					bus;
+	const calibration_t*			calibration;
+	gait_config_t							config;
+	uint16_t									rate;
+
+	/* written by the zmq thread, protected by lock */
+	gait_command_t						command;
+	pthread_mutex_t						lock;
+	pthread_cond_t						cond;
+
+	/* gait thread only */
+	float											phase;
+	gait_vec_t								foot;						/* offset from neutral, z absolute lift */
+	gait_joints_t							joints;
+	uint16_t									ticks[GAIT_JOINT_COUNT*2];
+	pthread_t									thread;
+} gait_ctx_t;
+
+void gait_config_default(gait_config_t* config);
+void gait_init(gait_ctx_t* gait, dynamixel_bus_t* bus, const calibration_t* calibration, uint16_t rate);
+void gait_set_enabled(gait_ctx_t* gait, bool enabled, gait_type_t type);
+void gait_set_velocity(gait_ctx_t* gait, float vx, float vy, float vyaw);
+void gait_set_body(gait_ctx_t* gait, float x, float y, float z, float roll, float pitch, float yaw);
+#ifdef ENABLE_TROSSEN_COMMANDER
+void gait_set_commander(gait_ctx_t* gait, trossen_cmd_t* command);
+#endif
+
+/* one gait step and leg solve, exposed for offline use */
+void gait_step(gait_ctx_t* gait, const gait_command_t* command, float dt);
+void gait_solve(const gait_config_t* config, const gait_command_t* command, const gait_vec_t* foot, gait_joints_t* joints);
+uint8_t gait_pack_ticks(const gait_config_t* config, const gait_joints_t* joints, const calibration_t* calibration, uint16_t* data);
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef GAIT_COMMANDS_C
+#define GAIT_COMMANDS_C
+
+#include "command.h"
+
+static int16_t command_gait_control(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<enable>,<gait_type>
+	gait_set_enabled(ctx->gait, rx_vect[1]!=0, (gait_type_t)rx_vect[2]);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(ctx->gait->rate);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_gait_control_def={
+	GAIT_CONTROL, "gait_control", command_gait_control, COMMAND_NEEDS_BUS,
+	2, 2, COMMAND_ANY,
+	2, {COMMAND_ANY, COMMAND_VALUE(0, GAIT_TYPE_COUNT-1)}
+};
+COMMAND_REGISTER(command_gait_control_def)
+
+static int16_t command_gait_velocity(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<vx mm/s>,<vy mm/s>,<vyaw mrad/s>
+	gait_set_velocity(ctx->gait, rx_vect[1], rx_vect[2], rx_vect[3]/1000.0f);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_gait_velocity_def={
+	GAIT_VELOCITY, "gait_velocity", command_gait_velocity, 0,
+	3, 3, COMMAND_ANY,
+	0, {}
+};
+COMMAND_REGISTER(command_gait_velocity_def)
+
+static int16_t command_gait_body(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<x mm>,<y mm>,<z mm>,<roll mrad>,<pitch mrad>,<yaw mrad>
+	gait_set_body(
+		ctx->gait,
+		rx_vect[1],
+		rx_vect[2],
+		rx_vect[3],
+		rx_vect[4]/1000.0f,
+		rx_vect[5]/1000.0f,
+		rx_vect[6]/1000.0f
+	);
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_gait_body_def={
+	GAIT_BODY, "gait_body", command_gait_body, 0,
+	6, 6, COMMAND_ANY,
+	0, {}
+};
+COMMAND_REGISTER(command_gait_body_def)
+
+#endif
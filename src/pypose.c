@@ -18,28 +18,283 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #ifndef PYPOSE_C
+#define PYPOSE_C
 
 #include "pypose.h"
 
-pypose_pose_t* pyPose_Poses[PYPOSE_MAX_POSE_COUNT];
-
-pypose_sequence_t* pyPose_Sequences[PYPOSE_MAX_SEQUENCE_COUNT];
+pypose_library_t* pyPose_Library=NULL;
+pthread_mutex_t pyPose_Library_lock=PTHREAD_MUTEX_INITIALIZER;
 
 uint8_t pyPose_PoseSize=0;
 
 
-void pypose_pose_init(void) {
-	uint16_t _pose_idx;
-	for (_pose_idx=0; _pose_idx<PYPOSE_MAX_POSE_COUNT; _pose_idx++) {
-		pyPose_Poses[_pose_idx]=NULL;
+void pypose_pose_compile(pypose_pose_t* pose) {
+	uint8_t* p=pose->packet;
+	uint8_t checksum=0;
+
+	pose->packet_len=0;
+	if ((pose->values==NULL) || (pose->len==0)) {
+		return;
+	}
+	*p++=0xFF;
+	*p++=0xFF;
+	*p++=DYNAMIXEL_SERIAL_BROADCAST_ID;
+	*p++=pose->len*3+4;
+	*p++=DYNAMIXEL_SERIAL_SYNC_WRITE;
+	*p++=DYNAMIXEL_R_GOAL_POSITION_L;
+	*p++=2;
+	for (uint8_t i=0; i<pose->len; i++) {
+		*p++=i+1;
+		*p++=pose->values[i]&0xFF;
+		*p++=pose->values[i]>>8;
+	}
+	for (uint8_t* c=pose->packet+2; c<p; c++) {
+		checksum+=*c;
+	}
+	*p++=~checksum;
+	pose->packet_len=p-pose->packet;
+}
+
+pypose_library_t* pypose_library_new(void) {
+	pypose_library_t* library=(pypose_library_t*)malloc(sizeof(pypose_library_t));
+	uint16_t _idx;
+	for (_idx=0; _idx<PYPOSE_MAX_POSE_COUNT; _idx++) {
+		library->poses[_idx]=NULL;
+	}
+	for (_idx=0; _idx<PYPOSE_MAX_SEQUENCE_COUNT; _idx++) {
+		library->sequences[_idx]=NULL;
+	}
+	library->refs=1;
+	return library;
+}
+
+/* a pose of len servos, its values still to be filled in and compiled */
+pypose_pose_t* pypose_pose_new(uint8_t len) {
+	pypose_pose_t* pose=(pypose_pose_t*)malloc(sizeof(pypose_pose_t));
+	pose->len=len;
+	pose->values=(uint16_t*)malloc(sizeof(uint16_t)*len);
+	pose->packet_len=0;
+	pose->refs=1;
+	return pose;
+}
+
+/* a library may be freed by the player thread while another one is cloned */
+void pypose_pose_release(pypose_pose_t* pose) {
+	if (__atomic_sub_fetch(&pose->refs, 1, __ATOMIC_ACQ_REL)==0) {
+		free(pose->values);
+		free(pose);
+	}
+}
+
+pypose_sequence_t* pypose_sequence_new(uint8_t len) {
+	pypose_sequence_t* seq=(pypose_sequence_t*)malloc(sizeof(pypose_sequence_t));
+	seq->len=len;
+	seq->parts=(pypose_seq_part_t*)malloc(sizeof(pypose_seq_part_t)*len);
+	seq->refs=1;
+	return seq;
+}
+
+void pypose_sequence_release(pypose_sequence_t* seq) {
+	if (__atomic_sub_fetch(&seq->refs, 1, __ATOMIC_ACQ_REL)==0) {
+		free(seq->parts);
+		free(seq);
+	}
+}
+
+/*
+ * copy with its own reference, for single pose or sequence uploads: they
+ * replace one slot of the copy and swap it in, a published library is
+ * never written to. Poses and sequences are shared, the caller holds a
+ * reference to the library so none of them can go away meanwhile.
+ */
+pypose_library_t* pypose_library_clone(const pypose_library_t* library) {
+	pypose_library_t* clone=pypose_library_new();
+	uint16_t _idx;
+	for (_idx=0; _idx<PYPOSE_MAX_POSE_COUNT; _idx++) {
+		pypose_pose_t* pose=library->poses[_idx];
+		if (pose) {
+			__atomic_add_fetch(&pose->refs, 1, __ATOMIC_RELAXED);
+			clone->poses[_idx]=pose;
+		}
+	}
+	for (_idx=0; _idx<PYPOSE_MAX_SEQUENCE_COUNT; _idx++) {
+		pypose_sequence_t* seq=library->sequences[_idx];
+		if (seq) {
+			__atomic_add_fetch(&seq->refs, 1, __ATOMIC_RELAXED);
+			clone->sequences[_idx]=seq;
+		}
+	}
+	return clone;
+}
+
+void pypose_library_free(pypose_library_t* library) {
+	uint16_t _idx;
+	for (_idx=0; _idx<PYPOSE_MAX_POSE_COUNT; _idx++) {
+		if (library->poses[_idx]) {
+			pypose_pose_release(library->poses[_idx]);
+		}
+	}
+	for (_idx=0; _idx<PYPOSE_MAX_SEQUENCE_COUNT; _idx++) {
+		if (library->sequences[_idx]) {
+			pypose_sequence_release(library->sequences[_idx]);
+		}
+	}
+	free(library);
+}
+
+void pypose_library_init(void) {
+	pyPose_Library=pypose_library_new();
+}
+
+pypose_library_t* pypose_library_acquire(void) {
+	pypose_library_t* library;
+	pthread_mutex_lock(&pyPose_Library_lock);
+	library=pyPose_Library;
+	library->refs++;
+	pthread_mutex_unlock(&pyPose_Library_lock);
+	return library;
+}
+
+/* another reference to a library the caller already holds */
+void pypose_library_hold(pypose_library_t* library) {
+	pthread_mutex_lock(&pyPose_Library_lock);
+	library->refs++;
+	pthread_mutex_unlock(&pyPose_Library_lock);
+}
+
+void pypose_library_release(pypose_library_t* library) {
+	bool unused;
+	pthread_mutex_lock(&pyPose_Library_lock);
+	unused=(--library->refs==0);
+	pthread_mutex_unlock(&pyPose_Library_lock);
+	if (unused) {
+		pypose_library_free(library);
 	}
 }
 
-void pypose_seq_init(void) {
-	uint16_t _seq_idx;
-	for (_seq_idx=0; _seq_idx<PYPOSE_MAX_SEQUENCE_COUNT; _seq_idx++) {
-		pyPose_Sequences[_seq_idx]=NULL;
+void pypose_library_swap(pypose_library_t* library) {
+	pypose_library_t* old;
+	pthread_mutex_lock(&pyPose_Library_lock);
+	old=pyPose_Library;
+	pyPose_Library=library;
+	pthread_mutex_unlock(&pyPose_Library_lock);
+	pypose_library_release(old);
+}
+
+/*
+ * bulk upload, starting at rx_vect[offset]:
+ *   <pose_size>,<pose_count>,
+ *     <pose_idx>,<pos1>,...,<pos_n>               (pose_count times)
+ *   <seq_count>,
+ *     <seq_idx>,<part_count>,<pose_id>,<delay>,... (seq_count times)
+ * positions and delays are whole words, a delay is unsigned (up to 65535ms
+ * as with LOAD_SEQUENCE) and arrives as a negative int16 above 32767. The
+ * complete message is checked before anything is allocated, sequences may
+ * only use poses of the upload.
+ */
+int16_t pypose_library_parse(const std::vector<int16_t>& rx_vect, size_t offset, uint8_t* pose_size, pypose_library_t** library) {
+	bool pose_defined[PYPOSE_MAX_POSE_COUNT];
+	size_t pos=offset;
+	int16_t size;
+	int16_t pose_count;
+	int16_t seq_count;
+	pypose_library_t* new_library;
+
+	/* first pass: validate */
+	if (rx_vect.size()<pos+3) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	size=rx_vect.at(pos++);
+	pose_count=rx_vect.at(pos++);
+	if ((size<=0) || (size>PYPOSE_MAX_POSE_SIZE) || (pose_count<0) || (pose_count>PYPOSE_MAX_POSE_COUNT)) {
+		return ZMQ_ERR_INVALID_PARAMETERS;
+	}
+	memset(pose_defined, 0, sizeof(pose_defined));
+	for (int16_t p=0; p<pose_count; p++) {
+		if (rx_vect.size()<pos+1+size) {
+			return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+		}
+		if ((rx_vect.at(pos)<0) || (rx_vect.at(pos)>=PYPOSE_MAX_POSE_COUNT)) {
+			return ZMQ_ERR_INVALID_PARAMETERS;
+		}
+		pose_defined[rx_vect.at(pos)]=true;
+		for (int16_t i=0; i<size; i++) {
+			if (rx_vect.at(pos+1+i)<0) {
+				return ZMQ_ERR_INVALID_PARAMETERS;
+			}
+		}
+		pos+=1+size;
+	}
+	if (rx_vect.size()<pos+1) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	seq_count=rx_vect.at(pos++);
+	if ((seq_count<0) || (seq_count>PYPOSE_MAX_SEQUENCE_COUNT)) {
+		return ZMQ_ERR_INVALID_PARAMETERS;
 	}
+	for (int16_t s=0; s<seq_count; s++) {
+		int16_t part_count;
+		if (rx_vect.size()<pos+2) {
+			return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+		}
+		part_count=rx_vect.at(pos+1);
+		if ((rx_vect.at(pos)<0) || (rx_vect.at(pos)>=PYPOSE_MAX_SEQUENCE_COUNT) || (part_count<=0) || (part_count>255)) {
+			return ZMQ_ERR_INVALID_PARAMETERS;
+		}
+		pos+=2;
+		if (rx_vect.size()<pos+2*part_count) {
+			return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+		}
+		for (int16_t i=0; i<part_count; i++) {
+			int16_t pose_id=rx_vect.at(pos+2*i);
+			if ((pose_id<0) || (pose_id>=PYPOSE_MAX_POSE_COUNT) || (!pose_defined[pose_id])) {
+				return ZMQ_ERR_INVALID_PARAMETERS;
+			}
+		}
+		pos+=2*part_count;
+	}
+	if (pos!=rx_vect.size()) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+
+	/* second pass: build */
+	new_library=pypose_library_new();
+	pos=offset+2;
+	for (int16_t p=0; p<pose_count; p++) {
+		uint8_t pose_idx=rx_vect.at(pos);
+		pypose_pose_t* pose=new_library->poses[pose_idx];
+		if (!pose) {
+			pose=pypose_pose_new(size);
+			new_library->poses[pose_idx]=pose;
+		}
+		for (int16_t i=0; i<size; i++) {
+			pose->values[i]=rx_vect.at(pos+1+i);
+		}
+		pypose_pose_compile(pose);
+		pos+=1+size;
+	}
+	pos++;
+	for (int16_t s=0; s<seq_count; s++) {
+		uint8_t seq_idx=rx_vect.at(pos);
+		uint8_t part_count=rx_vect.at(pos+1);
+		pypose_sequence_t* seq=new_library->sequences[seq_idx];
+		if (seq) {
+			/* same index twice, last one wins */
+			pypose_sequence_release(seq);
+		}
+		seq=pypose_sequence_new(part_count);
+		new_library->sequences[seq_idx]=seq;
+		pos+=2;
+		for (uint8_t i=0; i<part_count; i++) {
+			seq->parts[i].pose_id=rx_vect.at(pos+2*i);
+			seq->parts[i].delay=(uint16_t)rx_vect.at(pos+2*i+1);
+		}
+		pos+=2*part_count;
+	}
+
+	*pose_size=size;
+	*library=new_library;
+	return ZMQ_ERR_NO_ERROR;
 }
 
-#endif
\ No newline at end of file
+#endif
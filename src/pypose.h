@@ -18,16 +18,28 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #ifndef PYPOSE_H
+#define PYPOSE_H
 
 
 #define PYPOSE_ID                 253
-#define PYPOSE_MAX_POSE_SIZE       32
+#define PYPOSE_MAX_POSE_SIZE       32			/* servos per pose, inclusive */
 #define PYPOSE_MAX_POSE_COUNT     255
 #define PYPOSE_MAX_SEQUENCE_COUNT 255
+#define PYPOSE_PACKET_SIZE        (8+3*PYPOSE_MAX_POSE_SIZE)
 
+/*
+ * packet is the pose compiled into a SYNC_WRITE of the goal positions of
+ * ids 1..len, ready for the wire including the checksum. It is built by
+ * pypose_pose_compile() before the pose is published in a library and not
+ * touched afterwards, packet_len is 0 for an empty pose. refs counts the
+ * libraries sharing the pose.
+ */
 typedef struct {
 	uint8_t len;
 	uint16_t *values;
+	uint8_t packet_len;
+	uint8_t packet[PYPOSE_PACKET_SIZE];
+	uint32_t refs;
 } pypose_pose_t;
 
 typedef struct {
@@ -38,9 +50,36 @@ typedef struct {
 typedef struct {
 	uint8_t len;
 	pypose_seq_part_t* parts;
+	uint32_t refs;
 } pypose_sequence_t;
 
-void pypose_pose_init(void);
-void pypose_seq_init(void);
+/*
+ * Poses and sequences live in a library. The player holds a reference while
+ * it plays a pass, so a bulk upload can swap in a complete new library at any
+ * time and the old one is freed once the last pass using it ends. A library
+ * is never changed once it is swapped in, single pose or sequence uploads
+ * swap in a changed copy (pypose_library_clone). The copy shares all poses
+ * and sequences with the original, only the replaced slot is new.
+ */
+typedef struct {
+	pypose_pose_t*			poses[PYPOSE_MAX_POSE_COUNT];
+	pypose_sequence_t*	sequences[PYPOSE_MAX_SEQUENCE_COUNT];
+	uint32_t						refs;
+} pypose_library_t;
+
+void pypose_pose_compile(pypose_pose_t* pose);
+pypose_pose_t* pypose_pose_new(uint8_t len);
+void pypose_pose_release(pypose_pose_t* pose);
+pypose_sequence_t* pypose_sequence_new(uint8_t len);
+void pypose_sequence_release(pypose_sequence_t* seq);
+void pypose_library_init(void);
+pypose_library_t* pypose_library_new(void);
+pypose_library_t* pypose_library_clone(const pypose_library_t* library);
+void pypose_library_free(pypose_library_t* library);
+pypose_library_t* pypose_library_acquire(void);
+void pypose_library_hold(pypose_library_t* library);
+void pypose_library_release(pypose_library_t* library);
+void pypose_library_swap(pypose_library_t* library);
+int16_t pypose_library_parse(const std::vector<int16_t>& rx_vect, size_t offset, uint8_t* pose_size, pypose_library_t** library);
 
 #endif
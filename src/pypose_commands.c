@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef PYPOSE_COMMANDS_C
+#define PYPOSE_COMMANDS_C
+
+/* all pypose commands carry PYPOSE_ID as their first argument */
+#include "command.h"
+
+#define COMMAND_PYPOSE_ID           COMMAND_ID(PYPOSE_ID, PYPOSE_ID)
+
+static int16_t command_pypose_set_posesize(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<size>
+	pyPose_PoseSize=(uint8_t)rx_vect[2];
+	if (ctx->debug) {
+		std::cout << "New pose size received: "<< (int)pyPose_PoseSize << std::endl;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(pyPose_PoseSize);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_set_posesize_def={
+	PYPOSE_SET_POSESIZE, "pypose_set_posesize", command_pypose_set_posesize, 0,
+	2, 2, COMMAND_ANY,
+	2, {COMMAND_PYPOSE_ID, COMMAND_VALUE(0, PYPOSE_MAX_POSE_SIZE)}
+};
+COMMAND_REGISTER(command_pypose_set_posesize_def)
+
+static int16_t command_pypose_load_pose(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<index>,<pos1_L>, <pos1_H>
+	uint8_t pose_idx=rx_vect[2];
+	pypose_library_t* library;
+	pypose_library_t* update;
+	pypose_pose_t* cPose;
+
+	cPose=pypose_pose_new(pyPose_PoseSize);
+	for (uint8_t i=0;i<pyPose_PoseSize;i++) {
+		cPose->values[i]=rx_vect[3+i*2]|(rx_vect[4+i*2]<<8);
+	}
+	pypose_pose_compile(cPose);
+	//the player may still be sending the old pose, replace it in a copy
+	library=pypose_library_acquire();
+	update=pypose_library_clone(library);
+	pypose_library_release(library);
+	if (update->poses[pose_idx]) {
+		pypose_pose_release(update->poses[pose_idx]);
+	}
+	update->poses[pose_idx]=cPose;
+	pypose_library_swap(update);
+	if (ctx->debug) {
+		std::cout << "New pose received." << std::endl;
+		std::cout << "  * length: "<< (int)pyPose_PoseSize  << std::endl;
+		std::cout << "  * id    : "<< (int)pose_idx  << std::endl;
+		std::cout << "  * data  : "<<  std::endl;
+		std::cout << "          : ";
+		for (uint8_t i=0;i<pyPose_PoseSize;i++) {
+			std::cout << cPose->values[i] << ",";
+		}
+		std::cout <<  std::endl;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(pose_idx);
+	tx_vect.push_back(pyPose_PoseSize);
+	return ZMQ_ERR_NO_ERROR;
+}
+/* two bytes for each servo of the current pose size */
+static int16_t command_pypose_load_pose_validate(const std::vector<int16_t>& rx_vect) {
+	if (rx_vect.size()!=(size_t)(pyPose_PoseSize*2+3)) {
+		return ZMQ_ERR_INVALID_PARAMETERS;
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_load_pose_def={
+	PYPOSE_LOAD_POSE, "pypose_load_pose", command_pypose_load_pose, 0,
+	2, 2+PYPOSE_MAX_POSE_SIZE*2, COMMAND_BYTE,
+	2, {COMMAND_PYPOSE_ID, COMMAND_VALUE(0, PYPOSE_MAX_POSE_COUNT-1)},
+	command_pypose_load_pose_validate
+};
+COMMAND_REGISTER(command_pypose_load_pose_def)
+
+static int16_t command_pypose_load_sequence(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<pose_id>,<delay_L>,<delay_H>,<???>,<???>,<???>
+	uint8_t no_elements=(rx_vect.size()-2)/3;
+	uint8_t seq_idx=0;
+	pypose_library_t* library;
+	pypose_library_t* update;
+	pypose_sequence_t* cSeq;
+
+	cSeq=pypose_sequence_new(no_elements);
+	for (uint8_t i=0;i<no_elements;i++) {
+		cSeq->parts[i].pose_id = rx_vect[2+3*i];
+		cSeq->parts[i].delay = rx_vect[3+3*i]|(rx_vect[4+3*i]<<8);
+	}
+	//tracks keep playing the sequence of the library they started with
+	library=pypose_library_acquire();
+	update=pypose_library_clone(library);
+	pypose_library_release(library);
+	if (update->sequences[seq_idx]) {
+		pypose_sequence_release(update->sequences[seq_idx]);
+	}
+	update->sequences[seq_idx]=cSeq;
+	pypose_library_swap(update);
+	if (ctx->debug) {
+		std::cout << "New sequence received." << std::endl;
+		std::cout << "  * length: "<< (int)no_elements  << std::endl;
+		std::cout << "  * id    : "<< (int)seq_idx  << std::endl;
+		std::cout << "  * data  : "<<  std::endl;
+		std::cout << "          : ";
+		for (uint8_t i=0;i<no_elements;i++) {
+			std::cout << (int)(cSeq->parts[i].pose_id) << ":" << (int)(cSeq->parts[i].delay) << " | ";
+		}
+		std::cout <<  std::endl;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(seq_idx);
+	tx_vect.push_back(no_elements);
+	return ZMQ_ERR_NO_ERROR;
+}
+/* parts of pose id and delay bytes, the pose ids in range */
+static int16_t command_pypose_load_sequence_validate(const std::vector<int16_t>& rx_vect) {
+	if ((rx_vect.size()-2)%3) {
+		return ZMQ_ERR_INVALID_PARAMETER_COUNT;
+	}
+	for (size_t i=2; i<rx_vect.size(); i+=3) {
+		if (rx_vect[i]>=PYPOSE_MAX_POSE_COUNT) {
+			return ZMQ_ERR_INVALID_PARAMETERS;
+		}
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_load_sequence_def={
+	PYPOSE_LOAD_SEQUENCE, "pypose_load_sequence", command_pypose_load_sequence, 0,
+	4, 1+255*3, COMMAND_BYTE,
+	1, {COMMAND_PYPOSE_ID},
+	command_pypose_load_sequence_validate
+};
+COMMAND_REGISTER(command_pypose_load_sequence_def)
+
+static int16_t command_pypose_load_library(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<pose_size>,<pose_count>,[<pose_idx>,<pos1>..<posN>]*,<seq_count>,[<seq_idx>,<part_count>,[<pose_id>,<delay>]*]*
+	pypose_library_t* pose_library;
+	struct timespec t_start;
+	struct timespec t_end;
+	uint8_t pose_size;
+	uint16_t seq_count_pos;
+	int16_t ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	ret=pypose_library_parse(rx_vect, 2, &pose_size, &pose_library);
+	if (ret) {
+		return ret;
+	}
+	pypose_library_swap(pose_library);
+	pyPose_PoseSize=pose_size;
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	seq_count_pos=4+rx_vect[3]*(1+pose_size);
+	if (ctx->debug) {
+		std::cout << "New pose library received." << std::endl;
+		std::cout << "  * poses    : "<< rx_vect[3] << std::endl;
+		std::cout << "  * sequences: "<< rx_vect[seq_count_pos] << std::endl;
+		std::cout << "  * load time: "
+			<< ((t_end.tv_sec-t_start.tv_sec)*1000000000L+(t_end.tv_nsec-t_start.tv_nsec))/1000 << "us" << std::endl;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(rx_vect[3]);
+	tx_vect.push_back(rx_vect[seq_count_pos]);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_load_library_def={
+	PYPOSE_LOAD_LIBRARY, "pypose_load_library", command_pypose_load_library, 0,
+	4, COMMAND_ARGS_ANY, COMMAND_ANY,
+	1, {COMMAND_PYPOSE_ID}
+};
+COMMAND_REGISTER(command_pypose_load_library_def)
+
+static int16_t command_pypose_play(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>[,<seq_idx>]
+	int16_t ret=pypose_player_start(
+		ctx->player,
+		0,																				/*track*/
+		(rx_vect.size()>2) ? rx_vect[2] : 0,			/*sequence*/
+		rx_vect[0]==PYPOSE_LOOP_SEQUENCE,
+		PYPOSE_PLAYER_SPEED_NORMAL,
+		0,																				/*priority*/
+		PYPOSE_PLAYER_ALL_SERVOS
+	);
+	if (ret) {
+		return ret;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_play_def={
+	PYPOSE_PLAY_SEQUENCE, "pypose_play", command_pypose_play, 0,
+	1, 2, COMMAND_ANY,
+	2, {COMMAND_PYPOSE_ID, COMMAND_VALUE(0, PYPOSE_MAX_SEQUENCE_COUNT-1)}
+};
+COMMAND_REGISTER(command_pypose_play_def)
+static const command_t command_pypose_loop_def={
+	PYPOSE_LOOP_SEQUENCE, "pypose_loop", command_pypose_play, 0,
+	1, 2, COMMAND_ANY,
+	2, {COMMAND_PYPOSE_ID, COMMAND_VALUE(0, PYPOSE_MAX_SEQUENCE_COUNT-1)}
+};
+COMMAND_REGISTER(command_pypose_loop_def)
+
+static int16_t command_pypose_stop(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>[,<track>]
+	if (rx_vect.size()==2) {
+		pypose_player_stop_all(ctx->player);
+	} else {
+		pypose_player_stop(ctx->player, rx_vect[2]);
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_stop_def={
+	PYPOSE_STOP, "pypose_stop", command_pypose_stop, 0,
+	1, 2, COMMAND_ANY,
+	2, {COMMAND_PYPOSE_ID, COMMAND_VALUE(0, PYPOSE_PLAYER_TRACKS-1)}
+};
+COMMAND_REGISTER(command_pypose_stop_def)
+
+static int16_t command_pypose_play_track(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<track>,<seq_idx>,<loop>,<speed>,<priority>,<mask_L>,<mask_H>
+	int16_t ret=pypose_player_start(
+		ctx->player,
+		rx_vect[2],
+		rx_vect[3],
+		rx_vect[4]!=0,
+		rx_vect[5],
+		rx_vect[6],
+		(uint16_t)rx_vect[7]|((uint32_t)(uint16_t)rx_vect[8]<<16)
+	);
+	if (ret) {
+		return ret;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_play_track_def={
+	PYPOSE_PLAY_TRACK, "pypose_play_track", command_pypose_play_track, 0,
+	8, 8, COMMAND_ANY,
+	6, {
+		COMMAND_PYPOSE_ID,
+		COMMAND_VALUE(0, PYPOSE_PLAYER_TRACKS-1),
+		COMMAND_VALUE(0, PYPOSE_MAX_SEQUENCE_COUNT-1),
+		COMMAND_ANY,
+		COMMAND_VALUE(1, INT16_MAX),
+		COMMAND_BYTE
+	}
+};
+COMMAND_REGISTER(command_pypose_play_track_def)
+
+static int16_t command_pypose_read_player_state(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>
+	//response: <0>,<track_count>,[<state>,<seq_idx>,<part_idx>,<loop>,<speed>,<priority>]*
+	pypose_track_t track;
+
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(PYPOSE_PLAYER_TRACKS);
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		pypose_player_get_track(ctx->player, t, &track);
+		tx_vect.push_back(track.state);
+		tx_vect.push_back(track.sequence_id);
+		tx_vect.push_back(track.part_idx);
+		tx_vect.push_back(track.loop);
+		tx_vect.push_back(track.speed);
+		tx_vect.push_back(track.priority);
+	}
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_read_player_state_def={
+	PYPOSE_READ_PLAYER_STATE, "pypose_read_player_state", command_pypose_read_player_state, 0,
+	1, 1, COMMAND_ANY,
+	1, {COMMAND_PYPOSE_ID}
+};
+COMMAND_REGISTER(command_pypose_read_player_state_def)
+
+static int16_t command_pypose_test(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_pypose_test_def={
+	PYPOSE_TEST, "pypose_test", command_pypose_test, 0,
+	1, COMMAND_ARGS_ANY, COMMAND_ANY,
+	1, {COMMAND_PYPOSE_ID}
+};
+COMMAND_REGISTER(command_pypose_test_def)
+
+#endif
@@ -18,95 +18,298 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #ifndef PYPOSE_PLAYER_C
+#define PYPOSE_PLAYER_C
 
 #include "pypose_player.h"
 
-pthread_cond_t pyPose_SequencePlayer_active = PTHREAD_COND_INITIALIZER;
+static uint64_t pypose_player_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static uint64_t pypose_track_delay_ns(const pypose_track_t* track, uint16_t delay) {
+	//delay is in ms, speed in per-mille
+	return (uint64_t)delay*1000000000ULL/track->speed;
+}
+
+static void pypose_track_end(pypose_track_t* track) {
+	if (track->library) {
+		pypose_library_release(track->library);
+		track->library=NULL;
+	}
+	track->state=PP_STATE_STOPPED;
+}
+
+//starts a new pass at time 'now', each pass sees one complete library
+static bool pypose_track_begin(pypose_track_t* track, uint64_t now) {
+	pypose_sequence_t* cSequence;
+
+	if (track->library) {
+		pypose_library_release(track->library);
+	}
+	track->library=pypose_library_acquire();
+	cSequence=track->library->sequences[track->sequence_id];
+	if ((cSequence==NULL) || (cSequence->len==0)) {
+		std::cout << "Sequence not defined!" << std::endl;
+		pypose_track_end(track);
+		return false;
+	}
+	track->part_idx=0;
+	track->next_ns=now+pypose_track_delay_ns(track, cSequence->parts[0].delay);
+	return true;
+}
+
+//moves a track along its sequence, returns true if its pose changed
+static bool pypose_track_advance(pypose_track_t* track, uint64_t now) {
+	pypose_sequence_t* cSequence;
+	bool changed=false;
+
+	while ((track->state==PP_STATE_RUNNING) && (now>=track->next_ns)) {
+		cSequence=track->library->sequences[track->sequence_id];
+		changed=true;
+		if (track->part_idx+1<cSequence->len) {
+			track->part_idx++;
+			track->next_ns+=pypose_track_delay_ns(track, cSequence->parts[track->part_idx].delay);
+		} else if (track->loop) {
+			//at most one wrap per tick, a sequence of zero delays would spin otherwise
+			pypose_track_begin(track, track->next_ns);
+			break;
+		} else {
+			pypose_track_end(track);
+		}
+	}
+	return changed;
+}
+
+static bool pypose_player_running_locked(pypose_player_ctx_t* player_ctx) {
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		if (player_ctx->tracks[t].state==PP_STATE_RUNNING) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static pypose_pose_t* pypose_track_pose(const pypose_track_t* track) {
+	pypose_pose_t* cPose=track->library->poses[track->library->sequences[track->sequence_id]->parts[track->part_idx].pose_id];
+	if ((cPose==NULL) || (cPose->values==NULL)) {
+		return NULL;
+	}
+	return cPose;
+}
+
+/*
+ * the pose whose packet can go out as it is: one running track alone
+ * decides every servo of its pose. NULL if the tracks have to be merged.
+ * Called with the lock held.
+ */
+static pypose_pose_t* pypose_player_single_pose(pypose_player_ctx_t* player_ctx, pypose_library_t** library) {
+	pypose_pose_t* single=NULL;
+
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		pypose_track_t* track=&player_ctx->tracks[t];
+		pypose_pose_t* cPose;
+		uint32_t pose_mask;
+
+		if (track->state!=PP_STATE_RUNNING) {
+			continue;
+		}
+		cPose=pypose_track_pose(track);
+		if (cPose==NULL) {
+			continue;
+		}
+		pose_mask=(uint32_t)((1ULL<<cPose->len)-1);
+		if ((track->mask&pose_mask)==0) {
+			continue;
+		}
+		if ((single) || ((track->mask&pose_mask)!=pose_mask)) {
+			return NULL;
+		}
+		single=cPose;
+		*library=track->library;
+	}
+	if ((single) && (single->packet_len==0)) {
+		return NULL;
+	}
+	return single;
+}
+
+/*
+ * merges the current pose of all running tracks into player_ctx->data as
+ * <id>,<position> pairs, returns the id count. Called with the lock held.
+ */
+uint8_t pypose_player_merge(pypose_player_ctx_t* player_ctx) {
+	int16_t best[PYPOSE_MAX_POSE_SIZE];
+	uint32_t sum[PYPOSE_MAX_POSE_SIZE];
+	uint8_t count[PYPOSE_MAX_POSE_SIZE];
+	uint8_t id_count=0;
+
+	for (uint8_t i=0; i<PYPOSE_MAX_POSE_SIZE; i++) {
+		best[i]=-1;
+	}
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		pypose_track_t* track=&player_ctx->tracks[t];
+		pypose_pose_t* cPose;
+
+		if (track->state!=PP_STATE_RUNNING) {
+			continue;
+		}
+		cPose=pypose_track_pose(track);
+		if (cPose==NULL) {
+			continue;
+		}
+		for (uint8_t i=0; i<cPose->len; i++) {
+			if (!((track->mask>>i)&1)) {
+				continue;
+			}
+			if (track->priority>best[i]) {
+				best[i]=track->priority;
+				sum[i]=cPose->values[i];
+				count[i]=1;
+			} else if (track->priority==best[i]) {
+				sum[i]+=cPose->values[i];
+				count[i]++;
+			}
+		}
+	}
+	for (uint8_t i=0; i<PYPOSE_MAX_POSE_SIZE; i++) {
+		if (best[i]>=0) {
+			player_ctx->data[id_count*2]=i+1;
+			player_ctx->data[id_count*2+1]=sum[i]/count[i];
+			id_count++;
+		}
+	}
+	return id_count;
+}
 
 void *pyPose_SequencePlayer(void* arg){
 	pypose_player_ctx_t* player_ctx = (pypose_player_ctx_t*)arg;
-	pypose_sequence_t* cSequence=NULL;
-	uint8_t cSequence_id;
-	uint8_t cpart_idx;
-	uint8_t pose_id;
-	uint16_t data[100];
-	
-	pypose_pose_t* cPose=NULL;
-	
+	struct timespec next;
+	long period_ns=1000000000L/PYPOSE_PLAYER_RATE;
+	uint64_t now;
+	uint64_t merge_ns;
+	uint8_t id_count;
+	pypose_pose_t* packet_pose;
+	pypose_library_t* packet_library=NULL;
+	bool changed;
+
 	int16_t dynamixel_ret;
+	clock_gettime(CLOCK_MONOTONIC, &next);
 	while(true) {
-		//pthread_mutex_lock(&player_ctx->lock);
-		while (player_ctx->state == PP_STATE_STOPPED) {
+		pthread_mutex_lock(&player_ctx->lock);
+		if (!pypose_player_running_locked(player_ctx)) {
 			if (player_ctx->debug) {
+				if (player_ctx->bus->stats.priority_transactions) {
+					std::cout << "Bus wait per tick: avg "
+						<< player_ctx->bus->stats.priority_wait_ns_sum/player_ctx->bus->stats.priority_transactions/1000
+						<< "us, max "
+						<< player_ctx->bus->stats.priority_wait_ns_max/1000 << "us" << std::endl;
+				}
+				if (player_ctx->merge_count) {
+					std::cout << "Track merge per tick: avg "
+						<< player_ctx->merge_ns_sum/player_ctx->merge_count
+						<< "ns, max "
+						<< player_ctx->merge_ns_max << "ns, "
+						<< player_ctx->packet_count << " of "
+						<< player_ctx->merge_count << " prebuilt" << std::endl;
+				}
 				std::cout << "Player stopped..." << std::endl;
 			}
-			pthread_cond_wait(&player_ctx->cond, &player_ctx->lock);
+			while (!pypose_player_running_locked(player_ctx)) {
+				pthread_cond_wait(&player_ctx->cond, &player_ctx->lock);
+			}
+			if (player_ctx->debug) {
+				std::cout << "Player started..." << std::endl;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &next);
 		}
-		//pthread_mutex_unlock(&player_ctx->lock);
 
-		std::cout << "Player started..." << std::endl;
-
-		cSequence_id=player_ctx->sequence_id;
-		if ((cSequence_id<PYPOSE_MAX_SEQUENCE_COUNT) && 
-				((player_ctx->sequences[cSequence_id])!=NULL)) {
-			cSequence=player_ctx->sequences[cSequence_id];
-		} else {
-			std::cout << "Sequence not defined!" << std::endl;
-			cSequence=NULL;
+		now=pypose_player_now();
+		changed=player_ctx->dirty;
+		player_ctx->dirty=false;
+		for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+			if (pypose_track_advance(&player_ctx->tracks[t], now)) {
+				changed=true;
+			}
 		}
-		
-		if (cSequence!=NULL) {
-			do {
-				if (player_ctx->debug) {
-					std::cout << "Playing sequence " << (int)player_ctx->sequence_id << std::endl;
-				}
-				for (cpart_idx=0; cpart_idx<cSequence->len; cpart_idx++) {
-					pose_id=cSequence->parts[cpart_idx].pose_id;
-					if (player_ctx->debug) {
-						std::cout << "Current pose: " << (int)pose_id << std::endl;
-						std::cout << "delay: " << (int)cSequence->parts[cpart_idx].delay << std::endl;
-					}
-					cPose=player_ctx->poses[pose_id];
-					
-					if ((cPose!=NULL) && (cPose->values!=NULL)) {
-						for (uint8_t i=0;i<(cPose->len);i++) {
-							data[i*2]=i+1;
-							data[i*2+1]=cPose->values[i];
-						}
-
-						//write pose
-						dynamixel_ret=dynamixel_sync_write_words(
-							player_ctx->dynamixel_ctx,
-							DYNAMIXEL_R_GOAL_POSITION_L,				/*register*/
-							player_ctx->poses[pose_id]->len,		/*id-count*/
-							1,																	/*word_count*/
-							data
-						);
-					} else {
-						std::cout << "No values found for pose " << (int)pose_id << std::endl;
-					}
-					usleep(1000*cSequence->parts[cpart_idx].delay);
-					if (player_ctx->state == PP_STATE_STOPPED) {
-						break;
-					}
-				}
-			} while (player_ctx->loop);
+		id_count=0;
+		packet_pose=NULL;
+		if (changed) {
+			//the library stays alive until the bytes are out, a stop may release it meanwhile
+			if (player_ctx->bus->serial) {
+				packet_pose=pypose_player_single_pose(player_ctx, &packet_library);
+			}
+			if (packet_pose) {
+				pypose_library_hold(packet_library);
+				player_ctx->packet_count++;
+			} else {
+				id_count=pypose_player_merge(player_ctx);
+			}
+			merge_ns=pypose_player_now()-now;
+			player_ctx->merge_ns_sum+=merge_ns;
+			if (merge_ns>player_ctx->merge_ns_max) {
+				player_ctx->merge_ns_max=merge_ns;
+			}
+			player_ctx->merge_count++;
 		}
-		if (!player_ctx->loop) {
-			player_ctx->state=PP_STATE_STOPPED;
+		pthread_mutex_unlock(&player_ctx->lock);
+
+		if (packet_pose) {
+			dynamixel_ret=dynamixel_bus_write_packet(
+				player_ctx->bus,
+				packet_pose->packet,
+				packet_pose->packet_len,
+				true
+			);
+			if ((dynamixel_ret<0) && (player_ctx->debug)) {
+				std::cout << "Writing pose packet failed: " << dynamixel_ret << std::endl;
+			}
+			pypose_library_release(packet_library);
+		} else if (id_count) {
+			//one packet for all tracks, ticks go ahead of any queued zmq request
+			dynamixel_ret=dynamixel_bus_sync_write_words(
+				player_ctx->bus,
+				DYNAMIXEL_R_GOAL_POSITION_L,				/*register*/
+				id_count,														/*id-count*/
+				1,																	/*word_count*/
+				player_ctx->data,
+				true
+			);
+			if ((dynamixel_ret<0) && (player_ctx->debug)) {
+				std::cout << "Writing merged pose failed: " << dynamixel_ret << std::endl;
+			}
 		}
+
+		next.tv_nsec+=period_ns;
+		if (next.tv_nsec>=1000000000L) {
+			next.tv_nsec-=1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
 	}
-	//pthread_cond_broadcast(&player_ctx->cond);
-	//
 	return NULL;
 }
 
 void pypose_player_init(pthread_t *player_thread,pypose_player_ctx_t* pyPose_Player_Context) {
 
-	pyPose_Player_Context->state=PP_STATE_STOPPED;
-	pyPose_Player_Context->loop=false;
-	pyPose_Player_Context->pose_id=0;
-	pyPose_Player_Context->sequence_id=0;
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		pypose_track_t* cTrack=&pyPose_Player_Context->tracks[t];
+		cTrack->state=PP_STATE_STOPPED;
+		cTrack->loop=false;
+		cTrack->sequence_id=0;
+		cTrack->part_idx=0;
+		cTrack->speed=PYPOSE_PLAYER_SPEED_NORMAL;
+		cTrack->priority=0;
+		cTrack->mask=0;
+		cTrack->next_ns=0;
+		cTrack->library=NULL;
+	}
+	pyPose_Player_Context->dirty=false;
+	pyPose_Player_Context->merge_ns_sum=0;
+	pyPose_Player_Context->merge_ns_max=0;
+	pyPose_Player_Context->merge_count=0;
+	pyPose_Player_Context->packet_count=0;
 	
 	pthread_mutex_init(&pyPose_Player_Context->lock, NULL);
 	pthread_cond_init(&pyPose_Player_Context->cond, NULL);
@@ -114,4 +317,53 @@ void pypose_player_init(pthread_t *player_thread,pypose_player_ctx_t* pyPose_Pla
 	pthread_create(player_thread, NULL, &pyPose_SequencePlayer, (void*)pyPose_Player_Context);
 	
 }
+
+//the track ends if the sequence is not defined, servos shared with other tracks fall back to them
+int16_t pypose_player_start(pypose_player_ctx_t* pyPose_Player_Context, uint8_t track, uint8_t sequence_id, bool loop, uint16_t speed, uint8_t priority, uint32_t mask) {
+	pypose_track_t* cTrack=&pyPose_Player_Context->tracks[track];
+	bool started;
+
+	pthread_mutex_lock(&pyPose_Player_Context->lock);
+	cTrack->sequence_id=sequence_id;
+	cTrack->loop=loop;
+	cTrack->speed=speed;
+	cTrack->priority=priority;
+	cTrack->mask=mask;
+	cTrack->state=PP_STATE_RUNNING;
+	started=pypose_track_begin(cTrack, pypose_player_now());
+	pyPose_Player_Context->dirty=true;
+	pthread_cond_signal(&pyPose_Player_Context->cond);
+	pthread_mutex_unlock(&pyPose_Player_Context->lock);
+	return started ? ZMQ_ERR_NO_ERROR : ZMQ_ERR_INVALID_PARAMETERS;
+}
+
+void pypose_player_stop(pypose_player_ctx_t* pyPose_Player_Context, uint8_t track) {
+	pthread_mutex_lock(&pyPose_Player_Context->lock);
+	pypose_track_end(&pyPose_Player_Context->tracks[track]);
+	//servos shared with other tracks fall back to them
+	pyPose_Player_Context->dirty=true;
+	pthread_mutex_unlock(&pyPose_Player_Context->lock);
+}
+
+void pypose_player_stop_all(pypose_player_ctx_t* pyPose_Player_Context) {
+	pthread_mutex_lock(&pyPose_Player_Context->lock);
+	for (uint8_t t=0; t<PYPOSE_PLAYER_TRACKS; t++) {
+		pypose_track_end(&pyPose_Player_Context->tracks[t]);
+	}
+	pthread_mutex_unlock(&pyPose_Player_Context->lock);
+}
+
+void pypose_player_get_track(pypose_player_ctx_t* pyPose_Player_Context, uint8_t track, pypose_track_t* state) {
+	pthread_mutex_lock(&pyPose_Player_Context->lock);
+	*state=pyPose_Player_Context->tracks[track];
+	pthread_mutex_unlock(&pyPose_Player_Context->lock);
+}
+
+bool pypose_player_running(pypose_player_ctx_t* pyPose_Player_Context) {
+	bool running;
+	pthread_mutex_lock(&pyPose_Player_Context->lock);
+	running=pypose_player_running_locked(pyPose_Player_Context);
+	pthread_mutex_unlock(&pyPose_Player_Context->lock);
+	return running;
+}
 #endif
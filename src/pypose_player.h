@@ -18,25 +18,51 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 #ifndef PYPOSE_PLAYER_H
+#define PYPOSE_PLAYER_H
 
 /* stuff for sequence playing */
 #include <pthread.h>
 #include <time.h>
 
+#define PYPOSE_PLAYER_TRACKS        8
+#define PYPOSE_PLAYER_RATE          100		/* Hz */
+#define PYPOSE_PLAYER_ALL_SERVOS    0xFFFFFFFF
+#define PYPOSE_PLAYER_SPEED_NORMAL  1000	/* per-mille */
+
 typedef enum {
 	PP_STATE_STOPPED,
 	PP_STATE_RUNNING,
 } pypose_player_state_t;
 
+/*
+ * A track plays one sequence on a subset of the servos, bit n of the mask
+ * selects pose value n (servo id n+1). Where tracks overlap the highest
+ * priority wins, equal priorities are averaged.
+ * With the native transport a tick where one track alone decides all servos
+ * of its pose sends the packet compiled with the pose instead of merging.
+ */
 typedef struct {
-	bool											debug;
 	pypose_player_state_t			state;
 	bool											loop;
-	uint8_t										pose_id;
 	uint8_t										sequence_id;
-	dynamixel_t*							dynamixel_ctx;
-	pypose_pose_t**						poses;
-	pypose_sequence_t** 			sequences;
+	uint8_t										part_idx;
+	uint16_t									speed;					/* per-mille of the sequence delays */
+	uint8_t										priority;
+	uint32_t									mask;
+	uint64_t									next_ns;				/* CLOCK_MONOTONIC of the next part */
+	pypose_library_t*					library;				/* held for the current pass */
+} pypose_track_t;
+
+typedef struct {
+	bool											debug;
+	dynamixel_bus_t*					bus;
+	pypose_track_t						tracks[PYPOSE_PLAYER_TRACKS];
+	bool											dirty;					/* a track was started or stopped */
+	uint64_t									merge_ns_sum;
+	uint64_t									merge_ns_max;
+	uint32_t									merge_count;
+	uint32_t									packet_count;		/* ticks sent as a prebuilt pose packet */
+	uint16_t									data[PYPOSE_MAX_POSE_SIZE*2];
 
 	pthread_mutex_t						lock;
 	pthread_cond_t						cond;
@@ -45,6 +71,11 @@ typedef struct {
 
 void *pyPose_SequencePlayer(void* arg);
 
-void pypose_player_init(pypose_player_ctx_t*);
-void pyPose_SequencePlayer_cmd(uint8_t command);
+void pypose_player_init(pthread_t *player_thread, pypose_player_ctx_t*);
+int16_t pypose_player_start(pypose_player_ctx_t*, uint8_t track, uint8_t sequence_id, bool loop, uint16_t speed, uint8_t priority, uint32_t mask);
+void pypose_player_stop(pypose_player_ctx_t*, uint8_t track);
+void pypose_player_stop_all(pypose_player_ctx_t*);
+void pypose_player_get_track(pypose_player_ctx_t*, uint8_t track, pypose_track_t* state);
+bool pypose_player_running(pypose_player_ctx_t*);
+uint8_t pypose_player_merge(pypose_player_ctx_t*);
 #endif
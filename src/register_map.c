@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef REGISTER_MAP_C
+#define REGISTER_MAP_C
+
+#include "register_map.h"
+
+#define REGISTER_MAP_ENTRY(address, size, encoding) \
+	{(int8_t)(address), (uint8_t)(((address)<0) ? 0 : (size)), REGISTER_##encoding},
+#define REGISTER_MAP_AX12(name, size, encoding, ax12, ax18, mx28, mx64) REGISTER_MAP_ENTRY(ax12, size, encoding)
+#define REGISTER_MAP_AX18(name, size, encoding, ax12, ax18, mx28, mx64) REGISTER_MAP_ENTRY(ax18, size, encoding)
+#define REGISTER_MAP_MX28(name, size, encoding, ax12, ax18, mx28, mx64) REGISTER_MAP_ENTRY(mx28, size, encoding)
+#define REGISTER_MAP_MX64(name, size, encoding, ax12, ax18, mx28, mx64) REGISTER_MAP_ENTRY(mx64, size, encoding)
+
+const register_field_info_t register_map[REGISTER_MODEL_COUNT][REGISTER_FIELD_COUNT]={
+	{REGISTER_FIELDS(REGISTER_MAP_AX12)},
+	{REGISTER_FIELDS(REGISTER_MAP_AX18)},
+	{REGISTER_FIELDS(REGISTER_MAP_MX28)},
+	{REGISTER_FIELDS(REGISTER_MAP_MX64)},
+};
+
+#undef REGISTER_MAP_AX12
+#undef REGISTER_MAP_AX18
+#undef REGISTER_MAP_MX28
+#undef REGISTER_MAP_MX64
+#undef REGISTER_MAP_ENTRY
+
+bool register_map_span(register_model_t model, const uint8_t* fields, uint8_t count, uint8_t* start, uint8_t* length) {
+	uint8_t first=0xFF;
+	uint8_t end=0;
+
+	if ((model>=REGISTER_MODEL_COUNT) || (count==0)) {
+		return false;
+	}
+	for (uint8_t i=0; i<count; i++) {
+		const register_field_info_t* info;
+		if (fields[i]>=REGISTER_FIELD_COUNT) {
+			return false;
+		}
+		info=&register_map[model][fields[i]];
+		if (info->address<0) {
+			return false;
+		}
+		if (info->address<first) {
+			first=info->address;
+		}
+		if (info->address+info->size>end) {
+			end=info->address+info->size;
+		}
+	}
+	*start=first;
+	*length=end-first;
+	return true;
+}
+
+void register_map_decode(register_model_t model, const uint8_t* fields, uint8_t count, uint8_t start, const uint8_t* data, int16_t* values) {
+	for (uint8_t i=0; i<count; i++) {
+		const register_field_info_t* info=&register_map[model][fields[i]];
+		const uint8_t* p=data+(info->address-start);
+		uint16_t raw=(info->size==2) ? register_decode_word(p) : p[0];
+
+		if (info->encoding==REGISTER_SIGN_MAG) {
+			values[i]=(raw&0x400) ? -(int16_t)(raw&0x3FF) : (int16_t)(raw&0x3FF);
+		} else {
+			values[i]=(int16_t)raw;
+		}
+	}
+}
+
+#endif
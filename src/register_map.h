@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ *
+ * Dynamixel ZeroMQ service
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef REGISTER_MAP_H
+#define REGISTER_MAP_H
+
+/*
+ * Control table layout per servo model. The maps are generated at compile
+ * time from the list below, -1 marks a field the model doesn't have.
+ * SIGN_MAG fields carry the direction in bit 10 (set = CW = negative).
+ */
+#define REGISTER_FIELDS(F) \
+	/* name,                 size, encoding, AX12, AX18, MX28, MX64 */ \
+	F(MODEL_NUMBER,            2,  UNSIGNED,    0,    0,    0,    0) \
+	F(FIRMWARE_VERSION,        1,  UNSIGNED,    2,    2,    2,    2) \
+	F(ID,                      1,  UNSIGNED,    3,    3,    3,    3) \
+	F(BAUD_RATE,               1,  UNSIGNED,    4,    4,    4,    4) \
+	F(RETURN_DELAY_TIME,       1,  UNSIGNED,    5,    5,    5,    5) \
+	F(CW_ANGLE_LIMIT,          2,  UNSIGNED,    6,    6,    6,    6) \
+	F(CCW_ANGLE_LIMIT,         2,  UNSIGNED,    8,    8,    8,    8) \
+	F(TEMPERATURE_LIMIT,       1,  UNSIGNED,   11,   11,   11,   11) \
+	F(MIN_VOLTAGE_LIMIT,       1,  UNSIGNED,   12,   12,   12,   12) \
+	F(MAX_VOLTAGE_LIMIT,       1,  UNSIGNED,   13,   13,   13,   13) \
+	F(MAX_TORQUE,              2,  UNSIGNED,   14,   14,   14,   14) \
+	F(STATUS_RETURN_LEVEL,     1,  UNSIGNED,   16,   16,   16,   16) \
+	F(ALARM_LED,               1,  UNSIGNED,   17,   17,   17,   17) \
+	F(ALARM_SHUTDOWN,          1,  UNSIGNED,   18,   18,   18,   18) \
+	F(MULTI_TURN_OFFSET,       2,  UNSIGNED,   -1,   -1,   20,   20) \
+	F(RESOLUTION_DIVIDER,      1,  UNSIGNED,   -1,   -1,   22,   22) \
+	F(TORQUE_ENABLE,           1,  UNSIGNED,   24,   24,   24,   24) \
+	F(LED,                     1,  UNSIGNED,   25,   25,   25,   25) \
+	F(CW_COMPLIANCE_MARGIN,    1,  UNSIGNED,   26,   26,   -1,   -1) \
+	F(CCW_COMPLIANCE_MARGIN,   1,  UNSIGNED,   27,   27,   -1,   -1) \
+	F(CW_COMPLIANCE_SLOPE,     1,  UNSIGNED,   28,   28,   -1,   -1) \
+	F(CCW_COMPLIANCE_SLOPE,    1,  UNSIGNED,   29,   29,   -1,   -1) \
+	F(D_GAIN,                  1,  UNSIGNED,   -1,   -1,   26,   26) \
+	F(I_GAIN,                  1,  UNSIGNED,   -1,   -1,   27,   27) \
+	F(P_GAIN,                  1,  UNSIGNED,   -1,   -1,   28,   28) \
+	F(GOAL_POSITION,           2,  UNSIGNED,   30,   30,   30,   30) \
+	F(MOVING_SPEED,            2,  UNSIGNED,   32,   32,   32,   32) \
+	F(TORQUE_LIMIT,            2,  UNSIGNED,   34,   34,   34,   34) \
+	F(PRESENT_POSITION,        2,  UNSIGNED,   36,   36,   36,   36) \
+	F(PRESENT_SPEED,           2,  SIGN_MAG,   38,   38,   38,   38) \
+	F(PRESENT_LOAD,            2,  SIGN_MAG,   40,   40,   40,   40) \
+	F(PRESENT_VOLTAGE,         1,  UNSIGNED,   42,   42,   42,   42) \
+	F(PRESENT_TEMPERATURE,     1,  UNSIGNED,   43,   43,   43,   43) \
+	F(REGISTERED,              1,  UNSIGNED,   44,   44,   44,   44) \
+	F(MOVING,                  1,  UNSIGNED,   46,   46,   46,   46) \
+	F(LOCK,                    1,  UNSIGNED,   47,   47,   47,   47) \
+	F(PUNCH,                   2,  UNSIGNED,   48,   48,   48,   48) \
+	F(CURRENT,                 2,  UNSIGNED,   -1,   -1,   -1,   68) \
+	F(TORQUE_CONTROL_MODE,     1,  UNSIGNED,   -1,   -1,   -1,   70) \
+	F(GOAL_TORQUE,             2,  UNSIGNED,   -1,   -1,   -1,   71) \
+	F(GOAL_ACCELERATION,       1,  UNSIGNED,   -1,   -1,   73,   73)
+
+#define REGISTER_FIELD_ENUM(name, size, encoding, ax12, ax18, mx28, mx64) REGISTER_FIELD_##name,
+typedef enum {
+	REGISTER_FIELDS(REGISTER_FIELD_ENUM)
+	REGISTER_FIELD_COUNT,
+} register_field_t;
+#undef REGISTER_FIELD_ENUM
+
+typedef enum {
+	REGISTER_MODEL_AX12,
+	REGISTER_MODEL_AX18,
+	REGISTER_MODEL_MX28,
+	REGISTER_MODEL_MX64,
+	REGISTER_MODEL_COUNT,
+} register_model_t;
+
+typedef enum {
+	REGISTER_UNSIGNED,
+	REGISTER_SIGN_MAG,
+} register_encoding_t;
+
+typedef struct {
+	int8_t		address;			/* -1: not available on this model */
+	uint8_t		size;
+	uint8_t		encoding;
+} register_field_info_t;
+
+extern const register_field_info_t register_map[REGISTER_MODEL_COUNT][REGISTER_FIELD_COUNT];
+
+static inline uint16_t register_decode_word(const uint8_t* data) {
+	return data[0]|(data[1]<<8);
+}
+
+/* checks the fields against the model and computes the smallest block covering them */
+bool register_map_span(register_model_t model, const uint8_t* fields, uint8_t count, uint8_t* start, uint8_t* length);
+/* decodes the block read from <start> into one value per field */
+void register_map_decode(register_model_t model, const uint8_t* fields, uint8_t count, uint8_t start, const uint8_t* data, int16_t* values);
+
+#endif
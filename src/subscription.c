@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef SUBSCRIPTION_C
+#define SUBSCRIPTION_C
+
+#include <algorithm>
+#include "subscription.h"
+
+static inline uint64_t subscription_ns(const struct timespec* ts) {
+	return (uint64_t)ts->tv_sec*1000000000ULL + ts->tv_nsec;
+}
+
+int16_t subscription_add(subscription_service_t* service, uint8_t id, register_model_t model, register_field_t field, subscription_mode_t mode, int16_t value, uint16_t interval_ms) {
+	const register_field_info_t* info=&register_map[model][field];
+	uint16_t handle;
+
+	if (info->address<0) {
+		return ZMQ_ERR_INVALID_PARAMETERS;
+	}
+	pthread_mutex_lock(&service->lock);
+	for (handle=0; handle<SUBSCRIPTION_MAX; handle++) {
+		if (!service->active[handle]) {
+			break;
+		}
+	}
+	if (handle==SUBSCRIPTION_MAX) {
+		pthread_mutex_unlock(&service->lock);
+		return ZMQ_ERR_SUBSCRIPTIONS_FULL;
+	}
+	service->id[handle]=id;
+	service->field[handle]=field;
+	service->model[handle]=model;
+	service->mode[handle]=mode;
+	service->value[handle]=value;
+	service->interval[handle]=((uint32_t)interval_ms*service->rate+999)/1000;
+	/* chosen so the first sample fires if the condition already holds */
+	service->last[handle]=(mode==SUBSCRIPTION_BELOW) ? 0x10000 : -0x10000;
+	service->next[handle]=service->tick;
+	service->active[handle]=1;
+	if (handle>=service->count) {
+		service->count=handle+1;
+	}
+	service->dirty=true;
+	pthread_mutex_unlock(&service->lock);
+	return handle;
+}
+
+int16_t subscription_remove(subscription_service_t* service, uint16_t handle) {
+	int16_t ret=ZMQ_ERR_INVALID_PARAMETERS;
+
+	pthread_mutex_lock(&service->lock);
+	if ((handle<service->count) && service->active[handle]) {
+		service->active[handle]=0;
+		while ((service->count>0) && !service->active[service->count-1]) {
+			service->count--;
+		}
+		service->dirty=true;
+		ret=ZMQ_ERR_NO_ERROR;
+	}
+	pthread_mutex_unlock(&service->lock);
+	return ret;
+}
+
+/* sorts the subscribed windows by servo and address and merges neighbours, lock held */
+void subscription_compile(subscription_service_t* service) {
+	uint32_t order[SUBSCRIPTION_MAX];		/* id, address, handle */
+	uint16_t order_count=0;
+	subscription_read_t* read=NULL;
+
+	service->reads[SUBSCRIPTION_NO_READ].valid=false;
+	for (uint16_t i=0; i<service->count; i++) {
+		const register_field_info_t* info=&register_map[service->model[i]][service->field[i]];
+		service->read_of[i]=SUBSCRIPTION_NO_READ;
+		service->offset[i]=0;
+		service->size[i]=info->size;
+		service->encoding[i]=info->encoding;
+		if (service->active[i]) {
+			order[order_count++]=((uint32_t)service->id[i]<<24)|((uint32_t)info->address<<16)|i;
+		}
+	}
+	std::sort(order, order+order_count);
+
+	service->read_count=0;
+	for (uint16_t i=0; i<order_count; i++) {
+		uint16_t handle=order[i]&0xFFFF;
+		uint8_t address=(order[i]>>16)&0xFF;
+		uint8_t end=address+service->size[handle];
+
+		if ((!read) || (read->id!=service->id[handle]) || (address>read->start+read->length+SUBSCRIPTION_MERGE_GAP)) {
+			if (service->read_count==SUBSCRIPTION_MAX_READS) {
+				if (service->debug) {
+					std::cout << "Subscription " << handle << ": too many reads, ignored" << std::endl;
+				}
+				continue;
+			}
+			read=&service->reads[service->read_count++];
+			read->id=service->id[handle];
+			read->start=address;
+			read->length=0;
+		}
+		if (end-read->start>read->length) {
+			read->length=end-read->start;
+		}
+		service->read_of[handle]=service->read_count-1;
+		service->offset[handle]=address-read->start;
+	}
+	service->dirty=false;
+}
+
+/*
+ * lock held. The gather is the only part that looks at the read buffers,
+ * the conditions are then evaluated for all slots with masks instead of
+ * branches, the outcome is as random as the servo data.
+ */
+void subscription_evaluate(subscription_service_t* service, uint32_t tick) {
+	uint16_t count=service->count;
+	uint16_t i;
+
+	for (i=0; i<count; i++) {
+		const subscription_read_t* read=&service->reads[service->read_of[i]];
+		const uint8_t* p=read->data+service->offset[i];
+		int32_t wide=-(int32_t)(service->size[i]==2);
+		int32_t sign_mag=-(int32_t)(service->encoding[i]==REGISTER_SIGN_MAG);
+		int32_t raw=p[0]|((p[1]<<8)&wide);
+		int32_t negative=-((raw>>10)&1);
+		int32_t magnitude=raw&0x3FF;
+		int32_t decoded=(magnitude^negative)-negative;
+
+		service->current[i]=raw^((raw^decoded)&sign_mag);
+		service->sampled[i]=read->valid;
+	}
+
+	/* restrict: the uint8_t stores would otherwise alias everything */
+	const int32_t* __restrict__ current=service->current;
+	const int32_t* __restrict__ value=service->value;
+	const uint8_t* __restrict__ mode=service->mode;
+	const uint8_t* __restrict__ active=service->active;
+	const uint8_t* __restrict__ sampled=service->sampled;
+	const uint32_t* __restrict__ interval=service->interval;
+	int32_t* __restrict__ last=service->last;
+	uint32_t* __restrict__ next=service->next;
+	uint8_t* __restrict__ fired=service->fired;
+
+	for (i=0; i<count; i++) {
+		int32_t delta=abs(current[i]-last[i]);
+		int32_t deadband=(value[i]>1) ? value[i] : 1;
+		int32_t change=(mode[i]==SUBSCRIPTION_CHANGE) & (delta>=deadband);
+		int32_t above=(mode[i]==SUBSCRIPTION_ABOVE) & (current[i]>value[i]) & (last[i]<=value[i]);
+		int32_t below=(mode[i]==SUBSCRIPTION_BELOW) & (current[i]<value[i]) & (last[i]>=value[i]);
+		int32_t condition=(change|above|below) & sampled[i] & active[i];
+		int32_t fire=condition & ((int32_t)(tick-next[i])>=0);
+		/* thresholds follow the value, but a crossing waits for the rate limit */
+		int32_t follow=fire | ((mode[i]!=SUBSCRIPTION_CHANGE) & (condition^1) & sampled[i]);
+
+		last[i]^=(last[i]^current[i])&-follow;
+		next[i]+=(tick+interval[i]-next[i])&-fire;
+		fired[i]=fire;
+	}
+
+	service->notification_count=0;
+	for (i=0; i<count; i++) {
+		if (service->fired[i]) {
+			subscription_notification_t* n=&service->notifications[service->notification_count++];
+			n->handle=i;
+			n->id=service->id[i];
+			n->field=service->field[i];
+			n->value=(int16_t)service->current[i];
+			n->t_reply_ns=service->reads[service->read_of[i]].timing.t_reply_ns;
+		}
+	}
+}
+
+static void subscription_publish(subscription_service_t* service) {
+	for (uint16_t i=0; i<service->notification_count; i++) {
+		const subscription_notification_t* n=&service->notifications[i];
+		std::vector<int16_t> tx_vect;
+		msgpack::sbuffer tx_msg;
+
+		tx_vect.push_back(n->handle);
+		tx_vect.push_back(n->id);
+		tx_vect.push_back(n->field);
+		tx_vect.push_back(n->value);
+		for (uint8_t w=0; w<4; w++) {
+			tx_vect.push_back((int16_t)(uint16_t)(n->t_reply_ns>>(16*w)));
+		}
+		msgpack::pack(&tx_msg, tx_vect);
+		zmq::message_t tx_zmq(tx_msg.size());
+		memcpy(static_cast<char*>(tx_zmq.data()), tx_msg.data(), tx_msg.size());
+		service->socket->send(tx_zmq);
+	}
+	service->stats.notifications+=service->notification_count;
+}
+
+/* after the reads of a tick, lock held */
+static void subscription_step(subscription_service_t* service) {
+	service->notification_count=0;
+	/* a subscription changed while reading, its slot may point anywhere */
+	if (!service->dirty) {
+		subscription_evaluate(service, service->tick);
+	}
+	service->tick++;
+}
+
+void *subscription_thread(void* arg) {
+	subscription_service_t* service=(subscription_service_t*)arg;
+	struct timespec next;
+	struct timespec t_start;
+	struct timespec t_end;
+	long period_ns=1000000000L/service->rate;
+	uint64_t eval_ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (true) {
+		pthread_mutex_lock(&service->lock);
+		if (service->dirty) {
+			subscription_compile(service);
+		}
+		service->stats.polls+=service->count;
+		pthread_mutex_unlock(&service->lock);
+
+		/* only this thread touches the reads, so no lock while the bus is busy */
+		for (uint16_t r=0; r<service->read_count; r++) {
+			subscription_read_t* read=&service->reads[r];
+			read->valid=(dynamixel_bus_read_data_timed(
+				service->bus,
+				read->id,
+				(dynamixel_register_t)read->start,
+				read->length,
+				read->data,
+				&read->timing
+			)==read->length);
+		}
+		service->stats.reads+=service->read_count;
+
+		pthread_mutex_lock(&service->lock);
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		subscription_step(service);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+		pthread_mutex_unlock(&service->lock);
+		subscription_publish(service);
+
+		eval_ns=subscription_ns(&t_end)-subscription_ns(&t_start);
+		service->stats.ticks++;
+		service->stats.eval_ns_sum+=eval_ns;
+		if (eval_ns>service->stats.eval_ns_max) {
+			service->stats.eval_ns_max=eval_ns;
+		}
+		if ((service->debug) && ((service->stats.ticks%(10*service->rate))==0)) {
+			std::cout << "Subscriptions: " << service->stats.reads << " reads for "
+				<< service->stats.polls << " polls, "
+				<< service->stats.notifications << " notifications, eval avg "
+				<< service->stats.eval_ns_sum/service->stats.ticks << "ns max "
+				<< service->stats.eval_ns_max << "ns" << std::endl;
+		}
+
+		next.tv_nsec+=period_ns;
+		if (next.tv_nsec>=1000000000L) {
+			next.tv_nsec-=1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+	return NULL;
+}
+
+bool subscription_init(subscription_service_t* service, dynamixel_bus_t* bus, zmq::context_t* context, const std::string& uri, uint16_t rate) {
+	service->bus=bus;
+	service->rate=rate;
+	service->dirty=false;
+	service->tick=0;
+	service->count=0;
+	service->read_count=0;
+	service->notification_count=0;
+	memset(service->active, 0, sizeof(service->active));
+	memset(&service->stats, 0, sizeof(service->stats));
+	pthread_mutex_init(&service->lock, NULL);
+
+	try {
+		service->socket=new zmq::socket_t(*context, ZMQ_PUB);
+		service->socket->bind(uri.c_str());
+	} catch (zmq::error_t& e) {
+		std::cerr << "Can't bind " << uri << ": " << e.what() << std::endl;
+		return false;
+	}
+	if (service->debug) {
+		std::cout << "Subscriptions published on " << uri << " (" << rate << "Hz)" << std::endl;
+	}
+
+	pthread_create(&service->thread, NULL, &subscription_thread, (void*)service);
+	return true;
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef SUBSCRIPTION_H
+#define SUBSCRIPTION_H
+
+/*
+ * Change driven register subscriptions (dyn_zmq --pub <uri>).
+ *
+ * Clients subscribe to one register field of one servo with a condition
+ * and a minimum interval, the service polls the registers itself and
+ * publishes a notification on the PUB socket only when the condition
+ * fires:
+ *   <handle>, <id>, <field>, <value>, <t_reply 4 words>
+ *
+ * The poll thread turns the subscriptions into as few reads as possible,
+ * windows of the same servo closer than SUBSCRIPTION_MERGE_GAP bytes are
+ * read in one go. The subscriptions are kept as structure of arrays, so
+ * one tick is a gather of the current values followed by a branch free
+ * compare over all of them.
+ */
+#include <pthread.h>
+#include <string>
+#include <zmq.hpp>
+
+#define SUBSCRIPTION_MAX              4096
+#define SUBSCRIPTION_MAX_READS        1024
+#define SUBSCRIPTION_RATE             50			/* Hz */
+#define SUBSCRIPTION_MERGE_GAP        12			/* bytes, cheaper than another read packet */
+#define SUBSCRIPTION_TABLE_SIZE       80			/* control table bytes */
+#define SUBSCRIPTION_NO_READ          SUBSCRIPTION_MAX_READS	/* never valid */
+
+typedef enum {
+	SUBSCRIPTION_CHANGE,				/* |value-last notified| >= deadband, the first sample always fires */
+	SUBSCRIPTION_ABOVE,					/* value rises above the threshold */
+	SUBSCRIPTION_BELOW,					/* value falls below the threshold */
+	SUBSCRIPTION_MODE_COUNT,
+} subscription_mode_t;
+
+typedef struct {
+	uint8_t														id;
+	uint8_t														start;
+	uint8_t														length;
+	bool															valid;
+	dynamixel_bus_timing_t						timing;
+	uint8_t														data[SUBSCRIPTION_TABLE_SIZE];
+} subscription_read_t;
+
+typedef struct {
+	uint16_t													handle;
+	uint8_t														id;
+	uint8_t														field;
+	int16_t														value;
+	uint64_t													t_reply_ns;
+} subscription_notification_t;
+
+typedef struct {
+	uint32_t													ticks;
+	uint32_t													reads;					/* bus reads done */
+	uint32_t													polls;					/* reads clients would have done, one per subscription */
+	uint32_t													notifications;
+	uint64_t													eval_ns_sum;
+	uint64_t													eval_ns_max;
+} subscription_stats_t;
+
+typedef struct {
+	bool															debug;
+	dynamixel_bus_t*									bus;
+	zmq::socket_t*										socket;
+	uint16_t													rate;
+	pthread_mutex_t										lock;
+	bool															dirty;					/* reads need to be recompiled */
+	uint32_t													tick;
+	uint16_t													count;					/* slots in use are below */
+
+	/* per subscription, indexed by handle, written with lock held */
+	uint8_t														active[SUBSCRIPTION_MAX];
+	uint8_t														id[SUBSCRIPTION_MAX];
+	uint8_t														field[SUBSCRIPTION_MAX];
+	uint8_t														model[SUBSCRIPTION_MAX];
+	uint8_t														mode[SUBSCRIPTION_MAX];
+	int32_t														value[SUBSCRIPTION_MAX];				/* deadband or threshold */
+	uint32_t													interval[SUBSCRIPTION_MAX];			/* ticks */
+	int32_t														last[SUBSCRIPTION_MAX];
+	uint32_t													next[SUBSCRIPTION_MAX];				/* earliest tick for the next notification */
+
+	/* compiled by the poll thread */
+	uint16_t													read_of[SUBSCRIPTION_MAX];
+	uint8_t														offset[SUBSCRIPTION_MAX];
+	uint8_t														size[SUBSCRIPTION_MAX];
+	uint8_t														encoding[SUBSCRIPTION_MAX];
+	uint16_t													read_count;
+	subscription_read_t								reads[SUBSCRIPTION_MAX_READS+1];
+
+	/* evaluation scratch */
+	int32_t														current[SUBSCRIPTION_MAX];
+	uint8_t														sampled[SUBSCRIPTION_MAX];
+	uint8_t														fired[SUBSCRIPTION_MAX];
+	uint16_t													notification_count;
+	subscription_notification_t				notifications[SUBSCRIPTION_MAX];
+
+	subscription_stats_t							stats;
+	pthread_t													thread;
+} subscription_service_t;
+
+bool subscription_init(subscription_service_t* service, dynamixel_bus_t* bus, zmq::context_t* context, const std::string& uri, uint16_t rate);
+/* returns the handle or a negative zmq_error_code_t */
+int16_t subscription_add(subscription_service_t* service, uint8_t id, register_model_t model, register_field_t field, subscription_mode_t mode, int16_t value, uint16_t interval_ms);
+int16_t subscription_remove(subscription_service_t* service, uint16_t handle);
+
+void subscription_compile(subscription_service_t* service);
+void subscription_evaluate(subscription_service_t* service, uint32_t tick);
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef SUBSCRIPTION_COMMANDS_C
+#define SUBSCRIPTION_COMMANDS_C
+
+#include "command.h"
+
+static int16_t command_subscribe(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<id>,<model>,<field>,<mode>,<value>,<min interval ms>
+	//reply:       <err>,<handle>
+	int16_t handle;
+
+	if (!ctx->subscriptions) {
+		return ZMQ_ERR_INVALID_COMMAND;
+	}
+	handle=subscription_add(
+		ctx->subscriptions,
+		(uint8_t)rx_vect[1],
+		(register_model_t)rx_vect[2],
+		(register_field_t)rx_vect[3],
+		(subscription_mode_t)rx_vect[4],
+		rx_vect[5],
+		(uint16_t)rx_vect[6]
+	);
+	if (handle<0) {
+		return handle;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	tx_vect.push_back(handle);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_subscribe_def={
+	DYNAMIXEL_RQ_SUBSCRIBE, "subscribe", command_subscribe, COMMAND_NEEDS_BUS,
+	6, 6, COMMAND_ANY,
+	6, {
+		COMMAND_ID(0, DYNAMIXEL_BUS_MAX_ID-1),
+		COMMAND_VALUE(0, REGISTER_MODEL_COUNT-1),
+		COMMAND_VALUE(0, REGISTER_FIELD_COUNT-1),
+		COMMAND_VALUE(0, SUBSCRIPTION_MODE_COUNT-1),
+		COMMAND_ANY,
+		COMMAND_VALUE(0, INT16_MAX)
+	}
+};
+COMMAND_REGISTER(command_subscribe_def)
+
+static int16_t command_unsubscribe(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect, std::vector<int16_t>& tx_vect) {
+	//zmq-message: <cmd>,<handle>
+	int16_t ret;
+
+	if (!ctx->subscriptions) {
+		return ZMQ_ERR_INVALID_COMMAND;
+	}
+	ret=subscription_remove(ctx->subscriptions, (uint16_t)rx_vect[1]);
+	if (ret) {
+		return ret;
+	}
+	tx_vect.push_back(ZMQ_ERR_NO_ERROR);
+	return ZMQ_ERR_NO_ERROR;
+}
+static const command_t command_unsubscribe_def={
+	DYNAMIXEL_RQ_UNSUBSCRIBE, "unsubscribe", command_unsubscribe, 0,
+	1, 1, COMMAND_ANY,
+	1, {COMMAND_VALUE(0, SUBSCRIPTION_MAX-1)}
+};
+COMMAND_REGISTER(command_unsubscribe_def)
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef SERVO_SIM_C
+#define SERVO_SIM_C
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "servo_sim.h"
+
+static uint64_t servo_sim_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static bool servo_sim_present(servo_sim_t* sim, uint8_t id) {
+	return (id>0) && (id<=sim->servo_count);
+}
+
+static uint16_t servo_sim_table_word(servo_sim_t* sim, uint8_t id, uint8_t address) {
+	return sim->table[id][address]|(sim->table[id][address+1]<<8);
+}
+
+static void servo_sim_table_set_word(servo_sim_t* sim, uint8_t id, uint8_t address, uint16_t value) {
+	sim->table[id][address]=value&0xFF;
+	sim->table[id][address+1]=value>>8;
+}
+
+/* lock held */
+static void servo_sim_write_table(servo_sim_t* sim, uint8_t id, uint8_t address, const uint8_t* data, uint8_t count) {
+	memcpy(&sim->table[id][address], data, count);
+	if ((address<SERVO_SIM_R_GOAL_POSITION+2) && (address+count>SERVO_SIM_R_GOAL_POSITION)) {
+		sim->arrival_ns[id]=0;
+		sim->table[id][SERVO_SIM_R_MOVING]=1;
+		if (!sim->motion) {
+			/* servos without motion reach their goal at once */
+			servo_sim_table_set_word(sim, id, SERVO_SIM_R_PRESENT_POSITION, servo_sim_table_word(sim, id, SERVO_SIM_R_GOAL_POSITION));
+			sim->position[id]=servo_sim_table_word(sim, id, SERVO_SIM_R_GOAL_POSITION);
+			sim->table[id][SERVO_SIM_R_MOVING]=0;
+			sim->arrival_ns[id]=servo_sim_now();
+		}
+	}
+}
+
+static void servo_sim_reply(servo_sim_t* sim, uint8_t id, uint8_t error, const uint8_t* params, uint8_t count) {
+	uint8_t packet[SERVO_SIM_TABLE_SIZE+6];
+	uint8_t checksum;
+	uint64_t t_status;
+
+	packet[0]=0xFF;
+	packet[1]=0xFF;
+	packet[2]=id;
+	packet[3]=count+2;
+	packet[4]=error;
+	checksum=id+packet[3]+error;
+	for (uint8_t i=0; i<count; i++) {
+		packet[5+i]=params[i];
+		checksum+=params[i];
+	}
+	packet[5+count]=~checksum;
+	if (sim->reply_delay_us) {
+		usleep(sim->reply_delay_us);
+	}
+	t_status=servo_sim_now();
+	__atomic_store_n(&sim->t_status_ns, t_status, __ATOMIC_RELEASE);
+	if (write(sim->master, packet, count+6)==count+6) {
+		__atomic_add_fetch(&sim->stats.replies, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/* one complete instruction packet, checksum verified */
+static void servo_sim_execute(servo_sim_t* sim, uint8_t id, uint8_t instruction, const uint8_t* params, uint8_t count) {
+	uint8_t data[SERVO_SIM_TABLE_SIZE];
+	uint8_t reply_count=0;
+	uint8_t error=0;
+	uint8_t level;
+	bool answer;
+
+	if (id==0xFE) {
+		__atomic_add_fetch(&sim->stats.broadcasts, 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_lock(&sim->lock);
+	switch (instruction) {
+		case 0x01:				/* PING */
+			break;
+		case 0x02:				/* READ_DATA */
+			if ((count!=2) || (params[0]+params[1]>SERVO_SIM_TABLE_SIZE)) {
+				error=SERVO_SIM_ERR_RANGE;
+			} else if (servo_sim_present(sim, id)) {
+				memcpy(data, &sim->table[id][params[0]], params[1]);
+				reply_count=params[1];
+			}
+			break;
+		case 0x03:				/* WRITE_DATA */
+		case 0x04:				/* REG_WRITE */
+			if ((count<2) || (params[0]+count-1>SERVO_SIM_TABLE_SIZE)) {
+				error=SERVO_SIM_ERR_RANGE;
+				break;
+			}
+			for (uint8_t i=1; i<=sim->servo_count; i++) {
+				if ((id!=0xFE) && (id!=i)) {
+					continue;
+				}
+				if (instruction==0x03) {
+					servo_sim_write_table(sim, i, params[0], params+1, count-1);
+				} else {
+					memcpy(sim->registered[i], params, count);
+					sim->registered_count[i]=count;
+				}
+			}
+			break;
+		case 0x05:				/* ACTION */
+			for (uint8_t i=1; i<=sim->servo_count; i++) {
+				if (((id==0xFE) || (id==i)) && (sim->registered_count[i])) {
+					servo_sim_write_table(sim, i, sim->registered[i][0], sim->registered[i]+1, sim->registered_count[i]-1);
+					sim->registered_count[i]=0;
+				}
+			}
+			break;
+		case 0x06:				/* RESET */
+			break;
+		case 0x83:				/* SYNC_WRITE: address, length, then id + data per servo */
+			if ((count<2) || (params[0]+params[1]>SERVO_SIM_TABLE_SIZE) || ((count-2)%(params[1]+1))) {
+				error=SERVO_SIM_ERR_RANGE;
+				break;
+			}
+			for (const uint8_t* entry=params+2; entry<params+count; entry+=params[1]+1) {
+				if (servo_sim_present(sim, entry[0])) {
+					servo_sim_write_table(sim, entry[0], params[0], entry+1, params[1]);
+				}
+			}
+			break;
+		default:
+			error=SERVO_SIM_ERR_INSTRUCTION;
+	}
+	answer=false;
+	if ((id!=0xFE) && servo_sim_present(sim, id)) {
+		/* the level after this very packet, a write to it answers at the new level */
+		level=sim->table[id][SERVO_SIM_R_STATUS_RETURN];
+		answer=(instruction==0x01) || ((instruction==0x02) && (level>=1)) || (level>=2);
+	}
+	pthread_mutex_unlock(&sim->lock);
+	if (answer) {
+		servo_sim_reply(sim, id, error, data, reply_count);
+	}
+}
+
+static void* servo_sim_thread(void* arg) {
+	servo_sim_t* sim=(servo_sim_t*)arg;
+	uint8_t buffer[256];
+	uint8_t packet[SERVO_SIM_TABLE_SIZE+256];
+	uint8_t state=0;
+	uint8_t length=0;
+	uint8_t fill=0;
+	uint8_t checksum=0;
+	struct pollfd pfd;
+	ssize_t count;
+
+	pfd.fd=sim->master;
+	pfd.events=POLLIN;
+	while (sim->running) {
+		if (poll(&pfd, 1, 10)<=0) {
+			continue;
+		}
+		count=read(sim->master, buffer, sizeof(buffer));
+		for (ssize_t i=0; i<count; i++) {
+			uint8_t byte=buffer[i];
+			switch (state) {
+				case 0:
+					if (byte==0xFF) {
+						state=1;
+					} else {
+						__atomic_add_fetch(&sim->stats.stray_bytes, 1, __ATOMIC_RELAXED);
+					}
+					break;
+				case 1:
+					if (byte==0xFF) {
+						state=2;
+					} else {
+						__atomic_add_fetch(&sim->stats.stray_bytes, 2, __ATOMIC_RELAXED);
+						state=0;
+					}
+					break;
+				case 2:
+					if (byte!=0xFF) {
+						packet[0]=byte;
+						checksum=byte;
+						state=3;
+					}
+					break;
+				case 3:
+					if (byte<2) {
+						__atomic_add_fetch(&sim->stats.stray_bytes, 4, __ATOMIC_RELAXED);
+						state=0;
+						break;
+					}
+					length=byte;
+					checksum+=byte;
+					fill=0;
+					state=4;
+					break;
+				case 4:
+					/* instruction, parameters */
+					packet[1+fill++]=byte;
+					checksum+=byte;
+					if (fill==length-1) {
+						state=5;
+					}
+					break;
+				case 5:
+					state=0;
+					__atomic_add_fetch(&sim->stats.packets, 1, __ATOMIC_RELAXED);
+					if ((uint8_t)~checksum!=byte) {
+						__atomic_add_fetch(&sim->stats.checksum_errors, 1, __ATOMIC_RELAXED);
+						break;
+					}
+					servo_sim_execute(sim, packet[0], packet[1], packet+2, length-2);
+					break;
+			}
+		}
+	}
+	return NULL;
+}
+
+/* the present position follows the goal at the moving speed, 0 is full speed */
+static void* servo_sim_motion_thread(void* arg) {
+	servo_sim_t* sim=(servo_sim_t*)arg;
+	uint64_t t_last=servo_sim_now();
+	uint64_t t_now;
+	float dt;
+
+	while (sim->running) {
+		usleep(SERVO_SIM_MOTION_PERIOD_US);
+		/* the sleep may take longer than asked for, move by the time that passed */
+		t_now=servo_sim_now();
+		dt=(t_now-t_last)/1e9f;
+		t_last=t_now;
+		pthread_mutex_lock(&sim->lock);
+		for (uint8_t id=1; id<=sim->servo_count; id++) {
+			if (!sim->table[id][SERVO_SIM_R_MOVING]) {
+				continue;
+			}
+			float goal=servo_sim_table_word(sim, id, SERVO_SIM_R_GOAL_POSITION);
+			uint16_t speed=servo_sim_table_word(sim, id, SERVO_SIM_R_MOVING_SPEED)&0x3FF;
+			float step=(speed ? speed : 0x3FF)*SERVO_SIM_TICKS_PER_UNIT*dt;
+
+			if (fabsf(goal-sim->position[id])<=step) {
+				sim->position[id]=goal;
+				sim->table[id][SERVO_SIM_R_MOVING]=0;
+				sim->arrival_ns[id]=servo_sim_now();
+			} else {
+				sim->position[id]+=(goal>sim->position[id]) ? step : -step;
+			}
+			servo_sim_table_set_word(sim, id, SERVO_SIM_R_PRESENT_POSITION, (uint16_t)lroundf(sim->position[id]));
+		}
+		pthread_mutex_unlock(&sim->lock);
+	}
+	return NULL;
+}
+
+/* servos start centred, answering everything, at full speed */
+int servo_sim_start(servo_sim_t* sim, uint8_t servo_count, bool motion) {
+	struct termios tio;
+
+	memset(sim, 0, sizeof(*sim));
+	if (servo_count>=SERVO_SIM_MAX_ID) {
+		return -1;
+	}
+	if (openpty(&sim->master, &sim->slave, sim->device, NULL, NULL)!=0) {
+		return -1;
+	}
+	tcgetattr(sim->master, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(sim->master, TCSANOW, &tio);
+	fcntl(sim->master, F_SETFL, fcntl(sim->master, F_GETFL)|O_NONBLOCK);
+
+	sim->servo_count=servo_count;
+	sim->motion=motion;
+	for (uint8_t id=1; id<=servo_count; id++) {
+		sim->table[id][3]=id;
+		sim->table[id][SERVO_SIM_R_STATUS_RETURN]=2;
+		servo_sim_table_set_word(sim, id, SERVO_SIM_R_GOAL_POSITION, 512);
+		servo_sim_table_set_word(sim, id, SERVO_SIM_R_PRESENT_POSITION, 512);
+		sim->position[id]=512;
+	}
+	pthread_mutex_init(&sim->lock, NULL);
+	sim->running=true;
+	pthread_create(&sim->thread, NULL, servo_sim_thread, sim);
+	if (motion) {
+		pthread_create(&sim->motion_thread, NULL, servo_sim_motion_thread, sim);
+	}
+	return 0;
+}
+
+void servo_sim_stop(servo_sim_t* sim) {
+	sim->running=false;
+	pthread_join(sim->thread, NULL);
+	if (sim->motion) {
+		pthread_join(sim->motion_thread, NULL);
+	}
+	pthread_mutex_destroy(&sim->lock);
+	close(sim->slave);
+	close(sim->master);
+}
+
+uint16_t servo_sim_word(servo_sim_t* sim, uint8_t id, uint8_t address) {
+	uint16_t value;
+
+	pthread_mutex_lock(&sim->lock);
+	value=servo_sim_table_word(sim, id, address);
+	pthread_mutex_unlock(&sim->lock);
+	return value;
+}
+
+void servo_sim_set_word(servo_sim_t* sim, uint8_t id, uint8_t address, uint16_t value) {
+	pthread_mutex_lock(&sim->lock);
+	servo_sim_table_set_word(sim, id, address, value);
+	if (address==SERVO_SIM_R_PRESENT_POSITION) {
+		sim->position[id]=value;
+	}
+	pthread_mutex_unlock(&sim->lock);
+}
+
+void servo_sim_get_stats(servo_sim_t* sim, servo_sim_stats_t* stats) {
+	stats->packets=__atomic_load_n(&sim->stats.packets, __ATOMIC_RELAXED);
+	stats->replies=__atomic_load_n(&sim->stats.replies, __ATOMIC_RELAXED);
+	stats->checksum_errors=__atomic_load_n(&sim->stats.checksum_errors, __ATOMIC_RELAXED);
+	stats->stray_bytes=__atomic_load_n(&sim->stats.stray_bytes, __ATOMIC_RELAXED);
+	stats->broadcasts=__atomic_load_n(&sim->stats.broadcasts, __ATOMIC_RELAXED);
+}
+
+uint64_t servo_sim_status_time(servo_sim_t* sim) {
+	return __atomic_load_n(&sim->t_status_ns, __ATOMIC_ACQUIRE);
+}
+
+/* the native transport on the simulated bus, with room for scheduling delays */
+int servo_sim_connect(servo_sim_t* sim, dynamixel_serial_t* port) {
+	memset(port, 0, sizeof(*port));
+	if (dynamixel_serial_open(port, sim->device, 1000000)!=0) {
+		return -1;
+	}
+	port->margin_us=SERVO_SIM_MARGIN_US;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef SERVO_SIM_H
+#define SERVO_SIM_H
+
+/*
+ * Simulated AX servos behind a pseudo terminal, for the native transport.
+ *
+ * The simulation parses protocol 1.0 instruction packets on the master
+ * side, keeps a control table per servo and answers like a servo would,
+ * following the status return level in register 16 and a configurable
+ * return delay. With motion enabled the present position moves towards
+ * the goal at the moving speed (AX units) and the time each servo arrives
+ * is recorded.
+ *
+ * The transport never sends anything outside a packet, so stray bytes and
+ * checksum errors seen here mean packets were interleaved on the wire.
+ */
+#include <pthread.h>
+#include <stdint.h>
+
+#define SERVO_SIM_MAX_ID                32
+#define SERVO_SIM_TABLE_SIZE            74
+#define SERVO_SIM_R_STATUS_RETURN       16
+#define SERVO_SIM_R_GOAL_POSITION       30
+#define SERVO_SIM_R_MOVING_SPEED        32
+#define SERVO_SIM_R_PRESENT_POSITION    36
+#define SERVO_SIM_R_MOVING              46
+#define SERVO_SIM_TICKS_PER_UNIT        (0.111f*6.0f*1023.0f/300.0f)	/* ticks/s per moving speed unit */
+#define SERVO_SIM_MOTION_PERIOD_US      250
+#define SERVO_SIM_MARGIN_US             50000	/* the simulation is a thread, it may be scheduled late */
+
+/* servo error bits */
+#define SERVO_SIM_ERR_RANGE             0x08
+#define SERVO_SIM_ERR_INSTRUCTION       0x40
+
+typedef struct {
+	uint32_t													packets;
+	uint32_t													replies;
+	uint32_t													checksum_errors;
+	uint32_t													stray_bytes;			/* outside of any packet */
+	uint32_t													broadcasts;
+} servo_sim_stats_t;
+
+typedef struct {
+	int																master;
+	int																slave;
+	char															device[64];
+	uint8_t														servo_count;			/* ids 1..servo_count answer */
+	uint32_t													reply_delay_us;		/* before each status packet */
+	bool															motion;
+	volatile bool											running;
+
+	pthread_mutex_t										lock;
+	uint8_t														table[SERVO_SIM_MAX_ID][SERVO_SIM_TABLE_SIZE];
+	uint8_t														registered[SERVO_SIM_MAX_ID][SERVO_SIM_TABLE_SIZE+1];	/* address, then data */
+	uint8_t														registered_count[SERVO_SIM_MAX_ID];
+	float															position[SERVO_SIM_MAX_ID];				/* ticks, fractional */
+	uint64_t													arrival_ns[SERVO_SIM_MAX_ID];			/* goal reached, 0 while moving */
+	uint64_t													t_status_ns;			/* write() of the last status packet */
+	servo_sim_stats_t									stats;
+
+	pthread_t													thread;
+	pthread_t													motion_thread;
+} servo_sim_t;
+
+int servo_sim_start(servo_sim_t* sim, uint8_t servo_count, bool motion);
+void servo_sim_stop(servo_sim_t* sim);
+uint16_t servo_sim_word(servo_sim_t* sim, uint8_t id, uint8_t address);
+void servo_sim_set_word(servo_sim_t* sim, uint8_t id, uint8_t address, uint16_t value);
+void servo_sim_get_stats(servo_sim_t* sim, servo_sim_stats_t* stats);
+uint64_t servo_sim_status_time(servo_sim_t* sim);
+int servo_sim_connect(servo_sim_t* sim, dynamixel_serial_t* port);
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+#ifndef TEST_H
+#define TEST_H
+
+/*
+ * Tests and benchmarks pull in the service sources the same way
+ * dynamixel_zmq.cpp does, so static functions can be tested directly.
+ * A test is a plain executable, it prints what failed and exits with 1.
+ */
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <math.h>
+
+#include <msgpack.hpp>
+#include <vector>
+#include <zmq.hpp>
+
+#include <dynamixel.h>
+#include <dynamixel-rtu.h>
+
+#include "config.h"
+#include "dynamixel_zmq.h"
+
+#include "dynamixel_serial.h"
+#include "dynamixel_serial.c"
+
+#include "dynamixel_bus.h"
+#include "dynamixel_bus.c"
+
+#include "calibration.h"
+#include "calibration.c"
+
+#include "register_map.h"
+#include "register_map.c"
+
+#include "dynamixel_shm_service.h"
+#include "dynamixel_shm_service.c"
+
+#include "subscription.h"
+#include "subscription.c"
+
+#ifdef ENABLE_PYPOSE_COMMANDS
+#include "pypose.h"
+#include "pypose_player.h"
+#include "pypose.c"
+#include "pypose_player.c"
+#endif
+
+#ifdef ENABLE_GAIT_ENGINE
+#include "gait.h"
+#include "gait.c"
+#endif
+
+#include "command.h"
+#include "command.c"
+#include "dynamixel_commands.c"
+#include "subscription_commands.c"
+#ifdef ENABLE_PYPOSE_COMMANDS
+#include "pypose_commands.c"
+#endif
+#ifdef ENABLE_GAIT_ENGINE
+#include "gait_commands.c"
+#endif
+
+static int test_failures=0;
+
+#define CHECK(condition) do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(a, b) do { \
+		long long _a=(long long)(a); \
+		long long _b=(long long)(b); \
+		if (_a!=_b) { \
+			fprintf(stderr, "%s:%d: CHECK_EQUAL(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(a, b, tolerance) do { \
+		double _a=(double)(a); \
+		double _b=(double)(b); \
+		if (!(fabs(_a-_b)<=(tolerance))) { \
+			fprintf(stderr, "%s:%d: CHECK_NEAR(%s, %s) failed: %g != %g\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+			test_failures++; \
+		} \
+	} while (0)
+
+static inline uint64_t test_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+/* a command context without any bus traffic, handlers needing the bus see it offline */
+static inline void test_command_ctx(command_ctx_t* ctx, dynamixel_bus_t* bus, calibration_t* calibration) {
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->bus=bus;
+	ctx->bus_online=(bus!=NULL);
+	ctx->calibration=calibration;
+}
+
+static inline int test_result(const char* name) {
+	if (test_failures) {
+		fprintf(stderr, "%s: %d checks failed\n", name, test_failures);
+		return 1;
+	}
+	printf("%s: ok\n", name);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The request loop, raw bus clients and the sequence player (or a 100Hz
+ * priority writer without pypose) share one bus to simulated servos.
+ * Every client writes random goals to its own servo and reads them back,
+ * a single interleaved packet shows up as a mismatch, a checksum error or
+ * stray bytes at the servos. Also prints how long a player tick waits for
+ * the bus with and without the other traffic.
+ */
+#include "test.h"
+#include "servo_sim.c"
+
+#define TEST_BUS_SERVOS             18
+#define TEST_BUS_PLAYER_SERVOS      12			/* 1..12, the clients own the rest */
+#define TEST_BUS_CLIENTS            4
+#define TEST_BUS_PHASE_MS           1500
+
+typedef struct {
+	dynamixel_bus_t*				bus;
+	command_ctx_t*					ctx;				/* dispatch through the request loop, NULL for raw bus calls */
+	uint8_t									id;
+	volatile bool*					stop;
+	uint32_t								rounds;
+	uint32_t								mismatches;
+	uint32_t								errors;
+} test_bus_client_t;
+
+static void* test_bus_client(void* arg) {
+	test_bus_client_t* client=(test_bus_client_t*)arg;
+	unsigned int seed=client->id;
+	std::vector<int16_t> rx_vect;
+	std::vector<int16_t> tx_vect;
+	uint8_t data[2];
+	uint16_t value;
+
+	while (!*client->stop) {
+		value=rand_r(&seed)&0x3FF;
+		data[0]=value&0xFF;
+		data[1]=value>>8;
+		if (client->ctx) {
+			rx_vect={DYNAMIXEL_RQ_WRITE_DATA, client->id, SERVO_SIM_R_GOAL_POSITION, 2, data[0], data[1]};
+			tx_vect.clear();
+			if ((command_dispatch(client->ctx, rx_vect, tx_vect)!=ZMQ_ERR_NO_ERROR) || (tx_vect[1]<0)) {
+				client->errors++;
+				continue;
+			}
+			rx_vect={DYNAMIXEL_RQ_READ_DATA, client->id, SERVO_SIM_R_GOAL_POSITION, 2};
+			tx_vect.clear();
+			if ((command_dispatch(client->ctx, rx_vect, tx_vect)!=ZMQ_ERR_NO_ERROR) || (tx_vect.size()!=3)) {
+				client->errors++;
+				continue;
+			}
+			data[0]=tx_vect[1];
+			data[1]=tx_vect[2];
+		} else {
+			if (dynamixel_bus_write_data(client->bus, client->id, (dynamixel_register_t)SERVO_SIM_R_GOAL_POSITION, 2, data)<0) {
+				client->errors++;
+				continue;
+			}
+			data[0]=data[1]=0xFF;
+			if (dynamixel_bus_read_data(client->bus, client->id, (dynamixel_register_t)SERVO_SIM_R_GOAL_POSITION, 2, data)!=2) {
+				client->errors++;
+				continue;
+			}
+		}
+		if ((data[0]|(data[1]<<8))!=value) {
+			client->mismatches++;
+		}
+		client->rounds++;
+	}
+	return NULL;
+}
+
+#ifndef ENABLE_PYPOSE_COMMANDS
+/* stands in for the player: goals of servos 1..12 at 100Hz from the priority queue */
+static void* test_bus_ticker(void* arg) {
+	test_bus_client_t* ticker=(test_bus_client_t*)arg;
+	uint16_t data[TEST_BUS_PLAYER_SERVOS*2];
+
+	while (!*ticker->stop) {
+		for (uint8_t i=0; i<TEST_BUS_PLAYER_SERVOS; i++) {
+			data[i*2]=i+1;
+			data[i*2+1]=(ticker->rounds&1) ? 300 : 700;
+		}
+		if (dynamixel_bus_sync_write_words(ticker->bus, (dynamixel_register_t)SERVO_SIM_R_GOAL_POSITION, TEST_BUS_PLAYER_SERVOS, 1, data, true)<0) {
+			ticker->errors++;
+		}
+		ticker->rounds++;
+		usleep(1000000/100);
+	}
+	return NULL;
+}
+#endif
+
+/* the max is a running max, it is cleared so each phase reports its own */
+static void test_bus_phase_start(dynamixel_bus_t* bus, dynamixel_bus_stats_t* before) {
+	__atomic_store_n(&bus->stats.priority_wait_ns_max, 0, __ATOMIC_RELAXED);
+	*before=bus->stats;
+}
+
+static void test_bus_tick_latency(dynamixel_bus_t* bus, const dynamixel_bus_stats_t* before, const char* label) {
+	uint32_t ticks=__atomic_load_n(&bus->stats.priority_transactions, __ATOMIC_RELAXED)-before->priority_transactions;
+	uint64_t wait_ns=__atomic_load_n(&bus->stats.priority_wait_ns_sum, __ATOMIC_RELAXED)-before->priority_wait_ns_sum;
+	uint64_t wait_max_ns=__atomic_load_n(&bus->stats.priority_wait_ns_max, __ATOMIC_RELAXED);
+
+	CHECK(ticks>0);
+	printf("tick latency %s: %u ticks, avg wait %lluus, max wait %lluus\n", label, ticks,
+		(unsigned long long)(ticks ? wait_ns/ticks/1000 : 0),
+		(unsigned long long)wait_max_ns/1000);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	servo_sim_stats_t sim_stats;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	calibration_t calibration;
+	command_ctx_t ctx;
+	dynamixel_bus_stats_t before;
+	test_bus_client_t clients[TEST_BUS_CLIENTS+1];
+	test_bus_client_t ticker;
+	pthread_t threads[TEST_BUS_CLIENTS+1];
+	volatile bool stop=false;
+	volatile bool stop_ticker=false;
+
+	CHECK_EQUAL(servo_sim_start(&sim, TEST_BUS_SERVOS, false), 0);
+	CHECK_EQUAL(servo_sim_connect(&sim, &serial), 0);
+	if (test_failures) {
+		return test_result("test_bus");
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, &bus, &calibration);
+
+	memset(&ticker, 0, sizeof(ticker));
+	ticker.bus=&bus;
+	ticker.stop=&stop_ticker;
+#ifdef ENABLE_PYPOSE_COMMANDS
+	pthread_t player_thread;
+	pypose_player_ctx_t player;
+	std::vector<int16_t> rx_vect;
+	std::vector<int16_t> tx_vect;
+
+	pypose_library_init();
+	player.debug=false;
+	player.bus=&bus;
+	pypose_player_init(&player_thread, &player);
+	ctx.player=&player;
+	/* two poses of servos 1..12, looped every 10ms */
+	rx_vect={PYPOSE_LOAD_LIBRARY, PYPOSE_ID, TEST_BUS_PLAYER_SERVOS, 2};
+	for (uint8_t pose=0; pose<2; pose++) {
+		rx_vect.push_back(pose);
+		for (uint8_t i=0; i<TEST_BUS_PLAYER_SERVOS; i++) {
+			rx_vect.push_back(pose ? 700 : 300);
+		}
+	}
+	rx_vect.insert(rx_vect.end(), {1, 0, 2, 0, 10, 1, 10});
+	CHECK_EQUAL(command_dispatch(&ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	tx_vect.clear();
+	rx_vect={PYPOSE_LOOP_SEQUENCE, PYPOSE_ID, 0};
+	CHECK_EQUAL(command_dispatch(&ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+#else
+	pthread_t ticker_thread;
+	pthread_create(&ticker_thread, NULL, test_bus_ticker, &ticker);
+#endif
+
+	/* the player alone */
+	usleep(200000);
+	test_bus_phase_start(&bus, &before);
+	usleep(TEST_BUS_PHASE_MS*1000);
+	test_bus_tick_latency(&bus, &before, "alone");
+
+	/* and with every client hammering the bus */
+	memset(clients, 0, sizeof(clients));
+	for (uint8_t c=0; c<=TEST_BUS_CLIENTS; c++) {
+		clients[c].bus=&bus;
+		clients[c].ctx=(c==TEST_BUS_CLIENTS) ? &ctx : NULL;
+		clients[c].id=TEST_BUS_PLAYER_SERVOS+1+c;
+		clients[c].stop=&stop;
+		pthread_create(&threads[c], NULL, test_bus_client, &clients[c]);
+	}
+	test_bus_phase_start(&bus, &before);
+	usleep(TEST_BUS_PHASE_MS*1000);
+	test_bus_tick_latency(&bus, &before, "loaded");
+	stop=true;
+	for (uint8_t c=0; c<=TEST_BUS_CLIENTS; c++) {
+		pthread_join(threads[c], NULL);
+		CHECK(clients[c].rounds>0);
+		CHECK_EQUAL(clients[c].mismatches, 0);
+		CHECK_EQUAL(clients[c].errors, 0);
+	}
+
+#ifdef ENABLE_PYPOSE_COMMANDS
+	pypose_player_stop_all(&player);
+#else
+	stop_ticker=true;
+	pthread_join(ticker_thread, NULL);
+	CHECK_EQUAL(ticker.errors, 0);
+#endif
+	usleep(50000);
+	for (uint8_t id=1; id<=TEST_BUS_PLAYER_SERVOS; id++) {
+		uint16_t goal=servo_sim_word(&sim, id, SERVO_SIM_R_GOAL_POSITION);
+		CHECK((goal==300) || (goal==700));
+	}
+
+	servo_sim_get_stats(&sim, &sim_stats);
+	printf("%u packets, %u replies, %u transactions\n", sim_stats.packets, sim_stats.replies, bus.stats.transactions);
+	CHECK_EQUAL(sim_stats.checksum_errors, 0);
+	CHECK_EQUAL(sim_stats.stray_bytes, 0);
+	CHECK_EQUAL(serial.stats.checksum_errors, 0);
+	CHECK_EQUAL(serial.stats.timeouts, 0);
+
+	servo_sim_stop(&sim);
+	return test_result("test_bus");
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* raw <-> engineering unit conversions, scale per model and round trips */
+#include "test.h"
+
+#define TEST_CALIBRATION_FILE       "test_calibration.conf"
+
+static void test_calibration_scale(void) {
+	calibration_t calibration;
+	uint8_t ids[3]={1, 2, 3};
+	uint16_t ticks[3]={0, 512, 1023};
+	uint16_t back[3];
+	float rad[3];
+
+	calibration_init(&calibration);
+	/* AX: 0..1023 over 300 degree, centred at 512 */
+	calibration_ticks_to_rad(&calibration, ids, ticks, rad, 3);
+	CHECK_NEAR(rad[0], -512.0*300.0/1023.0*M_PI/180.0, 1e-5);
+	CHECK_NEAR(rad[1], 0.0, 1e-6);
+	CHECK_NEAR(rad[2], 511.0*300.0/1023.0*M_PI/180.0, 1e-5);
+
+	/* MX: 4096 steps per turn, a quarter turn is 1024 ticks */
+	calibration_set(&calibration, 1, CALIBRATION_MODEL_MX, 0.0f, 1, -M_PI, M_PI);
+	calibration_set(&calibration, 2, CALIBRATION_MODEL_MX, 0.0f, 1, -M_PI, M_PI);
+	calibration_set(&calibration, 3, CALIBRATION_MODEL_MX, 0.0f, 1, -M_PI, M_PI);
+	rad[0]=-M_PI/2;
+	rad[1]=M_PI/2;
+	rad[2]=M_PI/4;
+	calibration_rad_to_ticks(&calibration, ids, rad, back, 3);
+	CHECK_EQUAL(back[0], 1024);
+	CHECK_EQUAL(back[1], 3072);
+	CHECK_EQUAL(back[2], 2560);
+	CHECK_NEAR(calibration.tick_scale[1], 4096.0/(2.0*M_PI), 1e-3);
+	ticks[0]=0;
+	ticks[1]=4095;
+	calibration_ticks_to_rad(&calibration, ids, ticks, rad, 2);
+	CHECK_NEAR(rad[0], -M_PI, 1e-5);
+	CHECK_NEAR(rad[1], M_PI-2.0*M_PI/4096.0, 1e-5);
+
+	/* limits clamp before the conversion */
+	calibration_set(&calibration, 1, CALIBRATION_MODEL_AX, 0.0f, 1, -0.5f, 0.5f);
+	rad[0]=1.0f;
+	calibration_rad_to_ticks(&calibration, ids, rad, back, 1);
+	CHECK_EQUAL(back[0], 512+(int)lroundf(0.5f*1023.0f/(300.0f*M_PI/180.0f)));
+}
+
+/* every register value survives ticks -> rad -> ticks, also mirrored and offset */
+static void test_calibration_round_trip(calibration_model_t model, uint16_t ticks_count, float offset, int8_t sign) {
+	calibration_t calibration;
+	uint8_t ids[CALIBRATION_MAX_BATCH];
+	uint16_t ticks[CALIBRATION_MAX_BATCH];
+	uint16_t back[CALIBRATION_MAX_BATCH];
+	float rad[CALIBRATION_MAX_BATCH];
+	uint8_t count;
+
+	calibration_init(&calibration);
+	calibration_set(&calibration, 7, model, offset, sign, -10.0f, 10.0f);
+	memset(ids, 7, sizeof(ids));
+	for (uint16_t start=0; start<ticks_count; start+=count) {
+		count=std::min<uint16_t>(CALIBRATION_MAX_BATCH, ticks_count-start);
+		for (uint8_t i=0; i<count; i++) {
+			ticks[i]=start+i;
+		}
+		calibration_ticks_to_rad(&calibration, ids, ticks, rad, count);
+		calibration_rad_to_ticks(&calibration, ids, rad, back, count);
+		for (uint8_t i=0; i<count; i++) {
+			CHECK_EQUAL(back[i], ticks[i]);
+		}
+	}
+}
+
+static void test_calibration_speed(void) {
+	calibration_t calibration;
+	uint8_t ids[1]={1};
+	uint16_t speed[1];
+	uint16_t back[1];
+	float rad_s[1];
+
+	calibration_init(&calibration);
+	for (speed[0]=1; speed[0]<=1023; speed[0]++) {
+		calibration_speed_to_rad_s(&calibration, ids, speed, rad_s, 1);
+		calibration_rad_s_to_speed(&calibration, ids, rad_s, back, 1);
+		CHECK_EQUAL(back[0], speed[0]);
+	}
+	/* bit 10 is the direction */
+	speed[0]=0x400|100;
+	calibration_speed_to_rad_s(&calibration, ids, speed, rad_s, 1);
+	CHECK_NEAR(rad_s[0], -100*0.111*2.0*M_PI/60.0, 1e-4);
+}
+
+static void test_calibration_file(void) {
+	calibration_t calibration;
+	std::ofstream file(TEST_CALIBRATION_FILE);
+
+	file << "# id  model  offset  sign  min     max\n";
+	file << "   1  AX     0.0     1     -150.0  150.0\n";
+	file << "   2  MX     -12.5   -1    -90.0   90.0\n";
+	file.close();
+	calibration_init(&calibration);
+	CHECK(calibration_load(&calibration, TEST_CALIBRATION_FILE, false));
+	CHECK_EQUAL(calibration.model[2], CALIBRATION_MODEL_MX);
+	CHECK_NEAR(calibration.tick_scale[2], -4096.0/(2.0*M_PI), 1e-3);
+	CHECK_NEAR(calibration.offset[2], -12.5*M_PI/180.0, 1e-6);
+	CHECK_NEAR(calibration.max[2], M_PI/2, 1e-6);
+
+	file.open(TEST_CALIBRATION_FILE);
+	file << "3 XL 0 1 0 0\n";
+	file.close();
+	CHECK(!calibration_load(&calibration, TEST_CALIBRATION_FILE, false));
+	unlink(TEST_CALIBRATION_FILE);
+}
+
+int main(int argc, char** argv) {
+	test_calibration_scale();
+	test_calibration_round_trip(CALIBRATION_MODEL_AX, 1024, 0.0f, 1);
+	test_calibration_round_trip(CALIBRATION_MODEL_AX, 1024, 0.2f, -1);
+	test_calibration_round_trip(CALIBRATION_MODEL_MX, 4096, 0.0f, 1);
+	test_calibration_round_trip(CALIBRATION_MODEL_MX, 4096, -0.3f, -1);
+	test_calibration_speed();
+	test_calibration_file();
+	return test_result("test_calibration");
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* argument schemas and validator hooks, checked through command_dispatch with the bus offline */
+#include "test.h"
+
+static int16_t test_command(command_ctx_t* ctx, std::initializer_list<int16_t> message) {
+	std::vector<int16_t> rx_vect(message);
+	std::vector<int16_t> tx_vect;
+	return command_dispatch(ctx, rx_vect, tx_vect);
+}
+
+static void test_command_schema(command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect;
+	std::vector<int16_t> tx_vect;
+
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_INVALID_FORMAT);
+	CHECK_EQUAL(test_command(ctx, {0x7FFF}), ZMQ_ERR_INVALID_COMMAND);
+	/* a valid message only fails for the missing bus */
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_PING, 1}), ZMQ_ERR_BUS_OFFLINE);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_PING}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_READ_DATA, 1, 30, DYNAMIXEL_MAX_PARAMETER_COUNT+1}), ZMQ_ERR_INVALID_PARAMETERS);
+	/* commands without the bus run */
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_ZMQ_ECHO, 1, 2, 3}), ZMQ_ERR_NO_ERROR);
+}
+
+static void test_command_validators(command_ctx_t* ctx) {
+	/* write_data: <count> promises 3 bytes, 2 follow */
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_WRITE_DATA, 1, 30, 2, 0x00, 0x02}), ZMQ_ERR_BUS_OFFLINE);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_WRITE_DATA, 1, 30, 3, 0x00, 0x02}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_REG_WRITE, 1, 30, 3, 0x00, 0x02}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+
+	/* sync_write: 2 ids with 2 bytes each */
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_SYNC_WRITE, 30, 2, 2, 1, 0x00, 0x02, 2, 0x00, 0x02}), ZMQ_ERR_BUS_OFFLINE);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_SYNC_WRITE, 30, 2, 2, 1, 0x00, 0x02, 2, 0x00}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_SYNC_WRITE_WORDS, 30, 2, 1, 1, 512, 2}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+
+	/* unit_sync_write: groups of id, mrad and mrad/s */
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_UNIT_SYNC_WRITE, 2, 1, 100, 500, 2, -100, 500}), ZMQ_ERR_BUS_OFFLINE);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_UNIT_SYNC_WRITE, 2, 1, 100, 500, 2, -100}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_UNIT_SYNC_WRITE, 1, 1, 100, 500, 2, -100, 500}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_UNIT_SYNC_WRITE, 2, 1, 100, 500, CALIBRATION_MAX_ID, -100, 500}), ZMQ_ERR_INVALID_ID);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_UNIT_SYNC_WRITE, 2, -1, 100, 500, 2, -100, 500}), ZMQ_ERR_INVALID_ID);
+
+	/* read_fields: every field must exist on the model, CURRENT is MX-64 only */
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_READ_FIELDS, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION}), ZMQ_ERR_BUS_OFFLINE);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_READ_FIELDS, 1, REGISTER_MODEL_MX64, REGISTER_FIELD_CURRENT}), ZMQ_ERR_BUS_OFFLINE);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_READ_FIELDS, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_CURRENT}), ZMQ_ERR_INVALID_PARAMETERS);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_READ_FIELDS_TIMED, 1, REGISTER_MODEL_MX28, REGISTER_FIELD_CW_COMPLIANCE_SLOPE}), ZMQ_ERR_INVALID_PARAMETERS);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_READ_FIELDS, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_COUNT}), ZMQ_ERR_INVALID_PARAMETERS);
+
+	/* move_sync: duration, then pairs of id and goal */
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_MOVE_SYNC, 500, 1, 100, 2, -100}), ZMQ_ERR_BUS_OFFLINE);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_MOVE_SYNC, 500, 1, 100, 2}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	CHECK_EQUAL(test_command(ctx, {DYNAMIXEL_RQ_MOVE_SYNC, 500, 1, 100, CALIBRATION_MAX_ID, -100}), ZMQ_ERR_INVALID_ID);
+}
+
+#ifdef ENABLE_PYPOSE_COMMANDS
+static void test_command_pypose_validators(command_ctx_t* ctx) {
+	CHECK_EQUAL(test_command(ctx, {PYPOSE_SET_POSESIZE, PYPOSE_ID, 2}), ZMQ_ERR_NO_ERROR);
+	/* load_pose: two bytes per servo of the pose size */
+	CHECK_EQUAL(test_command(ctx, {PYPOSE_LOAD_POSE, PYPOSE_ID, 0, 0x00, 0x02, 0x00, 0x02}), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_command(ctx, {PYPOSE_LOAD_POSE, PYPOSE_ID, 0, 0x00, 0x02, 0x00}), ZMQ_ERR_INVALID_PARAMETERS);
+	CHECK_EQUAL(test_command(ctx, {PYPOSE_LOAD_POSE, PYPOSE_ID, 0, 0x00, 0x02, 0x00, 0x02, 0x00, 0x02}), ZMQ_ERR_INVALID_PARAMETERS);
+
+	/* load_sequence: parts of pose id and delay */
+	CHECK_EQUAL(test_command(ctx, {PYPOSE_LOAD_SEQUENCE, PYPOSE_ID, 0, 0xE8, 0x03}), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_command(ctx, {PYPOSE_LOAD_SEQUENCE, PYPOSE_ID, 0, 0xE8, 0x03, 1}), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	CHECK_EQUAL(test_command(ctx, {PYPOSE_LOAD_SEQUENCE, PYPOSE_ID, 0, 0xE8, 0x03, PYPOSE_MAX_POSE_COUNT, 0xE8, 0x03}), ZMQ_ERR_INVALID_PARAMETERS);
+}
+#endif
+
+int main(int argc, char** argv) {
+	command_ctx_t ctx;
+	calibration_t calibration;
+
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, NULL, &calibration);
+	test_command_schema(&ctx);
+	test_command_validators(&ctx);
+#ifdef ENABLE_PYPOSE_COMMANDS
+	pypose_player_ctx_t player;
+
+	/* a player without a thread, never running */
+	pypose_library_init();
+	memset(&player, 0, sizeof(player));
+	ctx.player=&player;
+	test_command_pypose_validators(&ctx);
+#endif
+	return test_result("test_command");
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* leg IK against reference values and against its own forward kinematics */
+#include "test.h"
+
+#define TEST_GAIT_TOLERANCE         1e-4		/* rad */
+#define TEST_GAIT_FK_TOLERANCE      0.05		/* mm */
+
+/* solves one leg where the foot sits at leg-frame (118, 0, z) and compares */
+static void test_gait_reference(float body_z, double femur, double tibia) {
+	gait_config_t config;
+	gait_command_t command;
+	gait_vec_t foot;
+	gait_joints_t joints;
+
+	gait_config_default(&config);
+	memset(&command, 0, sizeof(command));
+	memset(&foot, 0, sizeof(foot));
+	command.body_z=body_z;
+	gait_solve(&config, &command, &foot, &joints);
+	for (uint8_t leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		CHECK_NEAR(joints.coxa[leg], 0.0, TEST_GAIT_TOLERANCE);
+		CHECK_NEAR(joints.femur[leg], femur, TEST_GAIT_TOLERANCE);
+		CHECK_NEAR(joints.tibia[leg], tibia, TEST_GAIT_TOLERANCE);
+	}
+}
+
+/* the body frame foot position the joints of one leg put the foot at */
+static void test_gait_forward(const gait_config_t* config, uint8_t leg, const gait_joints_t* joints, double* x, double* y, double* z) {
+	double F=config->femur_length;
+	double T=config->tibia_length;
+	double c=joints->coxa[leg];
+	double f=joints->femur[leg];
+	double t=joints->tibia[leg];
+	double reach=config->coxa_length+F*cos(f)+T*cos(f-M_PI/2+t);
+	double lx=reach*cos(c);
+	double ly=reach*sin(c);
+
+	*x=config->mount.x[leg]+config->mount_cos[leg]*lx-config->mount_sin[leg]*ly;
+	*y=config->mount.y[leg]+config->mount_sin[leg]*lx+config->mount_cos[leg]*ly;
+	*z=F*sin(f)+T*sin(f-M_PI/2+t);
+}
+
+/* random feet and body poses within reach, the solved joints must put the feet there */
+static void test_gait_round_trip(void) {
+	gait_config_t config;
+	gait_command_t command;
+	gait_vec_t foot;
+	gait_joints_t joints;
+	unsigned int seed=27;
+
+	gait_config_default(&config);
+	for (uint16_t round=0; round<1000; round++) {
+		memset(&command, 0, sizeof(command));
+		command.body_x=(rand_r(&seed)%21)-10;
+		command.body_y=(rand_r(&seed)%21)-10;
+		command.body_z=(rand_r(&seed)%21)-10;
+		command.body_roll=((rand_r(&seed)%101)-50)/1000.0f;
+		command.body_pitch=((rand_r(&seed)%101)-50)/1000.0f;
+		command.body_yaw=((rand_r(&seed)%201)-100)/1000.0f;
+		for (uint8_t leg=0; leg<GAIT_LEG_COUNT; leg++) {
+			foot.x[leg]=(rand_r(&seed)%41)-20;
+			foot.y[leg]=(rand_r(&seed)%41)-20;
+			foot.z[leg]=rand_r(&seed)%31;
+		}
+		gait_solve(&config, &command, &foot, &joints);
+
+		double cr=cos(command.body_roll),		sr=sin(command.body_roll);
+		double cp=cos(command.body_pitch),	sp=sin(command.body_pitch);
+		double cy=cos(command.body_yaw),		sy=sin(command.body_yaw);
+		for (uint8_t leg=0; leg<GAIT_LEG_COUNT; leg++) {
+			double bx, by, bz;
+			test_gait_forward(&config, leg, &joints, &bx, &by, &bz);
+			/* back into the world frame: R*body+offset, R=Rz(yaw)*Ry(pitch)*Rx(roll) */
+			double wx=cy*cp*bx+(cy*sp*sr-sy*cr)*by+(cy*sp*cr+sy*sr)*bz+command.body_x;
+			double wy=sy*cp*bx+(sy*sp*sr+cy*cr)*by+(sy*sp*cr-cy*sr)*bz+command.body_y;
+			double wz=-sp*bx+cp*sr*by+cp*cr*bz+command.body_z;
+			CHECK_NEAR(wx, config.neutral.x[leg]+foot.x[leg], TEST_GAIT_FK_TOLERANCE);
+			CHECK_NEAR(wy, config.neutral.y[leg]+foot.y[leg], TEST_GAIT_FK_TOLERANCE);
+			CHECK_NEAR(wz, config.neutral.z[leg]+foot.z[leg], TEST_GAIT_FK_TOLERANCE);
+		}
+	}
+}
+
+/* walking keeps every foot inside the stride, stopping brings them all down */
+static void test_gait_walk(void) {
+	gait_ctx_t gait;
+	gait_command_t command;
+
+	memset(&gait, 0, sizeof(gait));
+	gait_config_default(&gait.config);
+	memset(&command, 0, sizeof(command));
+	command.vx=200.0f;
+	command.vyaw=0.3f;
+	for (gait_type_t type=GAIT_TRIPOD; type<GAIT_TYPE_COUNT; type=(gait_type_t)(type+1)) {
+		command.type=type;
+		for (uint16_t tick=0; tick<1000; tick++) {
+			gait_step(&gait, &command, 0.01f);
+			for (uint8_t leg=0; leg<GAIT_LEG_COUNT; leg++) {
+				CHECK(hypotf(gait.foot.x[leg], gait.foot.y[leg])<=gait.config.max_stride+1e-3f);
+				CHECK((gait.foot.z[leg]>=0.0f) && (gait.foot.z[leg]<=gait.config.step_height+1e-3f));
+			}
+		}
+	}
+	command.vx=0.0f;
+	command.vyaw=0.0f;
+	for (uint16_t tick=0; tick<500; tick++) {
+		gait_step(&gait, &command, 0.01f);
+	}
+	for (uint8_t leg=0; leg<GAIT_LEG_COUNT; leg++) {
+		CHECK_EQUAL(gait.foot.z[leg], 0);
+	}
+}
+
+int main(int argc, char** argv) {
+	/* leg frame foot at (118, 0, -100): r=66 */
+	test_gait_reference(0.0f, 0.5018450752, -0.4401541987);
+	/* body raised by 30mm */
+	test_gait_reference(30.0f, 0.0303076172, -0.0300779969);
+	test_gait_round_trip();
+	test_gait_walk();
+	return test_result("test_gait");
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * MOVE_SYNC against servos that move at their moving speed: every servo
+ * gets there at the same time, the next move starts from the cached goals
+ * without reading, and a failed write leaves nothing in the cache.
+ */
+#include "test.h"
+#include "servo_sim.c"
+
+#define TEST_MOVE_SERVOS            4
+#define TEST_MOVE_DURATION_MS       400
+#define TEST_MOVE_STEP_NS           3000000ULL		/* an arrival is seen at the end of a motion step */
+
+/* the sync write is not waited for, returns how many packets the servos got once 'expected' are in */
+static uint32_t test_move_wait_packets(servo_sim_t* sim, uint32_t packets, uint32_t expected) {
+	servo_sim_stats_t stats;
+	uint64_t t_start=test_now_ns();
+
+	do {
+		usleep(1000);
+		servo_sim_get_stats(sim, &stats);
+	} while ((stats.packets<packets+expected) && (test_now_ns()-t_start<1000000000ULL));
+	return stats.packets-packets;
+}
+
+/*
+ * speeds are whole units, so each servo arrives within half a unit of its
+ * speed of the planned time: the spread stays under duration/slowest speed
+ */
+static uint64_t test_move_spread_bound(servo_sim_t* sim) {
+	uint16_t slowest=0x3FF;
+
+	for (uint8_t id=1; id<=TEST_MOVE_SERVOS; id++) {
+		uint16_t speed=servo_sim_word(sim, id, SERVO_SIM_R_MOVING_SPEED)&0x3FF;
+		slowest=(speed && (speed<slowest)) ? speed : slowest;
+	}
+	return TEST_MOVE_DURATION_MS*1000000ULL/slowest;
+}
+
+/* waits until every servo arrived, returns the time between the first and the last */
+static uint64_t test_move_arrival_spread(servo_sim_t* sim, uint64_t t_start, uint64_t* first) {
+	uint64_t t_first=UINT64_MAX;
+	uint64_t t_last=0;
+
+	for (uint8_t id=1; id<=TEST_MOVE_SERVOS; id++) {
+		uint64_t arrival=0;
+		while (test_now_ns()-t_start<3000000000ULL) {
+			pthread_mutex_lock(&sim->lock);
+			arrival=sim->arrival_ns[id];
+			pthread_mutex_unlock(&sim->lock);
+			if (arrival) {
+				break;
+			}
+			usleep(1000);
+		}
+		CHECK(arrival!=0);
+		t_first=(arrival<t_first) ? arrival : t_first;
+		t_last=(arrival>t_last) ? arrival : t_last;
+	}
+	*first=t_first;
+	return t_last-t_first;
+}
+
+static void test_move_sync(servo_sim_t* sim, command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect={DYNAMIXEL_RQ_MOVE_SYNC, TEST_MOVE_DURATION_MS, 1, 1000, 2, -1200, 3, 1500, 4, -1800};
+	std::vector<int16_t> tx_vect;
+	servo_sim_stats_t before;
+	uint64_t t_start;
+	uint64_t t_first;
+	uint64_t bound;
+	uint64_t spread;
+
+	servo_sim_get_stats(sim, &before);
+	t_start=test_now_ns();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(tx_vect.size(), 3);
+	CHECK(tx_vect[1]>=0);
+	/* 4 position reads and the sync write */
+	CHECK_EQUAL(test_move_wait_packets(sim, before.packets, TEST_MOVE_SERVOS+1), TEST_MOVE_SERVOS+1);
+	bound=test_move_spread_bound(sim);
+	CHECK((uint64_t)tx_vect[2]*1000<=bound);
+	spread=test_move_arrival_spread(sim, t_start, &t_first);
+	printf("arrival spread %lluus, planned %dus, bound %lluus\n", (unsigned long long)spread/1000, tx_vect[2], (unsigned long long)bound/1000);
+	CHECK(spread<=bound+TEST_MOVE_STEP_NS);
+	CHECK(t_first-t_start>=(TEST_MOVE_DURATION_MS-50)*1000000ULL);
+	CHECK(t_first-t_start<=(TEST_MOVE_DURATION_MS+50)*1000000ULL);
+	for (uint8_t id=1; id<=TEST_MOVE_SERVOS; id++) {
+		CHECK_EQUAL(ctx->move_goal_tag[id], ctx->move_tag);
+		CHECK_EQUAL(ctx->move_goal[id], servo_sim_word(sim, id, SERVO_SIM_R_PRESENT_POSITION));
+		/* the cache is used once the planned move is over, the simulation may be a bit early */
+		while (test_now_ns()<ctx->move_end_ns[id]) {
+			usleep(1000);
+		}
+	}
+
+	/* back to the centre from the cache: the sync write is the only packet */
+	servo_sim_get_stats(sim, &before);
+	rx_vect={DYNAMIXEL_RQ_MOVE_SYNC, TEST_MOVE_DURATION_MS, 1, 0, 2, 0, 3, 0, 4, 0};
+	tx_vect.clear();
+	t_start=test_now_ns();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_move_wait_packets(sim, before.packets, 1), 1);
+	bound=test_move_spread_bound(sim);
+	CHECK((uint64_t)tx_vect[2]*1000<=bound);
+	spread=test_move_arrival_spread(sim, t_start, &t_first);
+	CHECK(spread<=bound+TEST_MOVE_STEP_NS);
+	for (uint8_t id=1; id<=TEST_MOVE_SERVOS; id++) {
+		CHECK_EQUAL(servo_sim_word(sim, id, SERVO_SIM_R_PRESENT_POSITION), 512);
+	}
+}
+
+/* a bus whose writes fail: the cache keeps the last goals that went out */
+static void test_move_sync_failed_write(calibration_t* calibration) {
+	std::vector<int16_t> rx_vect={DYNAMIXEL_RQ_MOVE_SYNC, TEST_MOVE_DURATION_MS, 1, 100, 2, -300};
+	std::vector<int16_t> tx_vect;
+	/* the bus thread outlives this function */
+	static dynamixel_serial_t serial;
+	static dynamixel_bus_t bus;
+	command_ctx_t ctx;
+
+	memset(&serial, 0, sizeof(serial));
+	serial.fd=-1;
+	serial.epoll_fd=-1;
+	serial.timer_fd=-1;
+	dynamixel_serial_set_status_return(&serial, DYNAMIXEL_SERIAL_BROADCAST_ID, DYNAMIXEL_SERIAL_RETURN_ALL);
+	dynamixel_bus_init(&bus, NULL, &serial);
+	test_command_ctx(&ctx, &bus, calibration);
+	/* the servos stand at the goals of move 1 */
+	ctx.move_tag=1;
+	for (uint8_t id=1; id<=2; id++) {
+		ctx.move_goal[id]=512;
+		ctx.move_goal_tag[id]=1;
+		__atomic_store_n(&bus.goal_tag[id], 1, __ATOMIC_RELAXED);
+	}
+
+	CHECK_EQUAL(command_dispatch(&ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(tx_vect.size(), 3);
+	CHECK(tx_vect[1]<0);
+	for (uint8_t id=1; id<=2; id++) {
+		CHECK_EQUAL(ctx.move_goal[id], 512);
+		CHECK_EQUAL(ctx.move_goal_tag[id], 1);
+		CHECK_EQUAL(ctx.move_end_ns[id], 0);
+	}
+	/* nobody knows where the servos are now, the next move has to read */
+	tx_vect.clear();
+	CHECK_EQUAL(command_dispatch(&ctx, rx_vect, tx_vect), ZMQ_ERR_BUS_ERROR);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	calibration_t calibration;
+	command_ctx_t ctx;
+
+	if ((servo_sim_start(&sim, TEST_MOVE_SERVOS, true)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, &bus, &calibration);
+
+	test_move_sync(&sim, &ctx);
+	test_move_sync_failed_write(&calibration);
+	servo_sim_stop(&sim);
+	return test_result("test_move_sync");
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Servos with status return level 0 or 1: their writes are pipelined and
+ * must all land, a READ to a servo that doesn't answer must fail and not
+ * hand out the parameters of an earlier status packet.
+ */
+#include "test.h"
+#include "servo_sim.c"
+
+#define TEST_PIPELINE_SERVOS        4
+#define TEST_PIPELINE_ROUNDS        200
+
+static void test_pipeline_set_level(dynamixel_serial_t* port, uint8_t id, uint8_t level) {
+	CHECK(dynamixel_serial_write_data(port, id, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_STATUS_RETURN, 1, &level)>=0);
+}
+
+static void test_pipeline_no_status_read(servo_sim_t* sim, dynamixel_serial_t* port) {
+	uint8_t data[2]={0x34, 0x01};
+	uint8_t back[2];
+
+	CHECK_EQUAL(dynamixel_serial_write_data(port, 1, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_GOAL_POSITION, 2, data), 0);
+	CHECK_EQUAL(dynamixel_serial_read_data(port, 1, SERVO_SIM_R_PRESENT_POSITION, 2, back), 2);
+	CHECK_EQUAL(back[0]|(back[1]<<8), 0x134);
+
+	/* the status packet above is still in the parser */
+	test_pipeline_set_level(port, 1, DYNAMIXEL_SERIAL_RETURN_PING);
+	back[0]=0xAA;
+	back[1]=0xAA;
+	CHECK_EQUAL(dynamixel_serial_read_data(port, 1, SERVO_SIM_R_PRESENT_POSITION, 2, back), DYNAMIXEL_SERIAL_ERR_NO_STATUS);
+	CHECK_EQUAL(back[0], 0xAA);
+	CHECK_EQUAL(back[1], 0xAA);
+	CHECK_EQUAL(dynamixel_serial_read_data(port, 1, SERVO_SIM_R_PRESENT_POSITION, 0, back), DYNAMIXEL_SERIAL_ERR_NO_STATUS);
+	CHECK_EQUAL(dynamixel_serial_read_data(port, DYNAMIXEL_SERIAL_BROADCAST_ID, SERVO_SIM_R_PRESENT_POSITION, 2, back), DYNAMIXEL_SERIAL_ERR_NO_STATUS);
+	/* a ping is always answered */
+	CHECK_EQUAL(dynamixel_serial_ping(port, 1), 0);
+
+	/* level 1 answers READ again */
+	test_pipeline_set_level(port, 1, DYNAMIXEL_SERIAL_RETURN_READ);
+	CHECK_EQUAL(dynamixel_serial_read_data(port, 1, SERVO_SIM_R_PRESENT_POSITION, 2, back), 2);
+	CHECK_EQUAL(back[0]|(back[1]<<8), 0x134);
+	CHECK_EQUAL(servo_sim_word(sim, 1, SERVO_SIM_R_PRESENT_POSITION), 0x134);
+}
+
+/* the same through the request loop: no data in the reply */
+static void test_pipeline_no_status_dispatch(command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect;
+	std::vector<int16_t> tx_vect;
+
+	rx_vect={DYNAMIXEL_RQ_WRITE_DATA, 2, SERVO_SIM_R_STATUS_RETURN, 1, DYNAMIXEL_SERIAL_RETURN_ALL};
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	rx_vect={DYNAMIXEL_RQ_READ_DATA, 2, SERVO_SIM_R_PRESENT_POSITION, 2};
+	tx_vect.clear();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(tx_vect.size(), 3);
+
+	rx_vect={DYNAMIXEL_RQ_WRITE_DATA, 2, SERVO_SIM_R_STATUS_RETURN, 1, DYNAMIXEL_SERIAL_RETURN_PING};
+	tx_vect.clear();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	rx_vect={DYNAMIXEL_RQ_READ_DATA, 2, SERVO_SIM_R_PRESENT_POSITION, 2};
+	tx_vect.clear();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(tx_vect.size(), 1);
+}
+
+/* back to back writes without replies, every servo ends at its last goal */
+static void test_pipeline_writes(servo_sim_t* sim, dynamixel_serial_t* port) {
+	servo_sim_stats_t stats;
+	uint32_t pipelined;
+	uint16_t goal=0;
+	uint8_t data[2];
+
+	for (uint8_t id=1; id<=TEST_PIPELINE_SERVOS; id++) {
+		test_pipeline_set_level(port, id, (id&1) ? DYNAMIXEL_SERIAL_RETURN_PING : DYNAMIXEL_SERIAL_RETURN_READ);
+	}
+	pipelined=port->stats.pipelined;
+	for (uint32_t r=0; r<TEST_PIPELINE_ROUNDS; r++) {
+		for (uint8_t id=1; id<=TEST_PIPELINE_SERVOS; id++) {
+			goal=(r*7+id)%1024;
+			data[0]=goal&0xFF;
+			data[1]=goal>>8;
+			CHECK_EQUAL(dynamixel_serial_write_data(port, id, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_GOAL_POSITION, 2, data), 0);
+		}
+	}
+	CHECK_EQUAL(port->stats.pipelined-pipelined, TEST_PIPELINE_ROUNDS*TEST_PIPELINE_SERVOS);
+	/* a ping waits behind everything queued */
+	for (uint8_t id=1; id<=TEST_PIPELINE_SERVOS; id++) {
+		CHECK_EQUAL(dynamixel_serial_ping(port, id), 0);
+		CHECK_EQUAL(servo_sim_word(sim, id, SERVO_SIM_R_GOAL_POSITION), ((TEST_PIPELINE_ROUNDS-1)*7+id)%1024);
+	}
+	servo_sim_get_stats(sim, &stats);
+	CHECK_EQUAL(stats.checksum_errors, 0);
+	CHECK_EQUAL(stats.stray_bytes, 0);
+	CHECK_EQUAL(port->stats.timeouts, 0);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t port;
+	dynamixel_bus_t bus;
+	command_ctx_t ctx;
+
+	if ((servo_sim_start(&sim, TEST_PIPELINE_SERVOS, false)!=0) || (servo_sim_connect(&sim, &port)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	test_pipeline_no_status_read(&sim, &port);
+	test_pipeline_writes(&sim, &port);
+	/* from here on only the bus thread uses the port */
+	dynamixel_bus_init(&bus, NULL, &port);
+	test_command_ctx(&ctx, &bus, NULL);
+	test_pipeline_no_status_dispatch(&ctx);
+	servo_sim_stop(&sim);
+	return test_result("test_pipeline");
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * pose library upload, the pose size bound and the library swap, then
+ * playback of merged tracks into simulated servos
+ */
+#include "test.h"
+#include "servo_sim.c"
+
+static std::vector<int16_t> test_pypose_library_message(uint8_t pose_size, uint8_t pose_count) {
+	std::vector<int16_t> rx_vect={PYPOSE_LOAD_LIBRARY, PYPOSE_ID, pose_size, pose_count};
+
+	for (uint8_t pose=0; pose<pose_count; pose++) {
+		rx_vect.push_back(pose);
+		for (uint8_t i=0; i<pose_size; i++) {
+			rx_vect.push_back(100+pose*10+i);
+		}
+	}
+	/* sequence 0 walks through all poses */
+	rx_vect.push_back(1);
+	rx_vect.push_back(0);
+	rx_vect.push_back(pose_count);
+	for (uint8_t pose=0; pose<pose_count; pose++) {
+		rx_vect.push_back(pose);
+		rx_vect.push_back(20);
+	}
+	return rx_vect;
+}
+
+static int16_t test_pypose_dispatch(command_ctx_t* ctx, const std::vector<int16_t>& rx_vect) {
+	std::vector<int16_t> tx_vect;
+	return command_dispatch(ctx, rx_vect, tx_vect);
+}
+
+/* SET_POSESIZE, LOAD_POSE and LOAD_LIBRARY agree on the largest pose */
+static void test_pypose_size_bound(command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect;
+	pypose_library_t* library;
+	uint8_t pose_size;
+
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_SET_POSESIZE, PYPOSE_ID, PYPOSE_MAX_POSE_SIZE}), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_SET_POSESIZE, PYPOSE_ID, PYPOSE_MAX_POSE_SIZE+1}), ZMQ_ERR_INVALID_PARAMETERS);
+
+	rx_vect={PYPOSE_LOAD_POSE, PYPOSE_ID, 5};
+	for (uint8_t i=0; i<PYPOSE_MAX_POSE_SIZE; i++) {
+		rx_vect.push_back(0x00);
+		rx_vect.push_back(0x02);
+	}
+	CHECK_EQUAL(test_pypose_dispatch(ctx, rx_vect), ZMQ_ERR_NO_ERROR);
+	library=pypose_library_acquire();
+	CHECK(library->poses[5]!=NULL);
+	if (library->poses[5]) {
+		CHECK_EQUAL(library->poses[5]->len, PYPOSE_MAX_POSE_SIZE);
+		CHECK_EQUAL(library->poses[5]->values[PYPOSE_MAX_POSE_SIZE-1], 0x200);
+		CHECK_EQUAL(library->poses[5]->packet_len, PYPOSE_PACKET_SIZE);
+	}
+	pypose_library_release(library);
+
+	rx_vect=test_pypose_library_message(PYPOSE_MAX_POSE_SIZE, 2);
+	CHECK_EQUAL(pypose_library_parse(rx_vect, 2, &pose_size, &library), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(pose_size, PYPOSE_MAX_POSE_SIZE);
+	pypose_library_release(library);
+	rx_vect=test_pypose_library_message(PYPOSE_MAX_POSE_SIZE+1, 2);
+	CHECK_EQUAL(pypose_library_parse(rx_vect, 2, &pose_size, &library), ZMQ_ERR_INVALID_PARAMETERS);
+	rx_vect=test_pypose_library_message(0, 0);
+	CHECK_EQUAL(pypose_library_parse(rx_vect, 2, &pose_size, &library), ZMQ_ERR_INVALID_PARAMETERS);
+}
+
+/* the message is checked completely before anything changes */
+static void test_pypose_library_upload(command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect;
+	pypose_library_t* before;
+	pypose_library_t* after;
+	uint8_t pose_size;
+
+	before=pypose_library_acquire();
+	rx_vect=test_pypose_library_message(18, 4);
+	rx_vect.pop_back();
+	CHECK_EQUAL(test_pypose_dispatch(ctx, rx_vect), ZMQ_ERR_INVALID_PARAMETER_COUNT);
+	rx_vect=test_pypose_library_message(18, 4);
+	rx_vect[rx_vect.size()-2]=4;				/* pose 4 is not part of the upload */
+	CHECK_EQUAL(test_pypose_dispatch(ctx, rx_vect), ZMQ_ERR_INVALID_PARAMETERS);
+	after=pypose_library_acquire();
+	CHECK(before==after);
+	pypose_library_release(after);
+
+	rx_vect=test_pypose_library_message(18, 4);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, rx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(pyPose_PoseSize, 18);
+	after=pypose_library_acquire();
+	CHECK(before!=after);
+	CHECK(after->poses[3]!=NULL);
+	CHECK(after->poses[4]==NULL);
+	CHECK(after->sequences[0]!=NULL);
+	if ((after->poses[3]) && (after->sequences[0])) {
+		CHECK_EQUAL(after->poses[3]->values[17], 100+30+17);
+		CHECK_EQUAL(after->sequences[0]->len, 4);
+		CHECK_EQUAL(after->sequences[0]->parts[3].pose_id, 3);
+	}
+	/* the replaced library lives on for whoever still holds it */
+	CHECK(before->poses[5]!=NULL);
+	CHECK_EQUAL(before->refs, 1);
+	pypose_library_release(before);
+	pypose_library_release(after);
+
+	/* delays are unsigned words, as with LOAD_SEQUENCE */
+	rx_vect=test_pypose_library_message(18, 2);
+	rx_vect[rx_vect.size()-3]=(int16_t)40000;
+	rx_vect[rx_vect.size()-1]=(int16_t)65535;
+	after=NULL;
+	CHECK_EQUAL(pypose_library_parse(rx_vect, 2, &pose_size, &after), ZMQ_ERR_NO_ERROR);
+	if (after) {
+		CHECK_EQUAL(after->sequences[0]->parts[0].delay, 40000);
+		CHECK_EQUAL(after->sequences[0]->parts[1].delay, 65535);
+		pypose_library_release(after);
+	}
+}
+
+/* a sequence that does not exist is an error and leaves the track stopped */
+static void test_pypose_undefined_sequence(command_ctx_t* ctx) {
+	pypose_track_t track;
+
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_PLAY_SEQUENCE, PYPOSE_ID, 200}), ZMQ_ERR_INVALID_PARAMETERS);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_LOOP_SEQUENCE, PYPOSE_ID, 200}), ZMQ_ERR_INVALID_PARAMETERS);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_PLAY_TRACK, PYPOSE_ID, 3, 200, 1, 1000, 0, -1, -1}), ZMQ_ERR_INVALID_PARAMETERS);
+	pypose_player_get_track(ctx->player, 3, &track);
+	CHECK_EQUAL(track.state, PP_STATE_STOPPED);
+	CHECK(!pypose_player_running(ctx->player));
+}
+
+/*
+ * track 0 plays pose 0 on every servo, tracks 1 and 2 override servos 1..2
+ * and 2..3 with a higher priority, servo 2 gets the average of both
+ */
+static void test_pypose_merge(command_ctx_t* ctx, servo_sim_t* sim) {
+	std::vector<int16_t> rx_vect={PYPOSE_LOAD_LIBRARY, PYPOSE_ID, 6, 3};
+	uint16_t expected[6];
+	uint8_t id_count;
+
+	for (uint8_t pose=0; pose<3; pose++) {
+		rx_vect.push_back(pose);
+		for (uint8_t i=0; i<6; i++) {
+			rx_vect.push_back(300+pose*200+i);
+		}
+	}
+	rx_vect.insert(rx_vect.end(), {3, 0, 1, 0, 1000, 1, 1, 1, 1000, 2, 1, 2, 1000});
+	CHECK_EQUAL(test_pypose_dispatch(ctx, rx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_PLAY_TRACK, PYPOSE_ID, 0, 0, 1, 1000, 0, -1, -1}), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_PLAY_TRACK, PYPOSE_ID, 1, 1, 1, 1000, 1, 0x3, 0}), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_PLAY_TRACK, PYPOSE_ID, 2, 2, 1, 1000, 1, 0x6, 0}), ZMQ_ERR_NO_ERROR);
+	expected[0]=500;
+	expected[1]=(501+701)/2;
+	expected[2]=702;
+	for (uint8_t i=3; i<6; i++) {
+		expected[i]=300+i;
+	}
+
+	pthread_mutex_lock(&ctx->player->lock);
+	id_count=pypose_player_merge(ctx->player);
+	CHECK_EQUAL(id_count, 6);
+	for (uint8_t i=0; i<id_count; i++) {
+		CHECK_EQUAL(ctx->player->data[i*2], i+1);
+		CHECK_EQUAL(ctx->player->data[i*2+1], expected[i]);
+	}
+	pthread_mutex_unlock(&ctx->player->lock);
+
+	/* and that is what the servos get */
+	usleep(100000);
+	for (uint8_t i=0; i<6; i++) {
+		CHECK_EQUAL(servo_sim_word(sim, i+1, SERVO_SIM_R_GOAL_POSITION), expected[i]);
+	}
+	pypose_player_stop_all(ctx->player);
+}
+
+/* the bytes the native transport sends for a SYNC_WRITE of the goals of ids 1..len */
+static size_t test_pypose_encode(const uint16_t* values, uint8_t len, uint8_t* packet) {
+	dynamixel_serial_t port;
+	uint16_t data[PYPOSE_MAX_POSE_SIZE*2];
+	int pipe_fd[2];
+	ssize_t count;
+
+	if (pipe(pipe_fd)!=0) {
+		return 0;
+	}
+	memset(&port, 0, sizeof(port));
+	port.fd=pipe_fd[1];
+	port.epoll_fd=-1;
+	port.timer_fd=-1;
+	for (uint8_t i=0; i<len; i++) {
+		data[i*2]=i+1;
+		data[i*2+1]=values[i];
+	}
+	dynamixel_serial_sync_write_words(&port, DYNAMIXEL_R_GOAL_POSITION_L, len, 1, data);
+	count=read(pipe_fd[0], packet, PYPOSE_PACKET_SIZE);
+	close(pipe_fd[0]);
+	close(pipe_fd[1]);
+	return (count>0) ? count : 0;
+}
+
+/* LOAD_POSE while the player runs: a new pose in a new library, the old packet stays as it was */
+static void test_pypose_load_pose_copy(command_ctx_t* ctx, servo_sim_t* sim) {
+	std::vector<int16_t> rx_vect={PYPOSE_LOAD_POSE, PYPOSE_ID, 1};
+	uint8_t old_packet[PYPOSE_PACKET_SIZE];
+	uint8_t encoded[PYPOSE_PACKET_SIZE];
+	pypose_library_t* before;
+	pypose_library_t* after;
+	pypose_pose_t* old_pose;
+	size_t len;
+
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_SET_POSESIZE, PYPOSE_ID, 6}), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_LOOP_SEQUENCE, PYPOSE_ID, 1}), ZMQ_ERR_NO_ERROR);
+	before=pypose_library_acquire();
+	old_pose=before->poses[1];
+	CHECK(old_pose!=NULL);
+	if (!old_pose) {
+		pypose_library_release(before);
+		return;
+	}
+	memcpy(old_packet, old_pose->packet, sizeof(old_packet));
+
+	for (uint8_t i=0; i<6; i++) {
+		rx_vect.push_back((900+i)&0xFF);
+		rx_vect.push_back((900+i)>>8);
+	}
+	CHECK_EQUAL(test_pypose_dispatch(ctx, rx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK(before->poses[1]==old_pose);
+	CHECK_EQUAL(old_pose->values[0], 500);
+	CHECK(memcmp(old_packet, old_pose->packet, sizeof(old_packet))==0);
+
+	after=pypose_library_acquire();
+	CHECK(after!=before);
+	CHECK(after->poses[1]!=old_pose);
+	/* only before holds the old pose, the rest is shared by both */
+	CHECK_EQUAL(old_pose->refs, 1);
+	CHECK(after->poses[0]==before->poses[0]);
+	CHECK(after->sequences[1]==before->sequences[1]);
+	if (after->poses[0]) {
+		CHECK_EQUAL(after->poses[0]->refs, 2);
+	}
+	if (after->sequences[1]) {
+		CHECK_EQUAL(after->sequences[1]->refs, 2);
+	}
+	if (after->poses[1]) {
+		CHECK_EQUAL(after->poses[1]->values[5], 905);
+		len=test_pypose_encode(after->poses[1]->values, 6, encoded);
+		CHECK_EQUAL(after->poses[1]->packet_len, len);
+		CHECK(memcmp(after->poses[1]->packet, encoded, len)==0);
+	}
+	pypose_library_release(after);
+	pypose_library_release(before);
+	pypose_player_stop_all(ctx->player);
+
+	/* the next pass plays the new pose */
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_PLAY_SEQUENCE, PYPOSE_ID, 1}), ZMQ_ERR_NO_ERROR);
+	usleep(100000);
+	for (uint8_t i=0; i<6; i++) {
+		CHECK_EQUAL(servo_sim_word(sim, i+1, SERVO_SIM_R_GOAL_POSITION), 900+i);
+	}
+	pypose_player_stop_all(ctx->player);
+
+	/* LOAD_SEQUENCE replaces sequence 0 and shares everything else */
+	before=pypose_library_acquire();
+	CHECK_EQUAL(test_pypose_dispatch(ctx, {PYPOSE_LOAD_SEQUENCE, PYPOSE_ID, 2, 0xE8, 0x03}), ZMQ_ERR_NO_ERROR);
+	after=pypose_library_acquire();
+	CHECK(after->sequences[0]!=before->sequences[0]);
+	CHECK(after->sequences[2]==before->sequences[2]);
+	for (uint8_t p=0; p<3; p++) {
+		CHECK(after->poses[p]==before->poses[p]);
+	}
+	if (after->sequences[0]) {
+		CHECK_EQUAL(after->sequences[0]->refs, 1);
+		CHECK_EQUAL(after->sequences[0]->parts[0].delay, 1000);
+	}
+	pypose_library_release(after);
+	pypose_library_release(before);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	pthread_t player_thread;
+	pypose_player_ctx_t player;
+	command_ctx_t ctx;
+
+	if ((servo_sim_start(&sim, PYPOSE_MAX_POSE_SIZE-1, false)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	pypose_library_init();
+	memset(&player, 0, sizeof(player));
+	player.bus=&bus;
+	pypose_player_init(&player_thread, &player);
+	test_command_ctx(&ctx, &bus, NULL);
+	ctx.player=&player;
+
+	test_pypose_size_bound(&ctx);
+	test_pypose_library_upload(&ctx);
+	test_pypose_undefined_sequence(&ctx);
+	test_pypose_merge(&ctx, &sim);
+	test_pypose_load_pose_copy(&ctx, &sim);
+	servo_sim_stop(&sim);
+	return test_result("test_pypose");
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * register_map_span and register_map_decode on their own, then READ_FIELDS
+ * against a simulated AX-12.
+ */
+#include "test.h"
+#include "servo_sim.c"
+
+static void test_register_map_span(void) {
+	const uint8_t state[]={
+		REGISTER_FIELD_MOVING, REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_PRESENT_LOAD,
+		REGISTER_FIELD_PRESENT_SPEED, REGISTER_FIELD_PRESENT_VOLTAGE
+	};
+	const uint8_t gains[]={REGISTER_FIELD_P_GAIN, REGISTER_FIELD_D_GAIN};
+	const uint8_t unknown[]={REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_COUNT};
+	uint8_t start=0;
+	uint8_t length=0;
+
+	/* 36 (position) up to and including 46 (moving) */
+	CHECK(register_map_span(REGISTER_MODEL_AX12, state, sizeof(state), &start, &length));
+	CHECK_EQUAL(start, 36);
+	CHECK_EQUAL(length, 11);
+	CHECK(register_map_span(REGISTER_MODEL_AX12, state+1, 1, &start, &length));
+	CHECK_EQUAL(start, 36);
+	CHECK_EQUAL(length, 2);
+
+	/* the gains are MX only, the AX has compliance there */
+	CHECK(register_map_span(REGISTER_MODEL_MX28, gains, sizeof(gains), &start, &length));
+	CHECK_EQUAL(start, 26);
+	CHECK_EQUAL(length, 3);
+	CHECK(!register_map_span(REGISTER_MODEL_AX12, gains, sizeof(gains), &start, &length));
+	CHECK(!register_map_span(REGISTER_MODEL_AX18, gains, 1, &start, &length));
+
+	CHECK(!register_map_span(REGISTER_MODEL_AX12, unknown, sizeof(unknown), &start, &length));
+	CHECK(!register_map_span(REGISTER_MODEL_COUNT, state, sizeof(state), &start, &length));
+	CHECK(!register_map_span(REGISTER_MODEL_AX12, state, 0, &start, &length));
+}
+
+static void test_register_map_decode(void) {
+	const uint8_t fields[]={
+		REGISTER_FIELD_PRESENT_LOAD, REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_PRESENT_SPEED,
+		REGISTER_FIELD_PRESENT_TEMPERATURE
+	};
+	uint8_t data[8];
+	int16_t values[4];
+
+	/* block from 36: position 0x3FF, speed CW 100, load CCW 1023, voltage, temperature */
+	data[0]=0xFF;
+	data[1]=0x03;
+	data[2]=100;
+	data[3]=0x04;
+	data[4]=0xFF;
+	data[5]=0x03;
+	data[6]=120;
+	data[7]=40;
+	register_map_decode(REGISTER_MODEL_AX12, fields, 4, 36, data, values);
+	CHECK_EQUAL(values[0], 1023);
+	CHECK_EQUAL(values[1], 1023);
+	CHECK_EQUAL(values[2], -100);
+	CHECK_EQUAL(values[3], 40);
+
+	/* bit 10 only gives the direction, a stopped servo may report CW 0 */
+	data[2]=0x00;
+	data[3]=0x04;
+	data[4]=0xFF;
+	data[5]=0x07;
+	register_map_decode(REGISTER_MODEL_AX12, fields, 3, 36, data, values);
+	CHECK_EQUAL(values[0], -1023);
+	CHECK_EQUAL(values[2], 0);
+}
+
+static void test_register_map_read_fields(servo_sim_t* sim, command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect={
+		DYNAMIXEL_RQ_READ_FIELDS, 1, REGISTER_MODEL_AX12,
+		REGISTER_FIELD_PRESENT_LOAD, REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_PRESENT_SPEED, REGISTER_FIELD_PRESENT_VOLTAGE
+	};
+	std::vector<int16_t> tx_vect;
+	servo_sim_stats_t before;
+	servo_sim_stats_t after;
+
+	servo_sim_set_word(sim, 1, SERVO_SIM_R_PRESENT_POSITION, 700);
+	servo_sim_set_word(sim, 1, 38, 0x400|250);
+	servo_sim_set_word(sim, 1, 40, 300);
+	servo_sim_set_word(sim, 1, 42, 120|(40<<8));
+
+	/* one READ_DATA for the whole block */
+	servo_sim_get_stats(sim, &before);
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	servo_sim_get_stats(sim, &after);
+	CHECK_EQUAL(after.packets-before.packets, 1);
+	CHECK_EQUAL(tx_vect.size(), 5);
+	if (tx_vect.size()==5) {
+		CHECK_EQUAL(tx_vect[0], ZMQ_ERR_NO_ERROR);
+		CHECK_EQUAL(tx_vect[1], 300);
+		CHECK_EQUAL(tx_vect[2], 700);
+		CHECK_EQUAL(tx_vect[3], -250);
+		CHECK_EQUAL(tx_vect[4], 120);
+	}
+
+	/* the timed variant puts the stamp in front of the values */
+	rx_vect[0]=DYNAMIXEL_RQ_READ_FIELDS_TIMED;
+	tx_vect.clear();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(tx_vect.size(), 1+5+4);
+	if (tx_vect.size()==1+5+4) {
+		CHECK_EQUAL(tx_vect[6], 300);
+		CHECK_EQUAL(tx_vect[9], 120);
+	}
+
+	/* an MX field on an AX model is rejected without a packet */
+	rx_vect={DYNAMIXEL_RQ_READ_FIELDS, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, REGISTER_FIELD_GOAL_ACCELERATION};
+	tx_vect.clear();
+	servo_sim_get_stats(sim, &before);
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_INVALID_PARAMETERS);
+	servo_sim_get_stats(sim, &after);
+	CHECK_EQUAL(after.packets, before.packets);
+
+	/* a servo that doesn't answer */
+	rx_vect={DYNAMIXEL_RQ_READ_FIELDS, 9, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION};
+	tx_vect.clear();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_BUS_ERROR);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	calibration_t calibration;
+	command_ctx_t ctx;
+
+	test_register_map_span();
+	test_register_map_decode();
+
+	if ((servo_sim_start(&sim, 2, false)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, &bus, &calibration);
+	test_register_map_read_fields(&sim, &ctx);
+	servo_sim_stop(&sim);
+	return test_result("test_register_map");
+}
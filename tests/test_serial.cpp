@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* native transport: transactions against simulated servos, the status parser and failed opens */
+#include "test.h"
+#include "servo_sim.c"
+
+#include <dirent.h>
+#include <sys/resource.h>
+
+#define TEST_SERIAL_SERVOS          4
+
+/* status packet of 'id' with 'count' parameters, returns its length */
+static size_t test_serial_status(uint8_t* packet, uint8_t id, uint8_t error, const uint8_t* params, uint8_t count) {
+	uint8_t checksum=id+count+2+error;
+
+	packet[0]=0xFF;
+	packet[1]=0xFF;
+	packet[2]=id;
+	packet[3]=count+2;
+	packet[4]=error;
+	for (uint8_t i=0; i<count; i++) {
+		packet[5+i]=params[i];
+		checksum+=params[i];
+	}
+	packet[5+count]=~checksum;
+	return 6+count;
+}
+
+/* feeds bytes until the parser has a packet or an error, returns that or 0 */
+static int test_serial_feed(dynamixel_serial_parser_t* parser, const uint8_t* data, size_t len) {
+	int ret;
+
+	for (size_t i=0; i<len; i++) {
+		ret=dynamixel_serial_parser_feed(parser, data[i]);
+		if (ret!=0) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+static void test_serial_parser(void) {
+	dynamixel_serial_parser_t parser;
+	const uint8_t params[2]={0x34, 0x12};
+	const uint8_t garbage[5]={0x00, 0xFF, 0x12, 0xFF, 0x42};
+	uint8_t packet[16];
+	uint8_t stream[64];
+	size_t len;
+
+	/* noise and a lone header byte in front */
+	memcpy(stream, garbage, sizeof(garbage));
+	len=sizeof(garbage)+test_serial_status(stream+sizeof(garbage), 3, 0, params, 2);
+	dynamixel_serial_parser_reset(&parser, 3);
+	CHECK_EQUAL(test_serial_feed(&parser, stream, len), 1);
+	CHECK_EQUAL(parser.id, 3);
+	CHECK_EQUAL(parser.count, 2);
+	CHECK_EQUAL(parser.params[0], 0x34);
+	CHECK_EQUAL(parser.params[1], 0x12);
+
+	/* split across reads, one byte at a time */
+	len=test_serial_status(packet, 3, SERVO_SIM_ERR_RANGE, params, 2);
+	dynamixel_serial_parser_reset(&parser, 3);
+	for (size_t i=0; i<len-1; i++) {
+		CHECK_EQUAL(dynamixel_serial_parser_feed(&parser, packet[i]), 0);
+	}
+	CHECK_EQUAL(dynamixel_serial_parser_feed(&parser, packet[len-1]), 1);
+	CHECK_EQUAL(parser.error, SERVO_SIM_ERR_RANGE);
+
+	/* a late reply of another servo is skipped */
+	len=test_serial_status(stream, 2, 0, params, 1);
+	len+=test_serial_status(stream+len, 3, 0, params+1, 1);
+	dynamixel_serial_parser_reset(&parser, 3);
+	CHECK_EQUAL(test_serial_feed(&parser, stream, len), 1);
+	CHECK_EQUAL(parser.id, 3);
+	CHECK_EQUAL(parser.params[0], 0x12);
+
+	/* a broken checksum */
+	len=test_serial_status(packet, 3, 0, params, 2);
+	packet[len-1]^=0x01;
+	dynamixel_serial_parser_reset(&parser, 3);
+	CHECK_EQUAL(test_serial_feed(&parser, packet, len), DYNAMIXEL_SERIAL_ERR_CHECKSUM);
+}
+
+static void test_serial_transactions(servo_sim_t* sim, dynamixel_serial_t* port) {
+	uint8_t data[2]={0x00, 0x03};
+	uint8_t back[2];
+	uint64_t t_start;
+
+	CHECK_EQUAL(dynamixel_serial_ping(port, 1), 0);
+	CHECK_EQUAL(dynamixel_serial_write_data(port, 2, DYNAMIXEL_SERIAL_WRITE_DATA, SERVO_SIM_R_GOAL_POSITION, 2, data), 0);
+	CHECK_EQUAL(servo_sim_word(sim, 2, SERVO_SIM_R_GOAL_POSITION), 0x300);
+	CHECK_EQUAL(dynamixel_serial_read_data(port, 2, SERVO_SIM_R_PRESENT_POSITION, 2, back), 2);
+	CHECK_EQUAL(back[0]|(back[1]<<8), 0x300);
+
+	/* nobody answers for an id past the simulated ones */
+	port->margin_us=5000;
+	t_start=test_now_ns();
+	CHECK_EQUAL(dynamixel_serial_ping(port, TEST_SERIAL_SERVOS+1), DYNAMIXEL_SERIAL_ERR_TIMEOUT);
+	CHECK((test_now_ns()-t_start)>=5000000ULL);
+	CHECK_EQUAL(port->stats.timeouts, 1);
+	port->margin_us=SERVO_SIM_MARGIN_US;
+	/* and the next transaction is not confused by it */
+	CHECK_EQUAL(dynamixel_serial_read_data(port, 2, SERVO_SIM_R_PRESENT_POSITION, 2, back), 2);
+	CHECK_EQUAL(back[0]|(back[1]<<8), 0x300);
+	CHECK_EQUAL(port->stats.checksum_errors, 0);
+}
+
+static int test_serial_open_fds(void) {
+	DIR* dir=opendir("/proc/self/fd");
+	int count=0;
+
+	if (!dir) {
+		return -1;
+	}
+	while (readdir(dir)) {
+		count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+/* every failed open gives back what it opened */
+static void test_serial_open_failures(void) {
+	dynamixel_serial_t port;
+	int fds=test_serial_open_fds();
+
+	memset(&port, 0, sizeof(port));
+	for (int i=0; i<10; i++) {
+		CHECK_EQUAL(dynamixel_serial_open(&port, "/dev/null", 1000000), -1);
+		CHECK_EQUAL(dynamixel_serial_open(&port, "/nonexistent/tty", 1000000), -1);
+		CHECK_EQUAL(dynamixel_serial_open(&port, "/dev/null", 12345), -1);
+	}
+	CHECK_EQUAL(test_serial_open_fds(), fds);
+	CHECK_EQUAL(port.fd, -1);
+	CHECK_EQUAL(port.epoll_fd, -1);
+	CHECK_EQUAL(port.timer_fd, -1);
+}
+
+/* the tty opens, then the timerfd or the epoll fd run out of descriptors */
+static void test_serial_open_fd_limit(servo_sim_t* sim) {
+	dynamixel_serial_t port;
+	struct rlimit limit;
+	struct rlimit saved;
+	int fds=test_serial_open_fds();
+	int first=dup(0);
+	int second=dup(0);
+
+	close(first);
+	close(second);
+	getrlimit(RLIMIT_NOFILE, &saved);
+	for (int room=1; room<=2; room++) {
+		limit=saved;
+		limit.rlim_cur=first+room;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		CHECK_EQUAL(dynamixel_serial_open(&port, sim->device, 1000000), -1);
+		setrlimit(RLIMIT_NOFILE, &saved);
+		CHECK_EQUAL(test_serial_open_fds(), fds);
+	}
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t port;
+
+	test_serial_parser();
+	test_serial_open_failures();
+	if ((servo_sim_start(&sim, TEST_SERIAL_SERVOS, false)!=0) || (servo_sim_connect(&sim, &port)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	test_serial_open_fd_limit(&sim);
+	test_serial_transactions(&sim, &port);
+	dynamixel_serial_close(&port);
+	servo_sim_stop(&sim);
+	return test_result("test_serial");
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The shared memory channel: seqlock snapshots under a concurrent writer,
+ * the goal ring around its wrap and when full, and the service coalescing
+ * goals into sync writes on a simulated bus.
+ */
+#include "test.h"
+#include "servo_sim.c"
+
+#define TEST_SHM_NAME               "/dyn_zmq_test_shm"
+#define TEST_SHM_READS              200000
+
+typedef struct {
+	dynamixel_shm_t*				shm;
+	volatile bool*					stop;
+	uint32_t								writes;
+} test_shm_writer_t;
+
+/* every field carries the same counter, a torn read mixes two of them */
+static void* test_shm_writer(void* arg) {
+	test_shm_writer_t* writer=(test_shm_writer_t*)arg;
+	dynamixel_shm_state_t state;
+
+	memset(&state, 0, sizeof(state));
+	state.valid=1;
+	while (!*writer->stop) {
+		writer->writes++;
+		state.timestamp_ns=writer->writes;
+		state.transaction_ns=writer->writes;
+		state.position=writer->writes;
+		state.speed=writer->writes;
+		state.load=writer->writes;
+		state.voltage=writer->writes;
+		state.temperature=writer->writes;
+		dynamixel_shm_write_state(writer->shm, 1, &state);
+	}
+	return NULL;
+}
+
+static void test_shm_seqlock(dynamixel_shm_t* shm) {
+	test_shm_writer_t writer={shm, NULL, 0};
+	volatile bool stop=false;
+	dynamixel_shm_state_t state;
+	pthread_t thread;
+	uint32_t torn=0;
+	uint64_t last=0;
+
+	CHECK_EQUAL(dynamixel_shm_read_state(shm, 1, &state), -1);
+	CHECK_EQUAL(dynamixel_shm_read_state(shm, DYNAMIXEL_SHM_MAX_ID, &state), -1);
+
+	writer.stop=&stop;
+	pthread_create(&thread, NULL, test_shm_writer, &writer);
+	while (!__atomic_load_n(&shm->servo[1].seq, __ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+	for (uint32_t r=0; r<TEST_SHM_READS; r++) {
+		CHECK_EQUAL(dynamixel_shm_read_state(shm, 1, &state), 0);
+		if ((state.transaction_ns!=(uint32_t)state.timestamp_ns) ||
+				(state.position!=(uint16_t)state.timestamp_ns) ||
+				(state.speed!=state.position) || (state.load!=state.position) ||
+				(state.voltage!=(uint8_t)state.position) || (state.temperature!=state.voltage)) {
+			torn++;
+		}
+		/* snapshots never go back in time */
+		CHECK(state.timestamp_ns>=last);
+		last=state.timestamp_ns;
+		if ((r&0x3FF)==0) {
+			sched_yield();
+		}
+	}
+	stop=true;
+	pthread_join(thread, NULL);
+	CHECK_EQUAL(torn, 0);
+	CHECK(writer.writes>1);
+	/* even again once the writer is done */
+	CHECK_EQUAL(shm->servo[1].seq&1, 0);
+}
+
+static void test_shm_ring(dynamixel_shm_t* shm) {
+	dynamixel_shm_command_t command;
+
+	CHECK_EQUAL(dynamixel_shm_take_command(shm, &command), -1);
+	CHECK_EQUAL(dynamixel_shm_write_goal(shm, DYNAMIXEL_SHM_MAX_ID, 512, 0), -1);
+
+	/* full after RING_SIZE goals, one taken makes room for one more */
+	for (uint32_t i=0; i<DYNAMIXEL_SHM_RING_SIZE; i++) {
+		CHECK_EQUAL(dynamixel_shm_write_goal(shm, 1+i%16, i, 0), 0);
+	}
+	CHECK_EQUAL(dynamixel_shm_write_goal(shm, 1, 0, 0), -1);
+	CHECK_EQUAL(dynamixel_shm_take_command(shm, &command), 0);
+	CHECK_EQUAL(command.goal_position, 0);
+	CHECK_EQUAL(dynamixel_shm_write_goal(shm, 2, 1000, 100), 0);
+	CHECK_EQUAL(dynamixel_shm_write_goal(shm, 3, 1001, 0), -1);
+	for (uint32_t i=1; i<DYNAMIXEL_SHM_RING_SIZE; i++) {
+		CHECK_EQUAL(dynamixel_shm_take_command(shm, &command), 0);
+		CHECK_EQUAL(command.id, 1+i%16);
+		CHECK_EQUAL(command.goal_position, i);
+		CHECK_EQUAL(command.with_speed, 0);
+	}
+	CHECK_EQUAL(dynamixel_shm_take_command(shm, &command), 0);
+	CHECK_EQUAL(command.id, 2);
+	CHECK_EQUAL(command.goal_position, 1000);
+	CHECK_EQUAL(command.with_speed, 1);
+	CHECK_EQUAL(command.moving_speed, 100);
+	CHECK_EQUAL(dynamixel_shm_take_command(shm, &command), -1);
+
+	/* in order across several wraps of the cell index */
+	for (uint32_t i=0; i<3*DYNAMIXEL_SHM_RING_SIZE+7; i++) {
+		CHECK_EQUAL(dynamixel_shm_write_goal(shm, 5, i&0x3FF, 0), 0);
+		CHECK_EQUAL(dynamixel_shm_write_goal(shm, 6, (i+1)&0x3FF, 0), 0);
+		CHECK_EQUAL(dynamixel_shm_take_command(shm, &command), 0);
+		CHECK_EQUAL(command.goal_position, i&0x3FF);
+		CHECK_EQUAL(dynamixel_shm_take_command(shm, &command), 0);
+		CHECK_EQUAL(command.goal_position, (i+1)&0x3FF);
+	}
+	CHECK(shm->head>2*DYNAMIXEL_SHM_RING_SIZE);
+	CHECK_EQUAL(shm->head, shm->tail);
+}
+
+/* goals of one tick become one sync write per mode, the last goal per id wins */
+static void test_shm_service(servo_sim_t* sim, dynamixel_shm_service_t* service) {
+	dynamixel_shm_t* shm=service->shm;
+	dynamixel_shm_state_t state;
+	servo_sim_stats_t before;
+	servo_sim_stats_t after;
+
+	servo_sim_set_word(sim, 2, SERVO_SIM_R_MOVING_SPEED, 0);
+	dynamixel_shm_write_goal(shm, 1, 100, 0);
+	dynamixel_shm_write_goal(shm, 1, 200, 0);
+	dynamixel_shm_write_goal(shm, 2, 300, 50);
+	/* a later goal without a speed keeps the speed of the tick */
+	dynamixel_shm_write_goal(shm, 2, 400, 0);
+	dynamixel_shm_write_goal(shm, 3, 600, 0);
+	servo_sim_get_stats(sim, &before);
+	dynamixel_shm_service_tick(service);
+	servo_sim_get_stats(sim, &after);
+	CHECK_EQUAL(after.packets-before.packets, 2);
+	CHECK_EQUAL(servo_sim_word(sim, 1, SERVO_SIM_R_GOAL_POSITION), 200);
+	CHECK_EQUAL(servo_sim_word(sim, 2, SERVO_SIM_R_GOAL_POSITION), 400);
+	CHECK_EQUAL(servo_sim_word(sim, 2, SERVO_SIM_R_MOVING_SPEED), 50);
+	CHECK_EQUAL(servo_sim_word(sim, 3, SERVO_SIM_R_GOAL_POSITION), 600);
+	for (uint8_t id=1; id<=3; id++) {
+		CHECK_EQUAL(service->pending[id], 0);
+	}
+
+	/* nothing queued, nothing written */
+	servo_sim_get_stats(sim, &before);
+	dynamixel_shm_service_tick(service);
+	servo_sim_get_stats(sim, &after);
+	CHECK_EQUAL(after.packets, before.packets);
+
+	/* with polling on the state of the servos shows up */
+	service->servo_count=3;
+	dynamixel_shm_service_tick(service);
+	CHECK_EQUAL(dynamixel_shm_read_state(shm, 2, &state), 0);
+	CHECK_EQUAL(state.position, 400);
+	CHECK(state.timestamp_ns>0);
+	CHECK_EQUAL(dynamixel_shm_read_state(shm, 4, &state), -1);
+}
+
+/* a second service replaces the region, its name is gone after unlink */
+static void test_shm_lifetime(dynamixel_shm_service_t* service, dynamixel_bus_t* bus) {
+	dynamixel_shm_service_t restarted;
+	dynamixel_shm_t* client;
+
+	client=dynamixel_shm_open(TEST_SHM_NAME);
+	CHECK(client!=NULL);
+	if (!client) {
+		return;
+	}
+	dynamixel_shm_write_goal(client, 1, 123, 0);
+	restarted.debug=false;
+	CHECK(dynamixel_shm_service_create(&restarted, bus, TEST_SHM_NAME, 0));
+	CHECK(restarted.shm!=service->shm);
+	CHECK_EQUAL(restarted.shm->head, 0);
+	dynamixel_shm_close(client);
+
+	dynamixel_shm_service_unlink(&restarted);
+	CHECK(dynamixel_shm_open(TEST_SHM_NAME)==NULL);
+	munmap(restarted.shm, sizeof(dynamixel_shm_t));
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	dynamixel_shm_service_t service;
+
+	if ((servo_sim_start(&sim, 3, false)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	service.debug=false;
+	CHECK(dynamixel_shm_service_create(&service, &bus, TEST_SHM_NAME, 0));
+	if (test_failures) {
+		return test_result("test_shm");
+	}
+	test_shm_seqlock(service.shm);
+	test_shm_ring(service.shm);
+	test_shm_service(&sim, &service);
+	test_shm_lifetime(&service, &bus);
+	munmap(service.shm, sizeof(dynamixel_shm_t));
+	servo_sim_stop(&sim);
+	return test_result("test_shm");
+}
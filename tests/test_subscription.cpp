@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The poll thread's compile and evaluate steps without a bus: windows
+ * merged into reads, and the conditions against values written straight
+ * into the read buffers.
+ */
+#include "test.h"
+
+/* too big for the stack */
+static subscription_service_t test_service;
+
+static subscription_service_t* test_subscription_service(void) {
+	subscription_service_t* service=&test_service;
+
+	memset(service, 0, sizeof(*service));
+	pthread_mutex_init(&service->lock, NULL);
+	service->rate=SUBSCRIPTION_RATE;
+	return service;
+}
+
+/* what the servo would have answered for this subscription's field */
+static void test_subscription_set(subscription_service_t* service, uint16_t handle, uint16_t raw) {
+	subscription_read_t* read=&service->reads[service->read_of[handle]];
+
+	read->data[service->offset[handle]]=raw&0xFF;
+	if (service->size[handle]==2) {
+		read->data[service->offset[handle]+1]=raw>>8;
+	}
+	read->valid=true;
+}
+
+static void test_subscription_merge(void) {
+	subscription_service_t* service=test_subscription_service();
+	int16_t id_3;
+	int16_t return_level;
+	int16_t alarm_led;
+	int16_t position;
+	int16_t other;
+
+	/* ID ends at 4, STATUS_RETURN_LEVEL at 16 is exactly SUBSCRIPTION_MERGE_GAP away */
+	id_3=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_ID, SUBSCRIPTION_CHANGE, 0, 0);
+	return_level=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_STATUS_RETURN_LEVEL, SUBSCRIPTION_CHANGE, 0, 0);
+	position=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, SUBSCRIPTION_CHANGE, 0, 0);
+	other=subscription_add(service, 2, REGISTER_MODEL_AX12, REGISTER_FIELD_ID, SUBSCRIPTION_CHANGE, 0, 0);
+	CHECK(service->dirty);
+	subscription_compile(service);
+	CHECK(!service->dirty);
+	CHECK_EQUAL(service->read_count, 3);
+	CHECK_EQUAL(service->read_of[id_3], service->read_of[return_level]);
+	CHECK_EQUAL(service->reads[service->read_of[id_3]].start, 3);
+	CHECK_EQUAL(service->reads[service->read_of[id_3]].length, 14);
+	CHECK_EQUAL(service->offset[return_level], 13);
+	CHECK(service->read_of[position]!=service->read_of[id_3]);
+	CHECK_EQUAL(service->reads[service->read_of[position]].start, 36);
+	CHECK_EQUAL(service->reads[service->read_of[position]].length, 2);
+	/* same address, another servo */
+	CHECK_EQUAL(service->reads[service->read_of[other]].id, 2);
+	CHECK(service->read_of[other]!=service->read_of[id_3]);
+
+	/* one byte further and it's a read of its own */
+	subscription_remove(service, return_level);
+	alarm_led=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_ALARM_LED, SUBSCRIPTION_CHANGE, 0, 0);
+	subscription_compile(service);
+	CHECK_EQUAL(service->read_count, 4);
+	CHECK(service->read_of[alarm_led]!=service->read_of[id_3]);
+	CHECK_EQUAL(service->reads[service->read_of[id_3]].length, 1);
+}
+
+/* 0, 16, 30, 46 and 73 are too far apart to merge, five reads per MX-28 */
+static void test_subscription_max_reads(void) {
+	const register_field_t fields[5]={
+		REGISTER_FIELD_MODEL_NUMBER, REGISTER_FIELD_STATUS_RETURN_LEVEL, REGISTER_FIELD_GOAL_POSITION,
+		REGISTER_FIELD_MOVING, REGISTER_FIELD_GOAL_ACCELERATION
+	};
+	const uint16_t servos=SUBSCRIPTION_MAX_READS/5+2;
+	subscription_service_t* service=test_subscription_service();
+	uint16_t ignored=0;
+
+	for (uint16_t s=0; s<servos; s++) {
+		for (uint8_t f=0; f<5; f++) {
+			subscription_add(service, 1+s, REGISTER_MODEL_MX28, fields[f], SUBSCRIPTION_CHANGE, 0, 0);
+		}
+	}
+	subscription_compile(service);
+	CHECK_EQUAL(service->read_count, SUBSCRIPTION_MAX_READS);
+	for (uint16_t h=0; h<service->count; h++) {
+		if (service->read_of[h]==SUBSCRIPTION_NO_READ) {
+			/* the highest ids are sorted last */
+			CHECK(service->id[h]>=SUBSCRIPTION_MAX_READS/5);
+			ignored++;
+		} else {
+			service->reads[service->read_of[h]].valid=true;
+		}
+	}
+	CHECK_EQUAL(ignored, servos*5-SUBSCRIPTION_MAX_READS);
+
+	/* the first sample fires everything that is read, and nothing else */
+	subscription_evaluate(service, 0);
+	CHECK_EQUAL(service->notification_count, SUBSCRIPTION_MAX_READS);
+	for (uint16_t h=0; h<service->count; h++) {
+		CHECK_EQUAL(service->fired[h], service->read_of[h]!=SUBSCRIPTION_NO_READ);
+	}
+}
+
+static void test_subscription_change(void) {
+	subscription_service_t* service=test_subscription_service();
+	int16_t h=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, SUBSCRIPTION_CHANGE, 10, 0);
+	const uint16_t values[]={500, 505, 509, 510, 501, 500, 490};
+	const uint8_t fires[]={1, 0, 0, 1, 0, 1, 1};
+	const int32_t lasts[]={500, 500, 500, 510, 510, 500, 490};
+
+	subscription_compile(service);
+	/* nothing read yet */
+	subscription_evaluate(service, 0);
+	CHECK_EQUAL(service->fired[h], 0);
+	/* against the last notified value, not the last sample */
+	for (uint32_t t=0; t<sizeof(values)/sizeof(values[0]); t++) {
+		test_subscription_set(service, h, values[t]);
+		subscription_evaluate(service, 1+t);
+		CHECK_EQUAL(service->fired[h], fires[t]);
+		CHECK_EQUAL(service->last[h], lasts[t]);
+	}
+	CHECK_EQUAL(service->notification_count, 1);
+	CHECK_EQUAL(service->notifications[0].handle, h);
+	CHECK_EQUAL(service->notifications[0].value, 490);
+}
+
+static void test_subscription_threshold(void) {
+	subscription_service_t* service=test_subscription_service();
+	int16_t above=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, SUBSCRIPTION_ABOVE, 600, 0);
+	int16_t below=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_TEMPERATURE, SUBSCRIPTION_BELOW, 40, 0);
+	/* fires on the crossing, re-armed once it went back */
+	const uint16_t positions[]={500, 700, 800, 600, 601, 500, 650};
+	const uint8_t above_fires[]={0, 1, 0, 0, 1, 0, 1};
+	const uint16_t temperatures[]={30, 45, 39, 35, 40, 41, 20};
+	const uint8_t below_fires[]={1, 0, 1, 0, 0, 0, 1};
+
+	subscription_compile(service);
+	CHECK_EQUAL(service->read_of[above], service->read_of[below]);
+	for (uint32_t t=0; t<sizeof(positions)/sizeof(positions[0]); t++) {
+		test_subscription_set(service, above, positions[t]);
+		test_subscription_set(service, below, temperatures[t]);
+		subscription_evaluate(service, t);
+		CHECK_EQUAL(service->fired[above], above_fires[t]);
+		CHECK_EQUAL(service->fired[below], below_fires[t]);
+		/* the thresholds follow every sample */
+		CHECK_EQUAL(service->last[above], positions[t]);
+		CHECK_EQUAL(service->last[below], temperatures[t]);
+	}
+}
+
+/* 100ms at 50Hz is 5 ticks */
+static void test_subscription_rate_limit(void) {
+	subscription_service_t* service=test_subscription_service();
+	int16_t change=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, SUBSCRIPTION_CHANGE, 1, 100);
+	int16_t above=subscription_add(service, 2, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, SUBSCRIPTION_ABOVE, 600, 100);
+	/* a crossing inside the interval waits for it instead of being lost */
+	const uint16_t positions[]={700, 500, 700, 700, 700, 700, 800};
+	const uint8_t above_fires[]={1, 0, 0, 0, 0, 1, 0};
+	uint32_t fired=0;
+
+	CHECK_EQUAL(service->interval[change], 5);
+	subscription_compile(service);
+	for (uint32_t t=0; t<20; t++) {
+		test_subscription_set(service, change, 100+t);
+		if (t<sizeof(positions)/sizeof(positions[0])) {
+			test_subscription_set(service, above, positions[t]);
+		}
+		subscription_evaluate(service, t);
+		CHECK_EQUAL(service->fired[change], (t%5)==0);
+		if (t<sizeof(positions)/sizeof(positions[0])) {
+			CHECK_EQUAL(service->fired[above], above_fires[t]);
+		}
+		fired+=service->fired[change];
+	}
+	CHECK_EQUAL(fired, 4);
+	/* the value between notifications is skipped, not queued */
+	CHECK_EQUAL(service->last[change], 115);
+}
+
+/* speed and load carry the direction in bit 10, position doesn't */
+static void test_subscription_sign_magnitude(void) {
+	subscription_service_t* service=test_subscription_service();
+	int16_t speed=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_SPEED, SUBSCRIPTION_CHANGE, 0, 0);
+	int16_t load=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_LOAD, SUBSCRIPTION_BELOW, 0, 0);
+	int16_t position=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, SUBSCRIPTION_CHANGE, 0, 0);
+
+	subscription_compile(service);
+	test_subscription_set(service, speed, 0x400|100);
+	test_subscription_set(service, load, 0x7FF);
+	test_subscription_set(service, position, 0x7FF);
+	subscription_evaluate(service, 0);
+	CHECK_EQUAL(service->current[speed], -100);
+	CHECK_EQUAL(service->current[load], -1023);
+	CHECK_EQUAL(service->current[position], 0x7FF);
+	/* a negative load is below 0 */
+	CHECK_EQUAL(service->fired[load], 1);
+	CHECK_EQUAL(service->notification_count, 3);
+	CHECK_EQUAL(service->notifications[0].value, -100);
+
+	test_subscription_set(service, speed, 100);
+	test_subscription_set(service, load, 0x3FF);
+	subscription_evaluate(service, 1);
+	CHECK_EQUAL(service->current[speed], 100);
+	CHECK_EQUAL(service->current[load], 1023);
+	CHECK_EQUAL(service->fired[speed], 1);
+	CHECK_EQUAL(service->fired[load], 0);
+}
+
+/*
+ * a subscription added while the thread was reading reuses a slot whose
+ * read and offset still belong to the old one, the tick must not look at
+ * it before the next compile.
+ */
+static void test_subscription_dirty(void) {
+	subscription_service_t* service=test_subscription_service();
+	int16_t position=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_POSITION, SUBSCRIPTION_CHANGE, 0, 0);
+	int16_t temperature=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_TEMPERATURE, SUBSCRIPTION_CHANGE, 0, 0);
+	int16_t load;
+
+	subscription_compile(service);
+	test_subscription_set(service, position, 512);
+	test_subscription_set(service, temperature, 35);
+	subscription_step(service);
+	CHECK_EQUAL(service->notification_count, 2);
+	CHECK_EQUAL(service->tick, 1);
+
+	/* the reads of tick 1 are done, then the slot changes hands */
+	subscription_remove(service, position);
+	load=subscription_add(service, 1, REGISTER_MODEL_AX12, REGISTER_FIELD_PRESENT_LOAD, SUBSCRIPTION_ABOVE, 100, 0);
+	CHECK_EQUAL(load, position);
+	CHECK(service->dirty);
+	test_subscription_set(service, temperature, 36);
+	subscription_step(service);
+	CHECK_EQUAL(service->notification_count, 0);
+	CHECK_EQUAL(service->tick, 2);
+	CHECK_EQUAL(service->last[load], -0x10000);
+
+	/* next tick compiles first */
+	subscription_compile(service);
+	test_subscription_set(service, load, 0x400|200);
+	test_subscription_set(service, temperature, 36);
+	subscription_step(service);
+	CHECK_EQUAL(service->fired[load], 0);
+	CHECK_EQUAL(service->last[load], -200);
+	CHECK_EQUAL(service->fired[temperature], 1);
+	test_subscription_set(service, load, 200);
+	subscription_step(service);
+	CHECK_EQUAL(service->fired[load], 1);
+	CHECK_EQUAL(service->notifications[0].value, 200);
+}
+
+int main(int argc, char** argv) {
+	test_subscription_merge();
+	test_subscription_max_reads();
+	test_subscription_change();
+	test_subscription_threshold();
+	test_subscription_rate_limit();
+	test_subscription_sign_magnitude();
+	test_subscription_dirty();
+	return test_result("test_subscription");
+}
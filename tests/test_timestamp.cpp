@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2013 Alexander Krause <alexander.krause@ed-solutions.de>
+ * 
+ * Dynamixel ZeroMQ service
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Arrival stamps of the *_TIMED reads against the time the simulated servo
+ * wrote its status packet, for several response delays, and a client
+ * clock offset estimated from TIME_SYNC.
+ */
+#include "test.h"
+#include "servo_sim.c"
+
+#define TEST_TIMESTAMP_SERVOS       3
+#define TEST_TIMESTAMP_DELAY_US     2000
+#define TEST_TIMESTAMP_ROUNDS       50
+#define TEST_TIMESTAMP_MEDIAN_NS    100000ULL		/* stamp against the servo's write(), median */
+#define TEST_TIMESTAMP_SLACK_NS     20000000ULL		/* any single read, a pty and a scheduler in between */
+#define TEST_TIMESTAMP_EXCESS_US    500						/* duration beyond the delay: wire time and usleep(), median */
+#define TEST_TIMESTAMP_OFFSET_NS    1500000000LL	/* the client clock runs ahead by this */
+
+static uint64_t test_timestamp_time(const std::vector<int16_t>& tx_vect, size_t offset) {
+	uint64_t ns=0;
+
+	for (uint8_t i=0; i<4; i++) {
+		ns|=(uint64_t)(uint16_t)tx_vect[offset+i]<<(16*i);
+	}
+	return ns;
+}
+
+template <typename T> static T test_timestamp_median(std::vector<T> samples) {
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size()/2];
+}
+
+/* <err>,<t_reply 4 words>,<duration us>,<data> */
+static void test_timestamp_read(servo_sim_t* sim, command_ctx_t* ctx, uint32_t delay_us) {
+	std::vector<int16_t> rx_vect={DYNAMIXEL_RQ_READ_DATA_TIMED, 1, SERVO_SIM_R_PRESENT_POSITION, 2};
+	std::vector<int16_t> tx_vect;
+	std::vector<uint64_t> errors;
+	std::vector<int64_t> excess;
+	uint64_t t_before;
+	uint64_t t_after;
+	uint64_t t_reply;
+	uint64_t t_status;
+	uint16_t duration_us;
+
+	sim->reply_delay_us=delay_us;
+	for (uint32_t r=0; r<TEST_TIMESTAMP_ROUNDS; r++) {
+		tx_vect.clear();
+		t_before=test_now_ns();
+		CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+		t_after=test_now_ns();
+		t_status=servo_sim_status_time(sim);
+		CHECK_EQUAL(tx_vect.size(), 1+5+2);
+		if (tx_vect.size()!=1+5+2) {
+			return;
+		}
+		t_reply=test_timestamp_time(tx_vect, 1);
+		duration_us=(uint16_t)tx_vect[5];
+		CHECK((t_reply>=t_before) && (t_reply<=t_after));
+		/* read() returns after the servo's write() */
+		CHECK(t_reply>=t_status);
+		CHECK(t_reply-t_status<TEST_TIMESTAMP_SLACK_NS);
+		/* the transaction can't be shorter than the servo took to answer */
+		CHECK(duration_us>=delay_us);
+		CHECK((uint64_t)duration_us*1000<=t_after-t_before);
+		CHECK_EQUAL((uint16_t)(tx_vect[6]|(tx_vect[7]<<8)), 512);
+		errors.push_back(t_reply-t_status);
+		excess.push_back((int64_t)duration_us-delay_us);
+	}
+	printf("delay %4uus: stamp - status write median %6.1fus, duration - delay median %6lldus\n", delay_us,
+		test_timestamp_median(errors)/1000.0, (long long)test_timestamp_median(excess));
+	CHECK(test_timestamp_median(errors)<=TEST_TIMESTAMP_MEDIAN_NS);
+	CHECK(test_timestamp_median(excess)<=TEST_TIMESTAMP_EXCESS_US);
+}
+
+/* one stamp per id, in the order the ids were read */
+static void test_timestamp_unit_read(command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect={DYNAMIXEL_RQ_UNIT_READ_STATE_TIMED, 1, 2, 3};
+	std::vector<int16_t> tx_vect;
+	uint64_t t_before;
+	uint64_t t_previous;
+	uint64_t t_reply;
+
+	t_before=test_now_ns();
+	CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+	CHECK_EQUAL(tx_vect.size(), 1+TEST_TIMESTAMP_SERVOS*8);
+	if (tx_vect.size()!=1+TEST_TIMESTAMP_SERVOS*8) {
+		return;
+	}
+	t_previous=t_before;
+	for (uint8_t i=0; i<TEST_TIMESTAMP_SERVOS; i++) {
+		t_reply=test_timestamp_time(tx_vect, 1+i*8+3);
+		CHECK(t_reply-t_previous>=TEST_TIMESTAMP_DELAY_US*1000ULL);
+		CHECK(tx_vect[1+i*8+7]>=TEST_TIMESTAMP_DELAY_US);
+		t_previous=t_reply;
+	}
+	CHECK(t_previous<=test_now_ns());
+}
+
+/*
+ * <err>,<t_rx 4 words>,<t_tx 4 words>. A client whose clock is ahead
+ * estimates the offset the NTP way, it must come out within half the
+ * round trip of the real one.
+ */
+static void test_timestamp_time_sync(command_ctx_t* ctx) {
+	std::vector<int16_t> rx_vect={DYNAMIXEL_RQ_TIME_SYNC};
+	std::vector<int16_t> tx_vect;
+	std::vector<int64_t> errors;
+	int64_t t0, t1, t2, t3;
+	int64_t offset;
+
+	for (uint32_t r=0; r<TEST_TIMESTAMP_ROUNDS; r++) {
+		tx_vect.clear();
+		t0=test_now_ns()+TEST_TIMESTAMP_OFFSET_NS;
+		/* what the request loop does when the message arrives */
+		ctx->t_receive_ns=test_now_ns();
+		CHECK_EQUAL(command_dispatch(ctx, rx_vect, tx_vect), ZMQ_ERR_NO_ERROR);
+		t3=test_now_ns()+TEST_TIMESTAMP_OFFSET_NS;
+		CHECK_EQUAL(tx_vect.size(), 9);
+		if (tx_vect.size()!=9) {
+			return;
+		}
+		t1=test_timestamp_time(tx_vect, 1);
+		t2=test_timestamp_time(tx_vect, 5);
+		CHECK_EQUAL(t1, ctx->t_receive_ns);
+		CHECK(t2>=t1);
+		/* the service spent less time than the client waited */
+		CHECK(t2-t1<=t3-t0);
+		offset=((t1-t0)+(t2-t3))/2;
+		CHECK(llabs(offset+TEST_TIMESTAMP_OFFSET_NS)<=(t3-t0)/2+1);
+		errors.push_back(llabs(offset+TEST_TIMESTAMP_OFFSET_NS));
+	}
+	printf("time sync: offset error median %lldns\n", (long long)test_timestamp_median(errors));
+	CHECK(test_timestamp_median(errors)<=(int64_t)TEST_TIMESTAMP_MEDIAN_NS);
+}
+
+int main(int argc, char** argv) {
+	servo_sim_t sim;
+	dynamixel_serial_t serial;
+	dynamixel_bus_t bus;
+	calibration_t calibration;
+	command_ctx_t ctx;
+
+	if ((servo_sim_start(&sim, TEST_TIMESTAMP_SERVOS, false)!=0) || (servo_sim_connect(&sim, &serial)!=0)) {
+		fprintf(stderr, "no simulated bus\n");
+		return 1;
+	}
+	dynamixel_bus_init(&bus, NULL, &serial);
+	calibration_init(&calibration);
+	test_command_ctx(&ctx, &bus, &calibration);
+
+	test_timestamp_read(&sim, &ctx, 0);
+	test_timestamp_read(&sim, &ctx, 100);
+	test_timestamp_read(&sim, &ctx, 500);
+	test_timestamp_read(&sim, &ctx, 1000);
+	sim.reply_delay_us=TEST_TIMESTAMP_DELAY_US;
+	test_timestamp_unit_read(&ctx);
+	test_timestamp_time_sync(&ctx);
+	servo_sim_stop(&sim);
+	return test_result("test_timestamp");
+}